@@ -0,0 +1,50 @@
+#ifndef GADGET_TEST_H
+#define GADGET_TEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+//minimal checks, a failed one is reported and fails the test binary
+
+static int gadget_test_failures = 0;
+
+#define GADGET_CHECK(cond)                                                          \
+    do {                                                                            \
+        if(!(cond))                                                                 \
+        {                                                                           \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);         \
+            gadget_test_failures++;                                                 \
+        }                                                                           \
+    } while(0)
+
+#define GADGET_TEST_RUN(fn)                                                         \
+    do {                                                                            \
+        int before = gadget_test_failures;                                          \
+        fn();                                                                       \
+        printf("%s %s\n", gadget_test_failures == before ? "PASS" : "FAIL", #fn);   \
+    } while(0)
+
+#define GADGET_TEST_RESULT()        (gadget_test_failures ? 1 : 0)
+
+//repeatable pseudo random input
+static inline uint32_t gadget_test_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static inline double gadget_test_now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#endif
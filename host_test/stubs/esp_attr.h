@@ -0,0 +1,6 @@
+#ifndef GADGET_HOST_ESP_ATTR_H
+#define GADGET_HOST_ESP_ATTR_H
+
+#define IRAM_ATTR
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef GADGET_HOST_ESP_TIMER_H
+#define GADGET_HOST_ESP_TIMER_H
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef GADGET_HOST_FREERTOS_H
+#define GADGET_HOST_FREERTOS_H
+
+//just enough FreeRTOS for single threaded host tests of task side code
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+typedef void *QueueHandle_t;
+typedef struct { int unused; } StaticQueue_t;
+typedef struct { int unused; } portMUX_TYPE;
+
+#define pdTRUE                      1
+#define pdFALSE                     0
+#define pdPASS                      1
+#define pdFAIL                      0
+#define errQUEUE_FULL               0
+#define portMAX_DELAY               ((TickType_t)0xFFFFFFFF)
+#define configTICK_RATE_HZ          1000
+#define configASSERT(x)             ((void)(x))
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+#define portENTER_CRITICAL_SAFE(mux)    ((void)(mux))
+#define portEXIT_CRITICAL_SAFE(mux)     ((void)(mux))
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef GADGET_HOST_QUEUE_H
+#define GADGET_HOST_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef GADGET_HOST_TASK_H
+#define GADGET_HOST_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+#endif
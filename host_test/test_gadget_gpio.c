@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "gadget_test.h"
+
+//the unit under test, built against the mocked register file (see CMakeLists.txt)
+#include "../main/src/gadget_gpio.c"
+
+/*
+ * Pin table "2,5,40": entries 0 and 1 live in register bank 0, entry 2 is
+ * bit 8 of bank 1.
+ */
+#define GPIO_TEST_BANK0_PINS        ((1UL << 2) | (1UL << 5))
+#define GPIO_TEST_BANK1_PINS        (1UL << (40 - 32))
+
+//what the gpio task links against, the bus and the other modules are not under test
+gadget_msg_queue_t *gadget_central_msg_queue;
+gadget_msg_queue_t *gadget_gpio_msg_queue;
+static uint32_t central_sends = 0;
+static uint32_t pattern_msgs = 0;
+
+int64_t esp_timer_get_time(void)
+{
+    return 0;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    (void)code;
+    return "ERR";
+}
+
+uint8_t *gadget_msg_alloc_payload(gadget_msg_t *msg, size_t len)
+{
+    if(len > GADGET_MSG_DATA_SIZE)
+        return NULL;
+    memset(msg->data, 0, GADGET_MSG_DATA_SIZE);
+    return msg->data;
+}
+
+const uint8_t *gadget_msg_payload(const gadget_msg_t *msg)
+{
+    return msg->data;
+}
+
+size_t gadget_msg_payload_len(const gadget_msg_t *msg)
+{
+    (void)msg;
+    return GADGET_MSG_DATA_SIZE;
+}
+
+void gadget_msg_release(gadget_msg_t *msg)
+{
+    (void)msg;
+}
+
+BaseType_t gadget_send_msg(gadget_msg_queue_t *msg_queue, TickType_t ticks_to_wait, msg_prio_t msg_prio,
+                           msg_sender_t msg_sender, msg_type_t msg_type, gadget_msg_t *msg)
+{
+    (void)msg_queue;
+    (void)ticks_to_wait;
+    (void)msg_prio;
+    (void)msg_sender;
+
+    //loop straight back into the handler, as central would forward it
+    central_sends++;
+    msg->msg_type = msg_type;
+    gadget_gpio_handle_msg(msg);
+    return pdPASS;
+}
+
+size_t gadget_recv_burst(gadget_msg_queue_t *msg_queue, gadget_msg_t *burst, size_t max_msgs, TickType_t ticks_to_wait)
+{
+    (void)msg_queue;
+    (void)burst;
+    (void)max_msgs;
+    (void)ticks_to_wait;
+    return 0;
+}
+
+esp_err_t gadget_input_init(void)
+{
+    return ESP_OK;
+}
+
+void gadget_pattern_handle_msg(const gadget_msg_t *msg)
+{
+    (void)msg;
+    pattern_msgs++;
+}
+
+void gadget_bench_sink(const gadget_msg_t *msg)
+{
+    (void)msg;
+}
+
+static void send_type(msg_type_t type)
+{
+    gadget_msg_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_type = type;
+    gadget_gpio_handle_msg(&msg);
+}
+
+//nothing moves before init_gpio, after it every output is driven low
+static void test_init(void)
+{
+    const gadget_gpio_regs_t *regs = gadget_gpio_mock_regs();
+
+    GADGET_CHECK(gadget_gpio_write(1, 0, gadget_main_id));
+    GADGET_CHECK(regs->w1ts_writes == 0);
+    GADGET_CHECK(gadget_gpio_get_states() == 0);
+
+    send_type(gadget_msg_init_gpio);
+    GADGET_CHECK(gpio_init);
+    GADGET_CHECK(gpio_pin_count == 3);
+    GADGET_CHECK(gadget_gpio_pin(0) == 2);
+    GADGET_CHECK(gadget_gpio_pin(2) == 40);
+    GADGET_CHECK(gadget_gpio_pin(3) == -1);
+    GADGET_CHECK(regs->w1tc_writes == 2);
+    GADGET_CHECK(regs->out[0] == 0 && regs->out[1] == 0);
+}
+
+//one set and one clear write per bank at most, whatever the mask width
+static void test_apply_banks(void)
+{
+    const gadget_gpio_regs_t *regs = gadget_gpio_mock_regs();
+    uint32_t w1ts = regs->w1ts_writes;
+    uint32_t w1tc = regs->w1tc_writes;
+
+    GADGET_CHECK(gadget_gpio_apply(0x7, 0) == 0x7);
+    GADGET_CHECK(regs->out[0] == GPIO_TEST_BANK0_PINS);
+    GADGET_CHECK(regs->out[1] == GPIO_TEST_BANK1_PINS);
+    GADGET_CHECK(regs->w1ts_writes == w1ts + 2);
+    GADGET_CHECK(regs->w1tc_writes == w1tc);
+
+    GADGET_CHECK(gadget_gpio_apply(0, 0x5) == 0x2);
+    GADGET_CHECK(regs->out[0] == (1UL << 5));
+    GADGET_CHECK(regs->out[1] == 0);
+    GADGET_CHECK(regs->w1ts_writes == w1ts + 2);
+    GADGET_CHECK(regs->w1tc_writes == w1tc + 2);
+}
+
+static void test_apply_masks(void)
+{
+    const gadget_gpio_regs_t *regs = gadget_gpio_mock_regs();
+
+    gadget_gpio_apply(0, UINT32_MAX);
+
+    //set wins over clear for the same entry
+    GADGET_CHECK(gadget_gpio_apply(0x1, 0x1) == 0x1);
+    GADGET_CHECK(regs->out[0] == (1UL << 2));
+
+    //entries past the table are ignored
+    GADGET_CHECK(gadget_gpio_apply(0xFFFFFFF8, 0) == 0x1);
+    GADGET_CHECK(regs->out[0] == (1UL << 2) && regs->out[1] == 0);
+    GADGET_CHECK(gadget_gpio_reclaim(0) == ESP_OK);
+    GADGET_CHECK(gadget_gpio_reclaim(3) == ESP_ERR_INVALID_ARG);
+    GADGET_CHECK(regs->out[0] == 0);
+    GADGET_CHECK(gadget_gpio_get_states() == 0);
+}
+
+static void test_msgs(void)
+{
+    const gadget_gpio_regs_t *regs = gadget_gpio_mock_regs();
+    uint32_t sends = central_sends;
+
+    send_type(gadget_msg_toggle_led_2);
+    GADGET_CHECK(gadget_gpio_get_states() == 0x2);
+    GADGET_CHECK(regs->out[0] == (1UL << 5));
+    send_type(gadget_msg_toggle_led_2);
+    GADGET_CHECK(gadget_gpio_get_states() == 0);
+
+    //a write goes out through central with both masks in the payload
+    GADGET_CHECK(gadget_gpio_write(0x4, 0, gadget_main_id));
+    GADGET_CHECK(central_sends == sends + 1);
+    GADGET_CHECK(regs->out[1] == GPIO_TEST_BANK1_PINS);
+    GADGET_CHECK(gadget_gpio_write(0x1, 0x4, gadget_main_id));
+    GADGET_CHECK(gadget_gpio_get_states() == 0x1);
+    GADGET_CHECK(regs->out[0] == (1UL << 2) && regs->out[1] == 0);
+
+    send_type(gadget_msg_pattern);
+    GADGET_CHECK(pattern_msgs == 1);
+}
+
+int main(void)
+{
+    GADGET_TEST_RUN(test_init);
+    GADGET_TEST_RUN(test_apply_banks);
+    GADGET_TEST_RUN(test_apply_masks);
+    GADGET_TEST_RUN(test_msgs);
+
+    return GADGET_TEST_RESULT();
+}
@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "gadget_test.h"
+#include "gadget_msg_types.h"
+#include "gadget_proto.h"
+
+#define GADGET_PROTO_FUZZ_RUNS      200000
+#define GADGET_PROTO_FUZZ_MAX_LEN   64
+#define GADGET_PROTO_BENCH_FRAMES   1000000
+
+#define GADGET_TEST_REMOTE(type, wire, queue, handler, coalesce, remote) [type] = remote,
+
+static const uint8_t remote_types[gadget_msg_type_max] = {
+    GADGET_MSG_TYPE_LIST(GADGET_TEST_REMOTE)
+};
+
+static size_t encode(uint8_t type, msg_prio_t prio, const uint8_t *payload, uint16_t len, uint8_t *out, size_t size)
+{
+    gadget_proto_frame_t frame = { .type = type, .prio = prio, .len = len, .payload = payload };
+
+    return gadget_proto_encode(&frame, out, size);
+}
+
+//shipped wire ids must never move, whatever the list order
+static void test_wire_ids_fixed(void)
+{
+    GADGET_CHECK(gadget_proto_wire_id(gadget_msg_toggle_led_1) == 1);
+    GADGET_CHECK(gadget_proto_wire_id(gadget_msg_toggle_led_2) == 2);
+    GADGET_CHECK(gadget_proto_wire_id(gadget_msg_telemetry_rate) == 6);
+    GADGET_CHECK(gadget_proto_wire_id(gadget_msg_gpio_write) == 9);
+    GADGET_CHECK(gadget_proto_wire_id(gadget_msg_pattern) == 10);
+    GADGET_CHECK(gadget_proto_wire_id(gadget_msg_type_max) == -1);
+
+    for(int a = 0; a < gadget_msg_type_max; a++)
+    {
+        GADGET_CHECK(gadget_proto_wire_id(a) < GADGET_PROTO_TYPE_TELEMETRY);
+        for(int b = a + 1; b < gadget_msg_type_max; b++)
+            GADGET_CHECK(gadget_proto_wire_id(a) != gadget_proto_wire_id(b));
+    }
+}
+
+static void test_round_trip(void)
+{
+    const uint8_t payload[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    gadget_proto_frame_t frame;
+    uint8_t buf[32];
+    size_t len;
+    size_t consumed;
+
+    len = encode(gadget_proto_wire_id(gadget_msg_gpio_write), gadget_prio_high, payload, sizeof(payload), buf, sizeof(buf));
+    GADGET_CHECK(len == GADGET_PROTO_HEADER_SIZE + sizeof(payload));
+    GADGET_CHECK(buf[2] == GADGET_PROTO_FLAG_HIGH);
+    GADGET_CHECK(gadget_proto_decode(buf, len, &frame, &consumed) == ESP_OK);
+    GADGET_CHECK(consumed == len);
+    GADGET_CHECK(frame.msg_type == gadget_msg_gpio_write);
+    GADGET_CHECK(frame.prio == gadget_prio_high);
+    GADGET_CHECK(frame.len == sizeof(payload));
+    GADGET_CHECK(memcmp(frame.payload, payload, sizeof(payload)) == 0);
+
+    //too small an output writes nothing
+    GADGET_CHECK(encode(1, gadget_prio_bulk, payload, sizeof(payload), buf, GADGET_PROTO_HEADER_SIZE) == 0);
+}
+
+//no flags is the bulk lane, high has to be asked for
+static void test_high_lane_opt_in(void)
+{
+    uint8_t buf[] = { GADGET_PROTO_VERSION, 1, 0, 0, 0 };
+    gadget_proto_frame_t frame;
+    size_t consumed;
+
+    GADGET_CHECK(gadget_proto_decode(buf, sizeof(buf), &frame, &consumed) == ESP_OK);
+    GADGET_CHECK(frame.prio == gadget_prio_bulk);
+
+    buf[2] = GADGET_PROTO_FLAG_HIGH;
+    GADGET_CHECK(gadget_proto_decode(buf, sizeof(buf), &frame, &consumed) == ESP_OK);
+    GADGET_CHECK(frame.prio == gadget_prio_high);
+}
+
+//device internal types are refused but skipped cleanly
+static void test_local_types_rejected(void)
+{
+    gadget_proto_frame_t frame;
+    uint8_t buf[16];
+    size_t len;
+    size_t consumed;
+
+    for(int type = 0; type < gadget_msg_type_max; type++)
+    {
+        len = encode(gadget_proto_wire_id(type), gadget_prio_bulk, (const uint8_t *)"abc", 3, buf, sizeof(buf));
+        if(remote_types[type])
+        {
+            GADGET_CHECK(gadget_proto_decode(buf, len, &frame, &consumed) == ESP_OK);
+            GADGET_CHECK(frame.msg_type == type);
+        }
+        else
+        {
+            GADGET_CHECK(gadget_proto_decode(buf, len, &frame, &consumed) == ESP_ERR_INVALID_ARG);
+            GADGET_CHECK(consumed == len);
+        }
+    }
+
+    len = encode(0x7F, gadget_prio_bulk, NULL, 0, buf, sizeof(buf));
+    GADGET_CHECK(gadget_proto_decode(buf, len, &frame, &consumed) == ESP_ERR_INVALID_ARG);
+}
+
+static void test_malformed(void)
+{
+    uint8_t old_version[] = { 1, 1, 0, 0, 0 };
+    uint8_t truncated[] = { GADGET_PROTO_VERSION, 1, 0, 4, 0, 0xAA };
+    gadget_proto_frame_t frame;
+    size_t consumed;
+
+    GADGET_CHECK(gadget_proto_decode(old_version, sizeof(old_version), &frame, &consumed) == ESP_ERR_INVALID_VERSION);
+    GADGET_CHECK(consumed == 0);
+    GADGET_CHECK(gadget_proto_decode(truncated, sizeof(truncated), &frame, &consumed) == ESP_ERR_INVALID_SIZE);
+    GADGET_CHECK(consumed == 0);
+    GADGET_CHECK(gadget_proto_decode(truncated, 3, &frame, &consumed) == ESP_ERR_INVALID_SIZE);
+    GADGET_CHECK(consumed == 0);
+}
+
+static void test_packed_frames(void)
+{
+    const uint8_t write[8] = { 0x01 };
+    gadget_proto_frame_t frame;
+    uint8_t buf[64];
+    size_t len = 0;
+    size_t consumed;
+    size_t at = 0;
+    int frames = 0;
+
+    len += encode(1, gadget_prio_high, NULL, 0, &buf[len], sizeof(buf) - len);
+    len += encode(gadget_proto_wire_id(gadget_msg_sta_state), gadget_prio_bulk, write, 2, &buf[len], sizeof(buf) - len);
+    len += encode(9, gadget_prio_bulk, write, sizeof(write), &buf[len], sizeof(buf) - len);
+
+    while(at < len)
+    {
+        esp_err_t ret = gadget_proto_decode(&buf[at], len - at, &frame, &consumed);
+
+        GADGET_CHECK(consumed > 0);
+        if(consumed == 0)
+            break;
+        if(ret == ESP_OK)
+            frames++;
+        at += consumed;
+    }
+    GADGET_CHECK(at == len);
+    GADGET_CHECK(frames == 2);
+}
+
+//walk random bytes the way the ws receive path does, nothing may read past the end
+static void test_fuzz(void)
+{
+    uint8_t buf[GADGET_PROTO_FUZZ_MAX_LEN];
+    gadget_proto_frame_t frame;
+    uint32_t seed = 0x9E3779B9;
+    size_t consumed;
+    uint32_t accepted = 0;
+
+    for(int run = 0; run < GADGET_PROTO_FUZZ_RUNS; run++)
+    {
+        size_t len = gadget_test_rand(&seed) % (sizeof(buf) + 1);
+        const uint8_t *at = buf;
+
+        for(size_t i = 0; i < len; i++)
+            buf[i] = gadget_test_rand(&seed);
+        //mostly well formed headers, or nothing gets past the version check
+        if(len > 0 && (gadget_test_rand(&seed) & 3) != 0)
+            buf[0] = GADGET_PROTO_VERSION;
+        if(len > 1 && (gadget_test_rand(&seed) & 1))
+            buf[1] = gadget_proto_wire_id(gadget_test_rand(&seed) % gadget_msg_type_max);
+        if(len > 4 && (gadget_test_rand(&seed) & 1))
+        {
+            buf[3] = gadget_test_rand(&seed) % (len - 4);
+            buf[4] = 0;
+        }
+
+        while(len > 0)
+        {
+            esp_err_t ret = gadget_proto_decode(at, len, &frame, &consumed);
+
+            GADGET_CHECK(consumed <= len);
+            if(ret == ESP_OK)
+            {
+                accepted++;
+                GADGET_CHECK(frame.msg_type < gadget_msg_type_max && remote_types[frame.msg_type]);
+                GADGET_CHECK(frame.payload + frame.len <= at + len);
+                GADGET_CHECK(consumed == (size_t)GADGET_PROTO_HEADER_SIZE + frame.len);
+            }
+            if(consumed == 0 || consumed > len)
+                break;
+            at += consumed;
+            len -= consumed;
+        }
+    }
+
+    printf("fuzz: %d buffers, %lu frames accepted\n", GADGET_PROTO_FUZZ_RUNS, (unsigned long)accepted);
+    GADGET_CHECK(accepted > 0);
+}
+
+static void test_throughput(void)
+{
+    const uint8_t payload[8] = { 0 };
+    gadget_proto_frame_t frame;
+    uint8_t buf[32];
+    size_t len;
+    size_t consumed;
+    uint32_t ok = 0;
+    double start = gadget_test_now_s();
+    double elapsed;
+
+    for(int i = 0; i < GADGET_PROTO_BENCH_FRAMES; i++)
+    {
+        len = encode(9, gadget_prio_bulk, payload, sizeof(payload), buf, sizeof(buf));
+        ok += gadget_proto_decode(buf, len, &frame, &consumed) == ESP_OK;
+    }
+    elapsed = gadget_test_now_s() - start;
+
+    GADGET_CHECK(ok == GADGET_PROTO_BENCH_FRAMES);
+    printf("{\"bench\":\"gadget_proto\",\"frames\":%d,\"frames_per_s\":%.0f}\n",
+           GADGET_PROTO_BENCH_FRAMES, elapsed > 0 ? GADGET_PROTO_BENCH_FRAMES / elapsed : 0);
+}
+
+int main(void)
+{
+    GADGET_TEST_RUN(test_wire_ids_fixed);
+    GADGET_TEST_RUN(test_round_trip);
+    GADGET_TEST_RUN(test_high_lane_opt_in);
+    GADGET_TEST_RUN(test_local_types_rejected);
+    GADGET_TEST_RUN(test_malformed);
+    GADGET_TEST_RUN(test_packed_frames);
+    GADGET_TEST_RUN(test_fuzz);
+    GADGET_TEST_RUN(test_throughput);
+
+    return GADGET_TEST_RESULT();
+}
@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "gadget_test.h"
+#include "gadget_ring.h"
+
+#define GADGET_RING_TEST_CAPACITY   8       // small so the indices wrap constantly
+#define GADGET_RING_STRESS_ITEMS    2000000
+
+//same size as an unpooled gadget_msg_t
+typedef struct {
+    uint32_t seq;
+    uint32_t stamp;
+    uint8_t data[12];
+} gadget_ring_item_t;
+
+//host stand-in for a FreeRTOS queue, a lock taken on every send and receive
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+    gadget_ring_item_t items[GADGET_RING_TEST_CAPACITY];
+    uint32_t head;
+    uint32_t tail;
+} gadget_locked_queue_t;
+
+typedef struct {
+    bool use_ring;
+    gadget_ring_t ring;
+    gadget_ring_item_t ring_buf[GADGET_RING_TEST_CAPACITY];
+    gadget_locked_queue_t queue;
+    uint32_t items;
+    uint32_t out_of_order;
+    uint32_t corrupt;
+} gadget_ring_run_t;
+
+static void fill(gadget_ring_item_t *item, uint32_t seq)
+{
+    item->seq = seq;
+    item->stamp = seq * 2654435761u;
+    for(size_t i = 0; i < sizeof(item->data); i++)
+        item->data[i] = (uint8_t)(seq + i);
+}
+
+static bool intact(const gadget_ring_item_t *item)
+{
+    gadget_ring_item_t expected;
+
+    fill(&expected, item->seq);
+    return memcmp(&expected, item, sizeof(expected)) == 0;
+}
+
+static void locked_push(gadget_locked_queue_t *queue, const gadget_ring_item_t *item)
+{
+    pthread_mutex_lock(&queue->lock);
+    while(queue->head - queue->tail == GADGET_RING_TEST_CAPACITY)
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    queue->items[queue->head++ % GADGET_RING_TEST_CAPACITY] = *item;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static void locked_pop(gadget_locked_queue_t *queue, gadget_ring_item_t *item)
+{
+    pthread_mutex_lock(&queue->lock);
+    while(queue->head == queue->tail)
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    *item = queue->items[queue->tail++ % GADGET_RING_TEST_CAPACITY];
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static void *producer(void *arg)
+{
+    gadget_ring_run_t *run = arg;
+    gadget_ring_item_t item;
+
+    for(uint32_t seq = 0; seq < run->items; seq++)
+    {
+        fill(&item, seq);
+        if(!run->use_ring)
+        {
+            locked_push(&run->queue, &item);
+            continue;
+        }
+        while(!gadget_ring_push(&run->ring, &item))
+            sched_yield();
+    }
+
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    gadget_ring_run_t *run = arg;
+    gadget_ring_item_t item;
+
+    for(uint32_t seq = 0; seq < run->items; seq++)
+    {
+        if(run->use_ring)
+        {
+            while(!gadget_ring_pop(&run->ring, &item))
+                sched_yield();
+        }
+        else
+            locked_pop(&run->queue, &item);
+
+        if(item.seq != seq)
+            run->out_of_order++;
+        if(!intact(&item))
+            run->corrupt++;
+    }
+
+    return NULL;
+}
+
+//one producer and one consumer thread move items through either transport
+static double transfer(gadget_ring_run_t *run, bool use_ring, uint32_t items)
+{
+    pthread_t threads[2];
+    double start;
+
+    memset(run, 0, sizeof(*run));
+    run->use_ring = use_ring;
+    run->items = items;
+    gadget_ring_init(&run->ring, run->ring_buf, sizeof(gadget_ring_item_t), GADGET_RING_TEST_CAPACITY);
+    pthread_mutex_init(&run->queue.lock, NULL);
+    pthread_cond_init(&run->queue.not_full, NULL);
+    pthread_cond_init(&run->queue.not_empty, NULL);
+
+    start = gadget_test_now_s();
+    pthread_create(&threads[0], NULL, consumer, run);
+    pthread_create(&threads[1], NULL, producer, run);
+    pthread_join(threads[1], NULL);
+    pthread_join(threads[0], NULL);
+
+    pthread_cond_destroy(&run->queue.not_empty);
+    pthread_cond_destroy(&run->queue.not_full);
+    pthread_mutex_destroy(&run->queue.lock);
+
+    return gadget_test_now_s() - start;
+}
+
+static void test_capacity_for(void)
+{
+    GADGET_CHECK(gadget_ring_capacity_for(0) == 1);
+    GADGET_CHECK(gadget_ring_capacity_for(1) == 1);
+    GADGET_CHECK(gadget_ring_capacity_for(5) == 8);
+    GADGET_CHECK(gadget_ring_capacity_for(8) == 8);
+    GADGET_CHECK(gadget_ring_capacity_for(9) == 16);
+}
+
+static void test_fill_drain(void)
+{
+    gadget_ring_item_t buf[GADGET_RING_TEST_CAPACITY];
+    gadget_ring_item_t item;
+    gadget_ring_t ring;
+
+    gadget_ring_init(&ring, buf, sizeof(item), GADGET_RING_TEST_CAPACITY);
+    GADGET_CHECK(!gadget_ring_pop(&ring, &item));
+
+    //several laps, so head and tail pass the buffer end many times
+    for(uint32_t lap = 0; lap < 5; lap++)
+    {
+        for(uint32_t i = 0; i < GADGET_RING_TEST_CAPACITY; i++)
+        {
+            fill(&item, lap * 100 + i);
+            GADGET_CHECK(gadget_ring_push(&ring, &item));
+        }
+        GADGET_CHECK(gadget_ring_count(&ring) == GADGET_RING_TEST_CAPACITY);
+        GADGET_CHECK(!gadget_ring_push(&ring, &item));
+
+        for(uint32_t i = 0; i < GADGET_RING_TEST_CAPACITY; i++)
+        {
+            GADGET_CHECK(gadget_ring_pop(&ring, &item));
+            GADGET_CHECK(item.seq == lap * 100 + i && intact(&item));
+        }
+        GADGET_CHECK(gadget_ring_count(&ring) == 0);
+        GADGET_CHECK(!gadget_ring_pop(&ring, &item));
+    }
+}
+
+//nothing lost, duplicated, reordered or torn under a concurrent producer
+static void test_spsc_stress(void)
+{
+    static gadget_ring_run_t run;
+
+    transfer(&run, true, GADGET_RING_STRESS_ITEMS);
+    GADGET_CHECK(run.out_of_order == 0);
+    GADGET_CHECK(run.corrupt == 0);
+    GADGET_CHECK(gadget_ring_count(&run.ring) == 0);
+}
+
+static void test_ring_vs_queue(void)
+{
+    static gadget_ring_run_t run;
+    double ring_s;
+    double queue_s;
+
+    ring_s = transfer(&run, true, GADGET_RING_STRESS_ITEMS);
+    GADGET_CHECK(run.out_of_order == 0 && run.corrupt == 0);
+    queue_s = transfer(&run, false, GADGET_RING_STRESS_ITEMS);
+    GADGET_CHECK(run.out_of_order == 0 && run.corrupt == 0);
+
+    printf("{\"bench\":\"gadget_ring\",\"items\":%d,\"capacity\":%d,\"ring_per_s\":%.0f,\"locked_queue_per_s\":%.0f}\n",
+           GADGET_RING_STRESS_ITEMS, GADGET_RING_TEST_CAPACITY,
+           ring_s > 0 ? GADGET_RING_STRESS_ITEMS / ring_s : 0,
+           queue_s > 0 ? GADGET_RING_STRESS_ITEMS / queue_s : 0);
+}
+
+int main(void)
+{
+    GADGET_TEST_RUN(test_capacity_for);
+    GADGET_TEST_RUN(test_fill_drain);
+    GADGET_TEST_RUN(test_spsc_stress);
+    GADGET_TEST_RUN(test_ring_vs_queue);
+
+    return GADGET_TEST_RESULT();
+}
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+
+#include "gadget_test.h"
+
+//the unit under test, its route table and handlers are static (see CMakeLists.txt)
+#include "../main/src/gadget_central.c"
+
+/*
+ * Central's routing, the real route table against the switch it replaced.
+ * The switch replica keeps one case per type and the log line every case
+ * used to print, and calls the same handlers as the table. On the host a
+ * log line is formatted into a buffer and not written out, so its cost here
+ * is a floor, a UART on the target is slower.
+ */
+
+#define GADGET_ROUTE_BENCH_MSGS     5000000
+#define GADGET_ROUTE_LOG_SIZE       96
+
+//what reaches each destination, the bus and the other modules are not under test
+typedef struct {
+    uint32_t msgs;
+    uint32_t sum;
+} gadget_route_count_t;
+
+static gadget_msg_queue_t central_queue;
+static gadget_msg_queue_t gpio_queue;
+static gadget_msg_queue_t comms_queue;
+
+gadget_msg_queue_t *gadget_central_msg_queue = &central_queue;
+gadget_msg_queue_t *gadget_gpio_msg_queue = &gpio_queue;
+gadget_msg_queue_t *gadget_comms_msg_queue = &comms_queue;
+
+static gadget_route_count_t central;
+static gadget_route_count_t gpio;
+static gadget_route_count_t comms;
+
+static char log_line[GADGET_ROUTE_LOG_SIZE];
+static uint32_t log_lines = 0;
+
+static void gadget_route_count(gadget_route_count_t *count, uint8_t data)
+{
+    count->msgs++;
+    count->sum += data;
+}
+
+BaseType_t gadget_send_msg(gadget_msg_queue_t *msg_queue, TickType_t ticks_to_wait, msg_prio_t msg_prio,
+                           msg_sender_t msg_sender, msg_type_t msg_type, gadget_msg_t *msg)
+{
+    (void)ticks_to_wait;
+    (void)msg_prio;
+    (void)msg_sender;
+    (void)msg_type;
+
+    if(msg_queue == &gpio_queue)
+        gadget_route_count(&gpio, msg->data[0]);
+    else if(msg_queue == &comms_queue)
+        gadget_route_count(&comms, msg->data[0]);
+    else
+        gadget_route_count(&central, msg->data[0]);
+    return pdPASS;
+}
+
+size_t gadget_recv_burst(gadget_msg_queue_t *msg_queue, gadget_msg_t *burst, size_t max_msgs, TickType_t ticks_to_wait)
+{
+    (void)msg_queue;
+    (void)burst;
+    (void)max_msgs;
+    (void)ticks_to_wait;
+    return 0;
+}
+
+//handled in place by central, counted against central
+void gadget_telemetry_set_period(uint32_t period_ms)
+{
+    gadget_route_count(&central, period_ms & 0xFF);
+}
+
+void gadget_input_handle_event(const gadget_msg_t *msg)
+{
+    gadget_route_count(&central, msg->data[0]);
+}
+
+const uint8_t *gadget_msg_payload(const gadget_msg_t *msg)
+{
+    return msg->data;
+}
+
+size_t gadget_msg_payload_len(const gadget_msg_t *msg)
+{
+    (void)msg;
+    return GADGET_MSG_DATA_SIZE;
+}
+
+void gadget_msg_release(gadget_msg_t *msg)
+{
+    (void)msg;
+}
+
+static void gadget_route_log(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(log_line, sizeof(log_line), fmt, args);
+    va_end(args);
+    log_lines++;
+}
+
+//the old central task body, extended to every type of the list
+static void route_switch(gadget_msg_t *msg, bool log)
+{
+    switch(msg->msg_type)
+    {
+        case gadget_msg_init_gpio:
+            if(log)
+                gadget_route_log("I (%lu) %s: Sending msg to init_gpio", (unsigned long)log_lines, "gadget_mk1_central");
+            gadget_route_forward(gadget_gpio_msg_queue, msg);
+        break;
+
+        case gadget_msg_toggle_led_1:
+        case gadget_msg_toggle_led_2:
+            if(log)
+                gadget_route_log("I (%lu) %s: Sending msg to blink led", (unsigned long)log_lines, "gadget_mk1_central");
+            gadget_route_forward(gadget_gpio_msg_queue, msg);
+        break;
+
+        case gadget_msg_gpio_write:
+        case gadget_msg_pattern:
+        case gadget_msg_bench_gpio:
+            if(log)
+                gadget_route_log("I (%lu) %s: Sending msg to gpio", (unsigned long)log_lines, "gadget_mk1_central");
+            gadget_route_forward(gadget_gpio_msg_queue, msg);
+        break;
+
+        case gadget_msg_init_wifi_ap:
+        case gadget_msg_init_wifi_sta:
+        case gadget_msg_init_ping:
+        case gadget_msg_init_probes:
+        case gadget_msg_sta_state:
+        case gadget_msg_ping_resolved:
+        case gadget_msg_bench_comms:
+            if(log)
+                gadget_route_log("I (%lu) %s: Sending msg to comms", (unsigned long)log_lines, "gadget_mk1_central");
+            gadget_route_forward(gadget_comms_msg_queue, msg);
+        break;
+
+        case gadget_msg_telemetry_rate:
+            if(log)
+                gadget_route_log("I (%lu) %s: telemetry rate", (unsigned long)log_lines, "gadget_mk1_central");
+            gadget_route_telemetry(gadget_central_msg_queue, msg);
+        break;
+
+        case gadget_msg_input_event:
+            if(log)
+                gadget_route_log("I (%lu) %s: input event", (unsigned long)log_lines, "gadget_mk1_central");
+            gadget_route_input(gadget_central_msg_queue, msg);
+        break;
+
+        default:
+            if(log)
+                gadget_route_log("W (%lu) %s: UNKNOWN MESSAGE SENT TO CENTRAL %d", (unsigned long)log_lines,
+                                 "gadget_mk1_central", msg->msg_type);
+            gadget_msg_release(msg);
+        break;
+    }
+}
+
+static void reset_queues(void)
+{
+    memset(&central, 0, sizeof(central));
+    memset(&gpio, 0, sizeof(gpio));
+    memset(&comms, 0, sizeof(comms));
+}
+
+//both routers deliver every type to the same place
+static void test_same_destinations(void)
+{
+    gadget_route_count_t table[3];
+    gadget_msg_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.data[0] = 1;
+    for(int type = 0; type <= gadget_msg_type_max; type++)
+    {
+        msg.msg_type = type;
+
+        reset_queues();
+        gadget_central_route(&msg);
+        table[0] = central;
+        table[1] = gpio;
+        table[2] = comms;
+
+        reset_queues();
+        route_switch(&msg, false);
+        GADGET_CHECK(memcmp(&table[0], &central, sizeof(central)) == 0);
+        GADGET_CHECK(memcmp(&table[1], &gpio, sizeof(gpio)) == 0);
+        GADGET_CHECK(memcmp(&table[2], &comms, sizeof(comms)) == 0);
+        GADGET_CHECK(central.msgs + gpio.msgs + comms.msgs == (type < gadget_msg_type_max ? 1u : 0u));
+    }
+}
+
+//one fixed, mixed stream of msgs through each router
+static double run(int router)
+{
+    static gadget_msg_t msgs[4096];
+    uint32_t seed = 0x2545F491;
+    double start;
+
+    for(size_t i = 0; i < sizeof(msgs) / sizeof(msgs[0]); i++)
+    {
+        msgs[i].msg_type = gadget_test_rand(&seed) % gadget_msg_type_max;
+        msgs[i].data[0] = gadget_test_rand(&seed);
+    }
+
+    reset_queues();
+    start = gadget_test_now_s();
+    for(uint32_t i = 0; i < GADGET_ROUTE_BENCH_MSGS; i++)
+    {
+        gadget_msg_t *msg = &msgs[i & (sizeof(msgs) / sizeof(msgs[0]) - 1)];
+
+        if(router == 0)
+            route_switch(msg, true);
+        else if(router == 1)
+            route_switch(msg, false);
+        else
+            gadget_central_route(msg);
+    }
+    return gadget_test_now_s() - start;
+}
+
+static void test_throughput(void)
+{
+    static const char *names[] = { "switch_logged", "switch", "table" };
+    double elapsed[3];
+
+    for(int router = 0; router < 3; router++)
+    {
+        elapsed[router] = run(router);
+        GADGET_CHECK(central.msgs + gpio.msgs + comms.msgs == GADGET_ROUTE_BENCH_MSGS);
+    }
+    GADGET_CHECK(log_lines == GADGET_ROUTE_BENCH_MSGS);
+
+    for(int router = 0; router < 3; router++)
+    {
+        printf("{\"bench\":\"gadget_route\",\"router\":\"%s\",\"msgs\":%d,\"ns_per_msg\":%.1f}\n",
+               names[router], GADGET_ROUTE_BENCH_MSGS, elapsed[router] * 1e9 / GADGET_ROUTE_BENCH_MSGS);
+    }
+}
+
+int main(void)
+{
+    GADGET_TEST_RUN(test_same_destinations);
+    GADGET_TEST_RUN(test_throughput);
+
+    return GADGET_TEST_RESULT();
+}
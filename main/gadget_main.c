@@ -14,72 +14,71 @@
 #include "includes/gadget_central.h"
 #include "includes/gadget_gpio.h"
 #include "includes/gadget_comms.h"
+#include "includes/gadget_pool.h"
+#include "includes/gadget_bus.h"
+#include "includes/gadget_ap.h"
+#include "includes/gadget_telemetry.h"
+#include "includes/gadget_sta.h"
+#include "includes/gadget_probe.h"
+#include "includes/gadget_dns.h"
+#include "includes/gadget_wifi.h"
+#include "includes/gadget_pattern.h"
+#include "includes/gadget_input.h"
+#include "includes/gadget_console.h"
+#include "includes/gadget_power.h"
+#include "includes/gadget_task.h"
+#include "includes/gadget_profile.h"
+#include "includes/gadget_bench.h"
 
 //Tag
 const static char *gadget_tag = "gadget_mk1_main";
 
 //Function Defines
-static void ch_serial();
 static esp_err_t init_tasks();
 static esp_err_t init_msg_queues();
 
-//FreeRTOS
-QueueHandle_t gadget_central_msg_queue;
-QueueHandle_t gadget_gpio_msg_queue;
-QueueHandle_t gadget_comms_msg_queue;
-
-/**
- * @brief check serial input 
- * 
- */
-static void ch_serial()
-{
-    static char c;
+//per link transport, central has several producers so it always uses a queue
+#define GADGET_POW2(n)              ((n) > 0 && ((n) & ((n) - 1)) == 0)
 
-    c = fgetc(stdin);
+#if CONFIG_GADGET_GPIO_LINK_SPSC
+#define GADGET_GPIO_TRANSPORT       gadget_transport_ring
+_Static_assert(GADGET_POW2(GADGET_GPIO_Q_SIZE) && GADGET_POW2(GADGET_GPIO_HI_Q_SIZE), "gpio ring lanes must be a power of two long");
+#else
+#define GADGET_GPIO_TRANSPORT       gadget_transport_queue
+#endif
 
-    switch(c)
-    {
-        case 0xFF:
-            break;
-
-        case 'm':
-            ESP_LOGI(gadget_tag, "Gadget Serial Input Menu:");
-            ESP_LOGI(gadget_tag, "m - display menu");
-            ESP_LOGI(gadget_tag, "1 - Toggle LED 1");
-            ESP_LOGI(gadget_tag, "2 - Toggle LED 2");
-            ESP_LOGI(gadget_tag, "a - create wifi ap");
-            ESP_LOGI(gadget_tag, "s - create wifi sta");
-            ESP_LOGI(gadget_tag, "p - ping");
-        break;
-
-        case '1':
-            gadget_send_msg(gadget_central_msg_queue, 0, gadget_main_id, gadget_msg_toggle_led_1, NULL);
-        break;
-
-        case '2':
-            gadget_send_msg(gadget_central_msg_queue, 0, gadget_main_id, gadget_msg_toggle_led_2, NULL);
-        break;
-
-        case 'a':
-            gadget_send_msg(gadget_central_msg_queue, 0, gadget_main_id, gadget_msg_init_wifi_ap, NULL);
-        break;
-
-        case 's':
-            gadget_send_msg(gadget_central_msg_queue, 0, gadget_main_id, gadget_msg_init_wifi_sta, NULL);
-        break;
-
-        case 'p':
-            gadget_send_msg(gadget_central_msg_queue, 0, gadget_main_id, gadget_msg_init_ping, NULL);
-        break;
-
-        default:
-            //Nothing
-            ESP_LOGW(gadget_tag, "Invalid char: %c", c);
-        break;
-    }
-}
+#if CONFIG_GADGET_COMMS_LINK_SPSC
+#define GADGET_COMMS_TRANSPORT      gadget_transport_ring
+_Static_assert(GADGET_POW2(GADGET_COMMS_Q_SIZE) && GADGET_POW2(GADGET_COMMS_HI_Q_SIZE), "comms ring lanes must be a power of two long");
+#else
+#define GADGET_COMMS_TRANSPORT      gadget_transport_queue
+#endif
 
+//FreeRTOS
+gadget_msg_queue_t *gadget_central_msg_queue;
+gadget_msg_queue_t *gadget_gpio_msg_queue;
+gadget_msg_queue_t *gadget_comms_msg_queue;
+
+GADGET_MSG_QUEUE_STORAGE(central_msgs, GADGET_CENTRAL_HI_Q_SIZE, GADGET_CENTRAL_Q_SIZE);
+GADGET_MSG_QUEUE_STORAGE(gpio_msgs, GADGET_GPIO_HI_Q_SIZE, GADGET_GPIO_Q_SIZE);
+GADGET_MSG_QUEUE_STORAGE(comms_msgs, GADGET_COMMS_HI_Q_SIZE, GADGET_COMMS_Q_SIZE);
+
+//msg tasks, each consumes one queue
+GADGET_TASK_STATIC(central_task, "gadget_central_task", gadget_central_task,
+                   GADGET_CENTRAL_TASK_STACK, GADGET_CENTRAL_TASK_PRIORITY, GADGET_CENTRAL_TASK_CORE);
+GADGET_TASK_STATIC(gpio_task, "gadget_gpio_task", gadget_gpio_task,
+                   GADGET_GPIO_TASK_STACK, GADGET_GPIO_TASK_PRIORITY, GADGET_GPIO_TASK_CORE);
+GADGET_TASK_STATIC(comms_task, "gadget_comms_task", gadget_comms_task,
+                   GADGET_COMMS_TASK_STACK, GADGET_COMMS_TASK_PRIORITY, GADGET_COMMS_TASK_CORE);
+
+static const struct {
+    const gadget_task_def_t *def;
+    gadget_msg_queue_t **queue;
+} gadget_msg_tasks[] = {
+    { &central_task,    &gadget_central_msg_queue },
+    { &gpio_task,       &gadget_gpio_msg_queue },
+    { &comms_task,      &gadget_comms_msg_queue },
+};
 
 /**
  * @brief init FreeRTOS tasks
@@ -89,34 +88,27 @@ static void ch_serial()
 static esp_err_t init_tasks()
 {
     esp_err_t init = ESP_OK;
-    BaseType_t xStatus;
+    TaskHandle_t handle;
 
     ESP_LOGI(gadget_tag, "-- INITIALIZING TASKS --");
 
-    //central
-    ESP_LOGI(gadget_tag, "creating gadget_central_task");
-    xStatus = xTaskCreate(gadget_central_task, "gadget_central_task", (ESP32_BIT*96), NULL, GADGET_CENTRAL_TASK_PRIORITY, NULL);
-    if(xStatus != pdPASS)
+    for(size_t i = 0; i < sizeof(gadget_msg_tasks) / sizeof(gadget_msg_tasks[0]); i++)
     {
-        ESP_LOGE(gadget_tag, "ERROR with creation of central msg TASK!");
-        init = ESP_FAIL;
+        ESP_LOGI(gadget_tag, "creating %s", gadget_msg_tasks[i].def->name);
+        handle = gadget_task_start(gadget_msg_tasks[i].def, NULL);
+        if(handle == NULL)
+            init = ESP_FAIL;
+        else if(*gadget_msg_tasks[i].queue != NULL)
+            gadget_msg_queue_set_consumer(*gadget_msg_tasks[i].queue, handle);
     }
 
-    ESP_LOGI(gadget_tag, "creating gadget_gpio_task");
-    xStatus = xTaskCreate(gadget_gpio_task, "gadget_gpio_task", (ESP32_BIT*96), NULL, GADGET_GPIO_TASK_PRIORITY, NULL);
-    if(xStatus != pdPASS)
-    {
-        ESP_LOGE(gadget_tag, "ERROR with creation of gpio msg TASK!");
+    ESP_LOGI(gadget_tag, "creating gadget_dns_task");
+    if(gadget_dns_init() != ESP_OK)
         init = ESP_FAIL;
-    }
 
-    ESP_LOGI(gadget_tag, "creating gadget_comms_task");
-    xStatus = xTaskCreate(gadget_comms_task, "gadget_comms_task", (ESP32_BIT*128), NULL, GADGET_COMMS_TASK_PRIORITY, NULL);
-    if(xStatus != pdPASS)
-    {
-        ESP_LOGE(gadget_tag, "ERROR with creation of comms msg TASK!");
+    ESP_LOGI(gadget_tag, "creating gadget_console_task");
+    if(gadget_console_init() != ESP_OK)
         init = ESP_FAIL;
-    }
 
     return init;
 }
@@ -127,9 +119,12 @@ static esp_err_t init_msg_queues()
 
     ESP_LOGI(gadget_tag, "-- INITIALIZING MESSAGE QUEUES --");
 
+    //payload pool, queues only carry handles in pooled mode
+    gadget_pool_init();
+
     //central
-    ESP_LOGI(gadget_tag, "creating central msg queue of size %d", GADGET_CENTRAL_Q_SIZE);
-    gadget_central_msg_queue = xQueueCreate(GADGET_CENTRAL_Q_SIZE, sizeof(gadget_msg_t));
+    ESP_LOGI(gadget_tag, "creating central msg queue of size %d + %d high", GADGET_CENTRAL_Q_SIZE, GADGET_CENTRAL_HI_Q_SIZE);
+    gadget_central_msg_queue = gadget_msg_queue_create("central", GADGET_CENTRAL_HI_Q_SIZE, GADGET_CENTRAL_Q_SIZE, gadget_transport_queue, central_msgs);
     if(gadget_central_msg_queue == NULL) 
     {
         ESP_LOGE(gadget_tag, "ERROR with creation of central msg QUEUE!");
@@ -137,8 +132,8 @@ static esp_err_t init_msg_queues()
     }
 
     //gpio
-    ESP_LOGI(gadget_tag, "creating gpio msg queue of size %d", GADGET_GPIO_Q_SIZE);
-    gadget_gpio_msg_queue = xQueueCreate(GADGET_GPIO_Q_SIZE, sizeof(gadget_msg_t));
+    ESP_LOGI(gadget_tag, "creating gpio msg queue of size %d + %d high", GADGET_GPIO_Q_SIZE, GADGET_GPIO_HI_Q_SIZE);
+    gadget_gpio_msg_queue = gadget_msg_queue_create("gpio", GADGET_GPIO_HI_Q_SIZE, GADGET_GPIO_Q_SIZE, GADGET_GPIO_TRANSPORT, gpio_msgs);
     if(gadget_gpio_msg_queue ==  NULL) 
     {
         ESP_LOGE(gadget_tag, "ERROR with creation of gpio msg queue!");
@@ -146,8 +141,8 @@ static esp_err_t init_msg_queues()
     }
 
     //comms
-    ESP_LOGI(gadget_tag, "creating comms msg queue of size %d", GADGET_COMMS_Q_SIZE);
-    gadget_comms_msg_queue = xQueueCreate(GADGET_COMMS_Q_SIZE, sizeof(gadget_msg_t));
+    ESP_LOGI(gadget_tag, "creating comms msg queue of size %d + %d high", GADGET_COMMS_Q_SIZE, GADGET_COMMS_HI_Q_SIZE);
+    gadget_comms_msg_queue = gadget_msg_queue_create("comms", GADGET_COMMS_HI_Q_SIZE, GADGET_COMMS_Q_SIZE, GADGET_COMMS_TRANSPORT, comms_msgs);
     if(gadget_comms_msg_queue ==  NULL) 
     {
         ESP_LOGE(gadget_tag, "ERROR with creation of comms msg queue!");
@@ -172,6 +167,10 @@ void app_main(void)
     }
     if(run == ESP_OK) boot_seq = 1;
 
+    //power management before any task takes its locks
+    if(gadget_power_init() != ESP_OK)
+        ESP_LOGW(gadget_tag, "power management not applied, running always on");
+
     //init IO
     run = init_msg_queues();
     if(run == ESP_OK) boot_seq = 2;
@@ -179,52 +178,20 @@ void app_main(void)
     run = init_tasks();
     if(run == ESP_OK) boot_seq = 3;
 
+    //baseline taken once every task exists
+    gadget_profile_start();
+
 
     //Send off messages
-    gadget_send_msg(gadget_central_msg_queue, 0, gadget_main_id, gadget_msg_init_gpio, NULL);
+    gadget_send_msg(gadget_central_msg_queue, 0, gadget_prio_high, gadget_main_id, gadget_msg_init_gpio, NULL);
 
-    while(run == ESP_OK)
-    {
-        ch_serial();
-        vTaskDelay(GADGET_TICK_RATE/portTICK_PERIOD_MS);
-    }
-    
+#if CONFIG_GADGET_BENCH_AT_BOOT
+    gadget_bench_start(NULL);
+#endif
+
+    //serial input is handled by the console task from here, nothing left to poll
     if(run != ESP_OK)
     {
         ESP_LOGI(gadget_tag, "BOOT has failed at boot_seq: %d", boot_seq);
     }
 }
-
-/**
- * @brief compile and offload msg
- *
- * @param msg_queue     target queue
- * @param ticks_to_wait send timeout in ticks (0 = non-blocking)
- * @param msg_sender    sender ID
- * @param msg_type      message type
- * @param msg           optional data payload, or NULL
- */
-BaseType_t gadget_send_msg(QueueHandle_t msg_queue,
-                    TickType_t ticks_to_wait,
-                    msg_sender_t msg_sender,
-                    msg_type_t msg_type,
-                    gadget_msg_t *msg)
-{
-    BaseType_t xStatus;
-    gadget_msg_t out;
-    out.msg_sender = msg_sender;
-    out.msg_type = msg_type;
-    if (msg != NULL)
-        memcpy(out.data, msg->data, GADGET_MSG_DATA_SIZE);
-    else
-        memset(out.data, 0, GADGET_MSG_DATA_SIZE);
-    xStatus = xQueueSendToBack(msg_queue, &out, ticks_to_wait);
-    if(xStatus != pdPASS)
-    {
-        ESP_LOGE("gadget_msg_sender", "msg queue (%d) FULL!", msg_sender);
-    }
-
-    return(xStatus);
-}
-
-
@@ -1,8 +1,23 @@
 #ifndef GADGET_AP_H
 #define GADGET_AP_H
 
-void gadget_ap_init();
+//websocket send path counters
+typedef struct {
+    uint32_t depth;         //msgs waiting to be sent
+    uint32_t max_depth;
+    uint32_t frames;        //frames written to the socket
+    uint32_t msgs;          //msgs carried by those frames
+    uint32_t dropped;       //msgs dropped on a full ring, no free block or failed send
+    uint32_t oversize;      //broadcasts dropped for being larger than a send block
+} gadget_ws_tx_stats_t;
+
+bool gadget_ap_init();
+void gadget_ap_stop();
 bool start_ws();
 bool gadget_send_text_ws(const char* payload);
+size_t gadget_ws_broadcast(const uint8_t *payload, size_t len, bool binary);
+size_t gadget_ws_client_count(void);
+void gadget_ws_get_tx_stats(gadget_ws_tx_stats_t *stats);
+void gadget_ws_log_clients(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef GADGET_BENCH_H
+#define GADGET_BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gadget_includes.h"
+
+#define GADGET_BENCH_MAX_PRODUCERS  4
+#define GADGET_BENCH_PAYLOAD_SIZE   8       // stamp, seq, producer, run, fits the unpooled data[]
+
+/**
+ * @brief one benchmark case. Every producer sends GADGET_BENCH_MSGS msgs
+ * to central which forwards them to the gpio and comms handlers.
+ */
+typedef struct {
+    const char *name;
+    uint8_t producers;          //1 to GADGET_BENCH_MAX_PRODUCERS
+    int8_t prio_offset;         //producer priority relative to central
+    uint8_t gpio_pct;           //share of msgs for gpio, the rest go to comms
+    uint8_t gpio_high_pct;      //share of the gpio msgs on the high lane
+    uint8_t comms_high_pct;     //share of the comms msgs on the high lane
+    uint32_t rate;              //msgs/s per producer, 0 to send back to back
+} gadget_bench_case_t;
+
+bool gadget_bench_start(const char *name);
+
+bool gadget_bench_running(void);
+
+void gadget_bench_list(void);
+
+void gadget_bench_sink(const gadget_msg_t *msg);
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef GADGET_BUS_H
+#define GADGET_BUS_H
+
+#include "gadget_includes.h"
+#include "gadget_ring.h"
+
+//how repeated msgs of one type within a burst are merged
+typedef enum {
+    gadget_coalesce_none,
+    gadget_coalesce_once,       //idempotent, keep the first
+    gadget_coalesce_toggle,     //each pair cancels out
+} gadget_coalesce_t;
+
+typedef enum {
+    gadget_transport_queue,     //FreeRTOS queue, any number of producers
+    gadget_transport_ring,      //lock-free SPSC ring, single producer only
+} gadget_transport_t;
+
+//log2 latency buckets, bucket n counts latencies below 2^n us
+#define GADGET_LATENCY_BUCKETS      20
+
+typedef struct {
+    uint32_t sends;
+    uint32_t receives;
+    uint32_t drops;
+    uint32_t max_depth;
+    uint32_t max_latency_us;
+    uint32_t latency[GADGET_LATENCY_BUCKETS];
+} gadget_queue_stats_t;
+
+typedef struct {
+    uint32_t bursts;
+    uint32_t received;
+    uint32_t merged;
+    uint16_t max_burst;
+} gadget_burst_stats_t;
+
+typedef struct {
+    QueueHandle_t queue;
+    StaticQueue_t queue_buf;    //control block of queue
+    gadget_ring_t ring;
+    TaskHandle_t waiter;        //producer blocked on a full ring, or NULL
+    gadget_queue_stats_t stats;
+} gadget_lane_t;
+
+struct gadget_msg_queue {
+    const char *name;
+    gadget_transport_t transport;
+    gadget_lane_t lane[gadget_prio_max];
+    uint8_t high_streak;        //high lane msgs served in a row
+    TaskHandle_t consumer;      //notified on every send
+    gadget_burst_stats_t burst;
+};
+
+//msgs backing both lanes of one queue, ring lanes must be a power of two long
+#define GADGET_MSG_QUEUE_STORAGE(id, high_length, bulk_length) \
+    static gadget_msg_t id[(high_length) + (bulk_length)]
+
+gadget_msg_queue_t *gadget_msg_queue_create(const char *name,
+                    UBaseType_t high_length,
+                    UBaseType_t bulk_length,
+                    gadget_transport_t transport,
+                    gadget_msg_t *storage);
+
+void gadget_msg_queue_set_consumer(gadget_msg_queue_t *msg_queue, TaskHandle_t consumer);
+
+BaseType_t gadget_recv_msg(gadget_msg_queue_t *msg_queue,
+                    gadget_msg_t *msg,
+                    TickType_t ticks_to_wait);
+
+size_t gadget_recv_burst(gadget_msg_queue_t *msg_queue,
+                    gadget_msg_t *burst,
+                    size_t max_msgs,
+                    TickType_t ticks_to_wait);
+
+void gadget_bus_get_burst_stats(const gadget_msg_queue_t *msg_queue, gadget_burst_stats_t *stats);
+
+void gadget_bus_log_burst_stats(void);
+
+void gadget_bus_get_queue_stats(const gadget_msg_queue_t *msg_queue, msg_prio_t msg_prio, gadget_queue_stats_t *stats);
+
+uint32_t gadget_bus_latency_percentile(const gadget_queue_stats_t *stats, uint8_t percentile);
+
+void gadget_bus_log_queue_stats(void);
+
+void gadget_bus_set_drop_log(bool on);
+
+#endif
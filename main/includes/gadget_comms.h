@@ -1,6 +1,15 @@
 #ifndef GADGET_COMMS_H
 #define GADGET_COMMS_H
 
+#include <stdint.h>
+
+//gadget_comms_get_status bits
+#define GADGET_COMMS_AP_UP      0x01
+#define GADGET_COMMS_STA_UP     0x02
+#define GADGET_COMMS_PING_UP    0x04
+#define GADGET_COMMS_PING_WAIT  0x08    // start requested, target still resolving
+
 void gadget_comms_task(void *pvParams);
+uint8_t gadget_comms_get_status(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef GADGET_CONSOLE_H
+#define GADGET_CONSOLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#define GADGET_CONSOLE_LINE_LEN     96
+#define GADGET_CONSOLE_MAX_ARGS     8
+
+/**
+ * @brief command handler
+ *
+ * @param argc  words on the line, argv[0] is the command
+ * @param argv
+ * @return esp_err_t ESP_ERR_INVALID_ARG prints the command's usage
+ */
+typedef esp_err_t (*gadget_cmd_fn_t)(int argc, char **argv);
+
+typedef struct {
+    const char *name;
+    const char *usage;          //arguments, shown by help
+    const char *help;
+    uint8_t min_args;           //not counting the command itself
+    uint8_t max_args;
+    gadget_cmd_fn_t fn;
+} gadget_cmd_t;
+
+typedef struct {
+    uint32_t wakeups;           //uart events the console task woke for
+    uint32_t bytes;
+    uint32_t lines;
+    uint32_t errors;            //unknown commands and bad arguments
+    uint32_t overruns;          //rx fifo or ring buffer overflowed, input flushed
+} gadget_console_stats_t;
+
+esp_err_t gadget_console_init(void);
+
+void gadget_console_feed(const uint8_t *data, size_t len);
+
+esp_err_t gadget_console_exec(char *line);
+
+void gadget_console_get_stats(gadget_console_stats_t *stats);
+
+void gadget_console_log_stats(void);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef GADGET_DNS_H
+#define GADGET_DNS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+#include "esp_err.h"
+
+#define GADGET_DNS_HOST_LEN         64
+
+typedef struct {
+    uint32_t hits;
+    uint32_t stale_hits;        //served past expiry while a refresh ran
+    uint32_t misses;
+    uint32_t resolves;
+    uint32_t failures;
+    uint32_t evictions;
+} gadget_dns_stats_t;
+
+/**
+ * @brief called from the resolver task once a queued lookup completes
+ *
+ * @param host
+ * @param ok        false if resolution failed
+ * @param arg
+ */
+typedef void (*gadget_dns_cb_t)(const char *host, bool ok, void *arg);
+
+esp_err_t gadget_dns_init(void);
+
+esp_err_t gadget_dns_lookup(const char *host, struct in_addr *addr, gadget_dns_cb_t cb, void *arg);
+
+void gadget_dns_prefetch(const char *host);
+
+void gadget_dns_get_stats(gadget_dns_stats_t *stats);
+
+void gadget_dns_log_stats(void);
+
+#endif
@@ -1,6 +1,31 @@
 #ifndef GADGET_GPIO_H
 #define GADGET_GPIO_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#include "gadget_includes.h"
+
+#define GADGET_GPIO_MAX_PINS        32      // one bit per pin table entry in every mask
+
+#if CONFIG_GADGET_GPIO_MOCK
+//stand in for the output register banks, pins 0 - 31 and 32 - 63
+typedef struct {
+    uint32_t out[2];
+    uint32_t w1ts_writes;
+    uint32_t w1tc_writes;
+} gadget_gpio_regs_t;
+
+const gadget_gpio_regs_t *gadget_gpio_mock_regs(void);
+#endif
+
 void gadget_gpio_task(void *pvParams);
+uint32_t gadget_gpio_get_states(void);
+uint32_t gadget_gpio_apply(uint32_t set_mask, uint32_t clear_mask);
+bool gadget_gpio_write(uint32_t set_mask, uint32_t clear_mask, msg_sender_t sender);
+int gadget_gpio_pin(int entry);
+esp_err_t gadget_gpio_reclaim(int entry);
 
-#endif
\ No newline at end of file
+#endif
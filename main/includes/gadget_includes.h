@@ -5,58 +5,94 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 
-#define ESP32_BIT                   32
+#include "gadget_pool.h"
+#include "gadget_msg_types.h"
+
+//nothing runs in ISR context on the POSIX port of the linux target
+#if CONFIG_IDF_TARGET_LINUX && !defined(portENTER_CRITICAL_SAFE)
+#define portENTER_CRITICAL_SAFE(mux)    portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux)     portEXIT_CRITICAL(mux)
+#endif
 
-#define GADGET_TICK_RATE            100
+#define ESP32_BIT                   32
 
-#define GADGET_MSG_SHORT_DELAY      1000
 #define GADGET_MSG_LONG_DELAY       5000
 
 #define GADGET_MSG_DATA_SIZE        10
 
-#define GADGET_CENTRAL_TASK_PRIORITY  5
-#define GADGET_CENTRAL_Q_SIZE         10
+#define GADGET_MSG_BURST_SIZE       8
+
+//high lane msgs served in a row before a waiting bulk msg gets a turn
+#define GADGET_MSG_STARVATION_BOUND 4
+
+#define GADGET_CENTRAL_TASK_PRIORITY  CONFIG_GADGET_CENTRAL_TASK_PRIORITY
+#define GADGET_CENTRAL_TASK_STACK     CONFIG_GADGET_CENTRAL_TASK_STACK
+#define GADGET_CENTRAL_TASK_CORE      CONFIG_GADGET_CENTRAL_TASK_CORE
+#define GADGET_CENTRAL_Q_SIZE         CONFIG_GADGET_CENTRAL_Q_SIZE
+#define GADGET_CENTRAL_HI_Q_SIZE      CONFIG_GADGET_CENTRAL_HI_Q_SIZE
+
+#define GADGET_GPIO_TASK_PRIORITY     CONFIG_GADGET_GPIO_TASK_PRIORITY
+#define GADGET_GPIO_TASK_STACK        CONFIG_GADGET_GPIO_TASK_STACK
+#define GADGET_GPIO_TASK_CORE         CONFIG_GADGET_GPIO_TASK_CORE
+#define GADGET_GPIO_Q_SIZE            CONFIG_GADGET_GPIO_Q_SIZE
+#define GADGET_GPIO_HI_Q_SIZE         CONFIG_GADGET_GPIO_HI_Q_SIZE
 
-#define GADGET_GPIO_TASK_PRIORITY     1
-#define GADGET_GPIO_Q_SIZE            4
+#define GADGET_COMMS_TASK_PRIORITY    CONFIG_GADGET_COMMS_TASK_PRIORITY
+#define GADGET_COMMS_TASK_STACK       CONFIG_GADGET_COMMS_TASK_STACK
+#define GADGET_COMMS_TASK_CORE        CONFIG_GADGET_COMMS_TASK_CORE
+#define GADGET_COMMS_Q_SIZE           CONFIG_GADGET_COMMS_Q_SIZE
+#define GADGET_COMMS_HI_Q_SIZE        CONFIG_GADGET_COMMS_HI_Q_SIZE
 
-#define GADGET_COMMS_TASK_PRIORITY     4
-#define GADGET_COMMS_Q_SIZE            4
+//msg queues, backed by a FreeRTOS queue or a lock-free ring (see gadget_bus.h)
+typedef struct gadget_msg_queue gadget_msg_queue_t;
 
-//FreeRTOS
-extern QueueHandle_t gadget_central_msg_queue;
-extern QueueHandle_t gadget_gpio_msg_queue;
-extern QueueHandle_t gadget_comms_msg_queue;
+extern gadget_msg_queue_t *gadget_central_msg_queue;
+extern gadget_msg_queue_t *gadget_gpio_msg_queue;
+extern gadget_msg_queue_t *gadget_comms_msg_queue;
 
 //typedef & structs
 typedef enum __attribute__((packed)) {
     gadget_main_id,
     gadget_central_id,
     gadget_comms_id,
+    gadget_ws_id,
+    gadget_bench_id,
 } msg_sender_t;
 
-typedef enum __attribute__((packed)) {
-    gadget_msg_init_gpio,
-    gadget_msg_toggle_led_1,
-    gadget_msg_toggle_led_2,
-    gadget_msg_init_wifi_ap,
-    gadget_msg_init_wifi_sta,
-    gadget_msg_init_ping
-} msg_type_t;
 
 typedef struct {
     msg_sender_t msg_sender;
     msg_type_t msg_type;
+    msg_prio_t msg_prio;
+    uint32_t msg_stamp;             //enqueue time, esp_timer us
+#if CONFIG_GADGET_BUS_POOLED
+    uint16_t payload_len;
+    gadget_pool_handle_t payload;
+#else
     uint8_t data[GADGET_MSG_DATA_SIZE];
+#endif
 } gadget_msg_t;
 
 //functions
-BaseType_t gadget_send_msg(QueueHandle_t msg_queue,
+BaseType_t gadget_send_msg(gadget_msg_queue_t *msg_queue,
                     TickType_t ticks_to_wait,
+                    msg_prio_t msg_prio,
                     msg_sender_t msg_sender,
                     msg_type_t msg_type,
                     gadget_msg_t *msg);
 
+BaseType_t gadget_send_msg_from_isr(gadget_msg_queue_t *msg_queue,
+                    msg_prio_t msg_prio,
+                    msg_sender_t msg_sender,
+                    msg_type_t msg_type,
+                    gadget_msg_t *msg,
+                    BaseType_t *task_woken);
+
+uint8_t *gadget_msg_alloc_payload(gadget_msg_t *msg, size_t len);
+const uint8_t *gadget_msg_payload(const gadget_msg_t *msg);
+size_t gadget_msg_payload_len(const gadget_msg_t *msg);
+void gadget_msg_release(gadget_msg_t *msg);
+
 
 
 
@@ -0,0 +1,46 @@
+#ifndef GADGET_INPUT_H
+#define GADGET_INPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#include "gadget_includes.h"
+
+#define GADGET_INPUT_MAX_PINS       32
+#define GADGET_INPUT_LATENCY_BUCKETS 16     // log2 us, the last one is open ended
+
+/*
+ * gadget_msg_input_event payload: [0] input index, [1] debounced level,
+ * [2..5] last edge of the burst, [6..9] when it settled, both esp_timer us LE
+ */
+
+typedef struct {
+    uint32_t edges;             //captured by the ISR
+    uint32_t overflows;         //edges lost on a full ring
+    uint32_t events;            //debounced changes posted to central
+    uint32_t dropped;           //events central had no room for
+    uint32_t max_dwell_us;      //ISR capture to drain
+    uint32_t max_delivery_us;   //settled to central handler
+    uint32_t max_latency_us;    //last edge ISR to central handler
+    uint32_t latency[GADGET_INPUT_LATENCY_BUCKETS];
+} gadget_input_stats_t;
+
+esp_err_t gadget_input_init(void);
+
+uint32_t gadget_input_get_states(void);
+
+void gadget_input_handle_event(const gadget_msg_t *msg);
+
+void gadget_input_get_stats(gadget_input_stats_t *stats);
+
+uint32_t gadget_input_latency_percentile(const gadget_input_stats_t *stats, uint8_t percentile);
+
+void gadget_input_log_stats(void);
+
+#if CONFIG_GADGET_GPIO_MOCK
+void gadget_input_mock_edge(int input, int level);
+#endif
+
+#endif
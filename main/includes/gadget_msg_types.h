@@ -0,0 +1,54 @@
+#ifndef GADGET_MSG_TYPES_H
+#define GADGET_MSG_TYPES_H
+
+/*
+ * Message types and lanes without any FreeRTOS dependency, so the wire codec
+ * can be built on the host on its own.
+ */
+
+//bus lane, high is served ahead of bulk
+typedef enum __attribute__((packed)) {
+    gadget_prio_high,
+    gadget_prio_bulk,
+    gadget_prio_max
+} msg_prio_t;
+
+//who may post a message type from the websocket protocol
+#define gadget_wire_local           0       // device internal, rejected on the wire
+#define gadget_wire_remote          1       // clients may send it
+
+/**
+ * @brief message type list
+ *
+ * X(type, wire id, destination queue, central handler, burst coalescing, remote)
+ * msg_type_t, the central route table, the coalescing table and the wire
+ * table are all generated from this list, so a new message type only needs
+ * a new line here. The wire id is what clients put on the wire and never
+ * changes once shipped, the position in the list does not matter. A new type
+ * takes the next unused wire id.
+ */
+#define GADGET_MSG_TYPE_LIST(X)                                                                                                     \
+    X(gadget_msg_init_gpio,        0, gadget_gpio_msg_queue,    gadget_route_forward,   gadget_coalesce_once,   gadget_wire_local)  \
+    X(gadget_msg_toggle_led_1,     1, gadget_gpio_msg_queue,    gadget_route_forward,   gadget_coalesce_toggle, gadget_wire_remote) \
+    X(gadget_msg_toggle_led_2,     2, gadget_gpio_msg_queue,    gadget_route_forward,   gadget_coalesce_toggle, gadget_wire_remote) \
+    X(gadget_msg_init_wifi_ap,     3, gadget_comms_msg_queue,   gadget_route_forward,   gadget_coalesce_toggle, gadget_wire_local)  \
+    X(gadget_msg_init_wifi_sta,    4, gadget_comms_msg_queue,   gadget_route_forward,   gadget_coalesce_toggle, gadget_wire_local)  \
+    X(gadget_msg_init_ping,        5, gadget_comms_msg_queue,   gadget_route_forward,   gadget_coalesce_toggle, gadget_wire_local)  \
+    X(gadget_msg_telemetry_rate,   6, gadget_central_msg_queue, gadget_route_telemetry, gadget_coalesce_none,   gadget_wire_remote) \
+    X(gadget_msg_gpio_write,       9, gadget_gpio_msg_queue,    gadget_route_forward,   gadget_coalesce_none,   gadget_wire_remote) \
+    X(gadget_msg_pattern,         10, gadget_gpio_msg_queue,    gadget_route_forward,   gadget_coalesce_none,   gadget_wire_remote) \
+    X(gadget_msg_input_event,     11, gadget_central_msg_queue, gadget_route_input,     gadget_coalesce_none,   gadget_wire_local)  \
+    X(gadget_msg_bench_gpio,      12, gadget_gpio_msg_queue,    gadget_route_forward,   gadget_coalesce_none,   gadget_wire_local)  \
+    X(gadget_msg_bench_comms,     13, gadget_comms_msg_queue,   gadget_route_forward,   gadget_coalesce_none,   gadget_wire_local)  \
+    X(gadget_msg_init_probes,      7, gadget_comms_msg_queue,   gadget_route_forward,   gadget_coalesce_toggle, gadget_wire_local)  \
+    X(gadget_msg_sta_state,        8, gadget_comms_msg_queue,   gadget_route_forward,   gadget_coalesce_none,   gadget_wire_local)  \
+    X(gadget_msg_ping_resolved,   14, gadget_comms_msg_queue,   gadget_route_forward,   gadget_coalesce_none,   gadget_wire_local)
+
+#define GADGET_MSG_TYPE_ENUM(type, wire, queue, handler, coalesce, remote) type,
+
+typedef enum __attribute__((packed)) {
+    GADGET_MSG_TYPE_LIST(GADGET_MSG_TYPE_ENUM)
+    gadget_msg_type_max
+} msg_type_t;
+
+#endif
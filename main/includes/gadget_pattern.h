@@ -0,0 +1,63 @@
+#ifndef GADGET_PATTERN_H
+#define GADGET_PATTERN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "gadget_includes.h"
+
+#define GADGET_PATTERN_MAX_STEPS    8
+#define GADGET_PATTERN_JITTER_BUCKETS 16    // log2 us, the last one is open ended
+
+//one sequence step, level in bit 15 and the hold time in ms below it
+#define GADGET_PATTERN_STEP(level, ms)  ((uint16_t)(((level) ? 0x8000 : 0) | ((ms) & 0x7FFF)))
+
+/**
+ * @brief kinds carried in gadget_msg_pattern payload[1]
+ *
+ * Payload: [0] pin table entry, [1] kind, [2..3] repeat count LE (0 runs
+ * until replaced), then per kind
+ *   blink      [4..5] on ms, [6..7] off ms
+ *   fade       [4..5] ramp ms, [6] peak duty in %
+ *   sequence   [4..] GADGET_PATTERN_STEP values LE, one per step
+ */
+typedef enum {
+    gadget_pattern_kind_off,
+    gadget_pattern_kind_on,
+    gadget_pattern_kind_blink,
+    gadget_pattern_kind_fade,
+    gadget_pattern_kind_sequence,
+} gadget_pattern_kind_t;
+
+//lateness of sequence edges against their deadline
+typedef struct {
+    uint32_t edges;
+    uint32_t max_late_us;
+    uint64_t total_late_us;
+    uint32_t late[GADGET_PATTERN_JITTER_BUCKETS];
+} gadget_pattern_jitter_t;
+
+esp_err_t gadget_pattern_blink(int entry, uint16_t on_ms, uint16_t off_ms, uint16_t repeat);
+
+esp_err_t gadget_pattern_fade(int entry, uint16_t ramp_ms, uint8_t peak_pct, uint16_t repeat);
+
+esp_err_t gadget_pattern_sequence(int entry, const uint16_t *steps, size_t count, uint16_t repeat);
+
+esp_err_t gadget_pattern_stop(int entry);
+
+void gadget_pattern_handle_msg(const gadget_msg_t *msg);
+
+void gadget_pattern_get_jitter(gadget_pattern_jitter_t *jitter);
+
+uint32_t gadget_pattern_jitter_percentile(const gadget_pattern_jitter_t *jitter, uint8_t percentile);
+
+void gadget_pattern_reset_jitter(void);
+
+void gadget_pattern_log_stats(void);
+
+bool gadget_pattern_load_test(void);
+
+#endif
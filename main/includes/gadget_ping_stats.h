@@ -0,0 +1,56 @@
+#ifndef GADGET_PING_STATS_H
+#define GADGET_PING_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief RTT histogram, 4 sub buckets per power of two ms
+ *
+ * Buckets 0 - 3 are exact, above that each bucket is a quarter of an
+ * octave wide, which keeps percentiles within 25% up to 64 s.
+ */
+#define GADGET_PING_HIST_BUCKETS    60
+
+//sliding loss windows, in probes
+#define GADGET_PING_WINDOW_SHORT    10
+#define GADGET_PING_WINDOW_LONG     100
+#define GADGET_PING_WINDOW_BITS     128
+
+typedef struct {
+    uint32_t sent;
+    uint32_t received;
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint64_t sum_ms;
+    uint32_t last_ms;
+    uint32_t jitter_us;             //RFC 3550 style smoothed RTT variation
+    uint32_t hist[GADGET_PING_HIST_BUCKETS];
+    uint32_t window[GADGET_PING_WINDOW_BITS / 32];  //1 = lost, newest in bit (sent - 1)
+} gadget_ping_stats_t;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t received;
+    uint32_t min_ms;
+    uint32_t mean_ms;
+    uint32_t max_ms;
+    uint32_t p50_ms;
+    uint32_t p95_ms;
+    uint32_t p99_ms;
+    uint32_t jitter_us;
+    uint16_t loss_short_permille;   //over the last GADGET_PING_WINDOW_SHORT probes
+    uint16_t loss_long_permille;    //over the last GADGET_PING_WINDOW_LONG probes
+} gadget_ping_summary_t;
+
+void gadget_ping_stats_reset(gadget_ping_stats_t *stats);
+
+void gadget_ping_stats_add_reply(gadget_ping_stats_t *stats, uint32_t rtt_ms);
+
+void gadget_ping_stats_add_timeout(gadget_ping_stats_t *stats);
+
+uint32_t gadget_ping_stats_percentile(const gadget_ping_stats_t *stats, uint8_t percentile);
+
+void gadget_ping_stats_summarize(const gadget_ping_stats_t *stats, gadget_ping_summary_t *summary);
+
+#endif
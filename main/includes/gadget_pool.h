@@ -0,0 +1,44 @@
+#ifndef GADGET_POOL_H
+#define GADGET_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define GADGET_POOL_NONE            0
+
+//handle to a refcounted pool block, GADGET_POOL_NONE if empty
+typedef uint16_t gadget_pool_handle_t;
+
+typedef enum {
+    gadget_pool_small,
+    gadget_pool_large,
+    gadget_pool_class_max
+} gadget_pool_class_t;
+
+typedef struct {
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t exhausted;
+    uint16_t in_use;
+    uint16_t peak;
+    uint16_t blocks;
+    uint16_t block_size;
+} gadget_pool_stats_t;
+
+void gadget_pool_init(void);
+
+gadget_pool_handle_t gadget_pool_alloc(size_t len);
+
+void *gadget_pool_data(gadget_pool_handle_t handle);
+
+size_t gadget_pool_block_size(gadget_pool_handle_t handle);
+
+void gadget_pool_retain(gadget_pool_handle_t handle);
+
+void gadget_pool_release(gadget_pool_handle_t handle);
+
+void gadget_pool_get_stats(gadget_pool_class_t pool_class, gadget_pool_stats_t *stats);
+
+void gadget_pool_log_stats(void);
+
+#endif
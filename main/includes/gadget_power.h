@@ -0,0 +1,30 @@
+#ifndef GADGET_POWER_H
+#define GADGET_POWER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#include "gadget_includes.h"
+
+#define GADGET_POWER_CORES          portNUM_PROCESSORS
+
+//activity of each core over one report window
+typedef struct {
+    uint32_t window_ms;
+    uint32_t wakeups[GADGET_POWER_CORES];       //idle loop passes, one per return to idle
+    uint16_t idle_permille[GADGET_POWER_CORES]; //0xFFFF without run time stats
+} gadget_power_report_t;
+
+esp_err_t gadget_power_init(void);
+
+bool gadget_power_light_sleep(void);
+
+void gadget_power_sample(gadget_power_report_t *report);
+
+void gadget_power_get_wakeups(uint32_t *wakeups);
+
+void gadget_power_log_stats(void);
+
+#endif
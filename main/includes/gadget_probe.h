@@ -0,0 +1,41 @@
+#ifndef GADGET_PROBE_H
+#define GADGET_PROBE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "gadget_ping_stats.h"
+
+#define GADGET_PROBE_HOST_LEN       64
+
+typedef enum {
+    gadget_probe_icmp,          //echo request / reply
+    gadget_probe_tcp,           //time to complete a TCP handshake
+} gadget_probe_kind_t;
+
+//one probe outcome in the shared results store
+typedef struct {
+    uint32_t stamp_ms;          //when the probe was sent
+    uint16_t rtt_ms;
+    uint8_t target;
+    bool ok;
+} gadget_probe_result_t;
+
+bool gadget_probe_start(void);
+
+void gadget_probe_stop(void);
+
+bool gadget_probe_running(void);
+
+int gadget_probe_add(const char *host, gadget_probe_kind_t kind, uint16_t port, uint32_t interval_ms);
+
+bool gadget_probe_remove(int target);
+
+size_t gadget_probe_get_results(gadget_probe_result_t *results, size_t max_results);
+
+bool gadget_probe_get_summary(int target, gadget_ping_summary_t *summary);
+
+void gadget_probe_log_stats(void);
+
+#endif
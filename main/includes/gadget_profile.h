@@ -0,0 +1,43 @@
+#ifndef GADGET_PROFILE_H
+#define GADGET_PROFILE_H
+
+#include <stdint.h>
+
+#include "gadget_includes.h"
+#include "gadget_telemetry.h"
+
+#define GADGET_PROFILE_CORES        2       // fixed on the wire, 0xFFFF for a core that is not there
+#define GADGET_PROFILE_FRAME_TASKS  14      // busiest tasks sent per frame
+#define GADGET_PROFILE_NAME_LEN     10
+#define GADGET_PROFILE_UNTRACKED    0xFFFF  // switches of a task the bus does not see wake
+
+/**
+ * @brief one profiler window, the payload of a GADGET_PROTO_TYPE_PROFILE
+ * frame. Packed and little endian, only task_count entries of tasks are
+ * sent and they come busiest first.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t seq;
+    uint32_t window_ms;
+    uint16_t cost_us;           //sampling cost of this window
+    uint16_t core_busy_permille[GADGET_PROFILE_CORES];
+    struct __attribute__((packed)) {
+        uint16_t waits;         //msgs received in the window, both lanes
+        uint32_t p99_wait_us;   //send to receive, both lanes
+    } queues[GADGET_TELEMETRY_QUEUES];
+    uint8_t task_count;
+    struct __attribute__((packed)) {
+        char name[GADGET_PROFILE_NAME_LEN];     //gadget_ and _task trimmed, not terminated when full
+        uint8_t core;           //0xFF when not pinned
+        uint16_t cpu_permille;  //of one core
+        uint16_t switches;      //times switched in during the window
+    } tasks[GADGET_PROFILE_FRAME_TASKS];
+} gadget_profile_frame_t;
+
+void gadget_profile_start(void);
+
+void gadget_profile_sample(void);
+
+void gadget_profile_log_stats(void);
+
+#endif
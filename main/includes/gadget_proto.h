@@ -0,0 +1,45 @@
+#ifndef GADGET_PROTO_H
+#define GADGET_PROTO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "gadget_msg_types.h"
+
+/**
+ * @brief binary websocket framing, little endian
+ *
+ * | 0       | 1    | 2     | 3..4 | 5..          |
+ * | version | type | flags | len  | len bytes    |
+ *
+ * Client to device frames carry the wire id of a remote message type (see
+ * GADGET_MSG_TYPE_LIST), device to client frames a GADGET_PROTO_TYPE_*
+ * value. Several frames may be packed back to back in one websocket message.
+ * Only needs the message type list, so it builds on the host.
+ */
+#define GADGET_PROTO_VERSION        2       // 2: fixed wire ids, high lane is opt in
+#define GADGET_PROTO_HEADER_SIZE    5
+
+#define GADGET_PROTO_FLAG_HIGH      0x01    //post on the high lane, bulk otherwise
+
+//device to client frame types, kept clear of msg_type_t
+#define GADGET_PROTO_TYPE_TELEMETRY 0x80
+#define GADGET_PROTO_TYPE_PROFILE   0x81
+
+typedef struct {
+    uint8_t type;               //on the wire
+    msg_type_t msg_type;        //decoded client frames only
+    msg_prio_t prio;
+    uint16_t len;
+    const uint8_t *payload;
+} gadget_proto_frame_t;
+
+size_t gadget_proto_encode(const gadget_proto_frame_t *frame, uint8_t *out, size_t out_size);
+
+esp_err_t gadget_proto_decode(const uint8_t *buf, size_t len, gadget_proto_frame_t *frame, size_t *consumed);
+
+int gadget_proto_wire_id(msg_type_t msg_type);
+
+#endif
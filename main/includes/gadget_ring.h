@@ -0,0 +1,31 @@
+#ifndef GADGET_RING_H
+#define GADGET_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief lock-free single producer / single consumer ring of fixed size items
+ *
+ * GCC __atomic builtins, no FreeRTOS dependency, so the same code runs on
+ * the target (task or ISR producer) and on a Linux host.
+ */
+typedef struct {
+    uint8_t *buf;
+    uint32_t item_size;
+    uint32_t mask;          //capacity - 1, capacity is a power of two
+    uint32_t head;          //written by the producer only
+    uint32_t tail;          //written by the consumer only
+} gadget_ring_t;
+
+uint32_t gadget_ring_capacity_for(uint32_t length);
+
+void gadget_ring_init(gadget_ring_t *ring, void *buf, uint32_t item_size, uint32_t capacity);
+
+bool gadget_ring_push(gadget_ring_t *ring, const void *item);
+
+bool gadget_ring_pop(gadget_ring_t *ring, void *item);
+
+uint32_t gadget_ring_count(const gadget_ring_t *ring);
+
+#endif
@@ -1,10 +1,68 @@
 #ifndef GADGET_STA_H
 #define GADGET_STA_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gadget_ping_stats.h"
+
+//carried in gadget_msg_sta_state payload[0], the disconnect reason in payload[1]
+typedef enum {
+    gadget_sta_idle,
+    gadget_sta_connecting,
+    gadget_sta_associated,      //joined the AP, waiting for an IP
+    gadget_sta_online,
+    gadget_sta_backoff,         //waiting to retry
+} gadget_sta_state_t;
+
+//STA start to its first IP, one sample per gadget_sta_init
+typedef struct {
+    uint32_t count;
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint64_t total_ms;
+} gadget_sta_start_stats_t;
+
+typedef struct {
+    gadget_sta_state_t state;
+    uint32_t attempts;
+    uint32_t connects;          //times an IP was obtained
+    uint32_t disconnects;
+    uint8_t last_reason;
+    uint32_t backoff_ms;        //delay before the pending retry
+    uint32_t last_connect_ms;   //first attempt to IP, across retries
+    uint32_t min_connect_ms;
+    uint32_t max_connect_ms;
+    uint64_t total_connect_ms;
+    uint32_t start_to_ip_ms;    //last STA start to its first IP
+    bool start_fast_path;       //that IP came from the NVS fast connect cache
+    gadget_sta_start_stats_t start_fast;    //starts that connected via the fast connect cache
+    gadget_sta_start_stats_t start_scan;    //starts that connected after a full scan
+    uint32_t fast_fallbacks;    //cached BSSID / channel failed, full scan used
+} gadget_sta_metrics_t;
+
 bool gadget_sta_init(char *ssid, char *pwd);
 
-bool gadget_init_ping(void);
+bool gadget_sta_stop(void);
+
+gadget_sta_state_t gadget_sta_get_state(void);
+
+void gadget_sta_get_metrics(gadget_sta_metrics_t *metrics);
+
+void gadget_sta_log_metrics(void);
+
+bool gadget_init_ping(bool *resolving);
 
 bool gadget_stop_ping();
 
+bool gadget_ping_running(void);
+
+bool gadget_ping_set_target(const char *host);
+
+void gadget_ping_get_target(char *host);
+
+void gadget_ping_get_summary(gadget_ping_summary_t *summary);
+
+void gadget_ping_log_stats(void);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef GADGET_TASK_H
+#define GADGET_TASK_H
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_err.h"
+#include "esp_idf_version.h"
+
+#define GADGET_TASK_MAX             8       // long lived tasks tracked for the stack report
+#define GADGET_TASK_ANY_CORE        -1
+
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 3, 0)
+#define xTaskGetIdleTaskHandleForCore   xTaskGetIdleTaskHandleForCPU
+#endif
+
+/**
+ * @brief a statically allocated task, see GADGET_TASK_STATIC
+ */
+typedef struct {
+    const char *name;
+    TaskFunction_t fn;
+    uint32_t stack_size;        //bytes
+    UBaseType_t priority;
+    int core;                   //GADGET_TASK_ANY_CORE for no affinity
+    StackType_t *stack;
+    StaticTask_t *tcb;
+} gadget_task_def_t;
+
+//stack and control block in .bss, nothing comes from the heap at start up
+#define GADGET_TASK_STATIC(id, task_name, task_fn, stack_bytes, task_prio, task_core)  \
+    static StackType_t id##_stack[(stack_bytes) / sizeof(StackType_t)];                 \
+    static StaticTask_t id##_tcb;                                                       \
+    static const gadget_task_def_t id = {                                               \
+        .name = (task_name), .fn = (task_fn), .stack_size = (stack_bytes),              \
+        .priority = (task_prio), .core = (task_core),                                   \
+        .stack = id##_stack, .tcb = &id##_tcb,                                          \
+    }
+
+TaskHandle_t gadget_task_start(const gadget_task_def_t *def, void *arg);
+
+void gadget_task_log_stacks(void);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef GADGET_TELEMETRY_H
+#define GADGET_TELEMETRY_H
+
+#include <stdint.h>
+
+#include "gadget_includes.h"
+
+#define GADGET_TELEMETRY_QUEUES     3   //central, gpio, comms
+
+/**
+ * @brief one telemetry sample, the payload of a GADGET_PROTO_TYPE_TELEMETRY
+ * frame. Packed and little endian, as laid out in memory on the esp32.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t seq;
+    uint32_t uptime_ms;
+    uint32_t gpio_states;       //bit n is LED n + 1
+    uint8_t comms_status;       //GADGET_COMMS_* bits
+    uint8_t ws_clients;
+    uint32_t heap_free;
+    uint32_t heap_min_free;
+    struct __attribute__((packed)) {
+        uint32_t sends;
+        uint32_t drops;
+        uint32_t p99_latency_us;
+    } lanes[GADGET_TELEMETRY_QUEUES][gadget_prio_max];
+    uint32_t ws_frames;
+    uint32_t ws_dropped;
+    struct __attribute__((packed)) {
+        uint32_t sent;
+        uint32_t received;
+        uint16_t min_ms;
+        uint16_t mean_ms;
+        uint16_t max_ms;
+        uint16_t p50_ms;
+        uint16_t p95_ms;
+        uint16_t p99_ms;
+        uint32_t jitter_us;
+        uint16_t loss_short_permille;
+        uint16_t loss_long_permille;
+    } ping;
+    uint32_t sample_cost_us;    //cost of the previous sample
+} gadget_telemetry_sample_t;
+
+typedef struct {
+    uint32_t period_ms;         //0 while paused
+    uint32_t samples;
+    uint32_t broadcasts;
+    uint32_t skipped;           //periods with no client connected
+    uint32_t max_cost_us;
+    uint64_t total_cost_us;
+} gadget_telemetry_stats_t;
+
+void gadget_telemetry_start(void);
+void gadget_telemetry_set_period(uint32_t period_ms);
+void gadget_telemetry_get_stats(gadget_telemetry_stats_t *stats);
+void gadget_telemetry_log_stats(void);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef GADGET_WIFI_H
+#define GADGET_WIFI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+
+//one add / remove of an interface, or the one time stack init
+typedef struct {
+    uint32_t init_us;           //netif, event loop and driver bring up
+    uint32_t transitions;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint32_t failures;
+} gadget_wifi_stats_t;
+
+esp_err_t gadget_wifi_init(void);
+
+esp_netif_t *gadget_wifi_add(wifi_interface_t ifx, wifi_config_t *config);
+
+esp_err_t gadget_wifi_remove(wifi_interface_t ifx);
+
+bool gadget_wifi_is_up(wifi_interface_t ifx);
+
+void gadget_wifi_get_stats(gadget_wifi_stats_t *stats);
+
+void gadget_wifi_log_stats(void);
+
+#endif
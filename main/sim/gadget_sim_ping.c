@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "ping/ping_sock.h"
+
+const static char *gadget_tag = "gadget_mk1_sim_ping";
+
+#define GADGET_SIM_PING_RTT_MS      CONFIG_GADGET_SIM_PING_RTT_MS
+#define GADGET_SIM_PING_JITTER_MS   CONFIG_GADGET_SIM_PING_JITTER_MS
+#define GADGET_SIM_PING_LOSS        CONFIG_GADGET_SIM_PING_LOSS_PERMILLE
+
+/*
+ * Stand-in ping session for the host build. Every interval one echo is
+ * "sent" and settled on the spot: lost with the configured probability,
+ * otherwise answered after the base round trip plus a uniform jitter, and
+ * counted as a timeout when that is past the session timeout. Callbacks run
+ * on the esp_timer task rather than a ping task.
+ */
+
+typedef struct {
+    esp_ping_config_t config;
+    esp_ping_callbacks_t cbs;
+    esp_timer_handle_t timer;
+    uint16_t seqno;
+    uint32_t elapsed_ms;        //round trip of the last reply
+    uint32_t requests;
+    uint32_t replies;
+    int64_t start_us;
+    int64_t total_us;           //of finished runs
+    bool running;
+} gadget_sim_ping_t;
+
+static void gadget_sim_ping_end(gadget_sim_ping_t *ping)
+{
+    esp_timer_stop(ping->timer);
+    ping->total_us += esp_timer_get_time() - ping->start_us;
+    ping->running = false;
+    if(ping->cbs.on_ping_end)
+        ping->cbs.on_ping_end(ping, ping->cbs.cb_args);
+}
+
+/**
+ * @brief one echo request and its outcome
+ *
+ * @param arg the session
+ */
+static void gadget_sim_ping_tick(void *arg)
+{
+    gadget_sim_ping_t *ping = arg;
+    uint32_t rtt_ms;
+
+    ping->seqno++;
+    ping->requests++;
+
+    rtt_ms = GADGET_SIM_PING_RTT_MS + esp_random() % (GADGET_SIM_PING_JITTER_MS + 1);
+    if(esp_random() % 1000 < GADGET_SIM_PING_LOSS || rtt_ms > ping->config.timeout_ms)
+    {
+        if(ping->cbs.on_ping_timeout)
+            ping->cbs.on_ping_timeout(ping, ping->cbs.cb_args);
+    }
+    else
+    {
+        ping->replies++;
+        ping->elapsed_ms = rtt_ms;
+        if(ping->cbs.on_ping_success)
+            ping->cbs.on_ping_success(ping, ping->cbs.cb_args);
+    }
+
+    if(ping->config.count != ESP_PING_COUNT_INFINITE && ping->requests >= ping->config.count)
+        gadget_sim_ping_end(ping);
+}
+
+esp_err_t esp_ping_new_session(const esp_ping_config_t *config, const esp_ping_callbacks_t *cbs,
+                               esp_ping_handle_t *hdl_out)
+{
+    gadget_sim_ping_t *ping;
+    esp_err_t ret;
+
+    if(config == NULL || hdl_out == NULL || config->interval_ms == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    ping = calloc(1, sizeof(gadget_sim_ping_t));
+    if(ping == NULL)
+        return ESP_ERR_NO_MEM;
+
+    ping->config = *config;
+    if(cbs)
+        ping->cbs = *cbs;
+
+    const esp_timer_create_args_t args = {
+        .callback = gadget_sim_ping_tick,
+        .arg = ping,
+        .name = "gadget_sim_ping",
+    };
+    ret = esp_timer_create(&args, &ping->timer);
+    if(ret != ESP_OK)
+    {
+        free(ping);
+        return ret;
+    }
+
+    ESP_LOGI(gadget_tag, "simulated ping, rtt %d + %d ms, loss %d permille",
+             GADGET_SIM_PING_RTT_MS, GADGET_SIM_PING_JITTER_MS, GADGET_SIM_PING_LOSS);
+    *hdl_out = ping;
+    return ESP_OK;
+}
+
+esp_err_t esp_ping_delete_session(esp_ping_handle_t hdl)
+{
+    gadget_sim_ping_t *ping = hdl;
+
+    if(ping == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_timer_stop(ping->timer);
+    esp_timer_delete(ping->timer);
+    free(ping);
+    return ESP_OK;
+}
+
+esp_err_t esp_ping_start(esp_ping_handle_t hdl)
+{
+    gadget_sim_ping_t *ping = hdl;
+
+    if(ping == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if(ping->running)
+        return ESP_OK;
+
+    ping->requests = 0;
+    ping->replies = 0;
+    ping->start_us = esp_timer_get_time();
+    ping->running = true;
+    return esp_timer_start_periodic(ping->timer, (uint64_t)ping->config.interval_ms * 1000);
+}
+
+esp_err_t esp_ping_stop(esp_ping_handle_t hdl)
+{
+    gadget_sim_ping_t *ping = hdl;
+
+    if(ping == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if(ping->running)
+        gadget_sim_ping_end(ping);
+    return ESP_OK;
+}
+
+/**
+ * @brief read one field of the session, same sizes as the lwip ping
+ *
+ * @return esp_err_t ESP_ERR_INVALID_SIZE when data is too small
+ */
+esp_err_t esp_ping_get_profile(esp_ping_handle_t hdl, esp_ping_profile_t profile, void *data, uint32_t size)
+{
+    gadget_sim_ping_t *ping = hdl;
+    uint32_t duration_ms;
+    uint8_t byte;
+    const void *from;
+    uint32_t len;
+
+    if(ping == NULL || data == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    switch(profile)
+    {
+        case ESP_PING_PROF_SEQNO:
+            from = &ping->seqno;
+            len = sizeof(ping->seqno);
+        break;
+        case ESP_PING_PROF_TOS:
+            byte = (uint8_t)ping->config.tos;
+            from = &byte;
+            len = sizeof(byte);
+        break;
+        case ESP_PING_PROF_TTL:
+            byte = (uint8_t)ping->config.ttl;
+            from = &byte;
+            len = sizeof(byte);
+        break;
+        case ESP_PING_PROF_REQUEST:
+            from = &ping->requests;
+            len = sizeof(ping->requests);
+        break;
+        case ESP_PING_PROF_REPLY:
+            from = &ping->replies;
+            len = sizeof(ping->replies);
+        break;
+        case ESP_PING_PROF_IPADDR:
+            from = &ping->config.target_addr;
+            len = sizeof(ping->config.target_addr);
+        break;
+        case ESP_PING_PROF_SIZE:
+            from = &ping->config.data_size;
+            len = sizeof(ping->config.data_size);
+        break;
+        case ESP_PING_PROF_TIMEGAP:
+            from = &ping->elapsed_ms;
+            len = sizeof(ping->elapsed_ms);
+        break;
+        case ESP_PING_PROF_DURATION:
+            duration_ms = (uint32_t)((ping->total_us +
+                          (ping->running ? esp_timer_get_time() - ping->start_us : 0)) / 1000);
+            from = &duration_ms;
+            len = sizeof(duration_ms);
+        break;
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+
+    if(size < len)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(data, from, len);
+    return ESP_OK;
+}
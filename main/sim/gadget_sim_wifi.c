@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_event.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+
+const static char *gadget_tag = "gadget_mk1_sim_wifi";
+
+#define GADGET_SIM_CONNECT_MS       CONFIG_GADGET_SIM_CONNECT_MS
+#define GADGET_SIM_CHANNEL          6
+#define GADGET_SIM_EVENT_WAIT       pdMS_TO_TICKS(100)
+
+/*
+ * Stand-in WiFi driver for the host build. Mode changes, start and stop
+ * answer at once; a connect is carried by a one shot timer that posts
+ * STA_CONNECTED after GADGET_SIM_CONNECT_MS and GOT_IP after the same again,
+ * on the default event loop like the real driver. An empty SSID never
+ * finds its AP, which gives the retry and backoff path something to do.
+ */
+
+//weak, should a real esp_wifi or esp_netif get linked in as well its base wins
+__attribute__((weak)) ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+__attribute__((weak)) ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+typedef enum {
+    gadget_sim_sta_idle,
+    gadget_sim_sta_connecting,
+    gadget_sim_sta_associated,
+    gadget_sim_sta_online,
+} gadget_sim_sta_t;
+
+struct esp_netif_obj {
+    wifi_interface_t ifx;
+};
+
+static esp_netif_t sim_netif[2] = { { WIFI_IF_STA }, { WIFI_IF_AP } };
+static const uint8_t sim_bssid[6] = { 0x02, 0x00, 0x00, 0x5e, 0x00, 0x01 };
+
+static bool sim_init = false;
+static bool sim_started = false;
+static wifi_mode_t sim_mode = WIFI_MODE_NULL;
+static wifi_config_t sim_config[2];
+static gadget_sim_sta_t sim_sta = gadget_sim_sta_idle;
+static esp_timer_handle_t sim_connect_timer = NULL;
+static portMUX_TYPE sim_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool gadget_sim_has(wifi_mode_t mode, wifi_interface_t ifx)
+{
+    return mode & (ifx == WIFI_IF_AP ? WIFI_MODE_AP : WIFI_MODE_STA);
+}
+
+static void gadget_sim_post(esp_event_base_t base, int32_t id, void *data, size_t len)
+{
+    if(esp_event_post(base, id, data, len, GADGET_SIM_EVENT_WAIT) != ESP_OK)
+        ESP_LOGW(gadget_tag, "event %s %ld not posted", base, (long)id);
+}
+
+static void gadget_sim_post_disconnected(uint8_t reason)
+{
+    wifi_event_sta_disconnected_t event;
+
+    memset(&event, 0, sizeof(event));
+    memcpy(event.ssid, sim_config[WIFI_IF_STA].sta.ssid, sizeof(event.ssid));
+    event.ssid_len = strnlen((const char *)event.ssid, sizeof(event.ssid));
+    memcpy(event.bssid, sim_bssid, sizeof(event.bssid));
+    event.reason = reason;
+    gadget_sim_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event, sizeof(event));
+}
+
+/**
+ * @brief drop the STA link, reporting it if there was one
+ *
+ * @param reason
+ */
+static void gadget_sim_sta_drop(uint8_t reason)
+{
+    gadget_sim_sta_t was;
+
+    esp_timer_stop(sim_connect_timer);
+    portENTER_CRITICAL(&sim_lock);
+    was = sim_sta;
+    sim_sta = gadget_sim_sta_idle;
+    portEXIT_CRITICAL(&sim_lock);
+
+    if(was != gadget_sim_sta_idle)
+        gadget_sim_post_disconnected(reason);
+}
+
+/**
+ * @brief connect timer, one step of connecting -> associated -> online
+ *
+ * @param arg
+ */
+static void gadget_sim_connect_step(void *arg)
+{
+    wifi_event_sta_connected_t connected;
+    ip_event_got_ip_t got_ip;
+    gadget_sim_sta_t state;
+
+    portENTER_CRITICAL(&sim_lock);
+    state = sim_sta;
+    if(state == gadget_sim_sta_connecting && sim_config[WIFI_IF_STA].sta.ssid[0] != '\0')
+        sim_sta = gadget_sim_sta_associated;
+    else if(state == gadget_sim_sta_associated)
+        sim_sta = gadget_sim_sta_online;
+    else if(state == gadget_sim_sta_connecting)
+        sim_sta = gadget_sim_sta_idle;
+    portEXIT_CRITICAL(&sim_lock);
+
+    switch(state)
+    {
+        case gadget_sim_sta_connecting:
+            if(sim_config[WIFI_IF_STA].sta.ssid[0] == '\0')
+            {
+                gadget_sim_post_disconnected(WIFI_REASON_NO_AP_FOUND);
+                break;
+            }
+            memset(&connected, 0, sizeof(connected));
+            memcpy(connected.ssid, sim_config[WIFI_IF_STA].sta.ssid, sizeof(connected.ssid));
+            connected.ssid_len = strnlen((const char *)connected.ssid, sizeof(connected.ssid));
+            memcpy(connected.bssid, sim_bssid, sizeof(connected.bssid));
+            connected.channel = GADGET_SIM_CHANNEL;
+            connected.authmode = WIFI_AUTH_WPA2_PSK;
+            connected.aid = 1;
+            gadget_sim_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &connected, sizeof(connected));
+            esp_timer_start_once(sim_connect_timer, (uint64_t)GADGET_SIM_CONNECT_MS * 1000);
+        break;
+
+        case gadget_sim_sta_associated:
+            memset(&got_ip, 0, sizeof(got_ip));
+            got_ip.esp_netif = &sim_netif[WIFI_IF_STA];
+            got_ip.ip_info.ip.addr = ESP_IP4TOADDR(192, 168, 50, 2);
+            got_ip.ip_info.netmask.addr = ESP_IP4TOADDR(255, 255, 255, 0);
+            got_ip.ip_info.gw.addr = ESP_IP4TOADDR(192, 168, 50, 1);
+            got_ip.ip_changed = true;
+            gadget_sim_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &got_ip, sizeof(got_ip));
+        break;
+
+        default:
+        break;
+    }
+}
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_default_netif(esp_netif_t *esp_netif)
+{
+    return esp_netif == NULL ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_ap(void)
+{
+    return &sim_netif[WIFI_IF_AP];
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    return &sim_netif[WIFI_IF_STA];
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    const esp_timer_create_args_t args = {
+        .callback = gadget_sim_connect_step,
+        .name = "gadget_sim_wifi",
+    };
+    esp_err_t ret;
+
+    if(sim_init)
+        return ESP_OK;
+
+    ret = esp_timer_create(&args, &sim_connect_timer);
+    if(ret != ESP_OK)
+        return ret;
+
+    sim_init = true;
+    ESP_LOGI(gadget_tag, "simulated wifi driver, connect %d ms", GADGET_SIM_CONNECT_MS);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage)
+{
+    return sim_init ? ESP_OK : ESP_ERR_WIFI_NOT_INIT;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    return sim_init ? ESP_OK : ESP_ERR_WIFI_NOT_INIT;
+}
+
+/**
+ * @brief change mode, a running driver starts and stops interfaces to match
+ *
+ * @param mode
+ * @return esp_err_t
+ */
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    wifi_mode_t was = sim_mode;
+
+    if(!sim_init)
+        return ESP_ERR_WIFI_NOT_INIT;
+
+    sim_mode = mode;
+    if(!sim_started)
+        return ESP_OK;
+
+    if(gadget_sim_has(was, WIFI_IF_STA) && !gadget_sim_has(mode, WIFI_IF_STA))
+    {
+        gadget_sim_sta_drop(WIFI_REASON_ASSOC_LEAVE);
+        gadget_sim_post(WIFI_EVENT, WIFI_EVENT_STA_STOP, NULL, 0);
+    }
+    if(gadget_sim_has(was, WIFI_IF_AP) && !gadget_sim_has(mode, WIFI_IF_AP))
+        gadget_sim_post(WIFI_EVENT, WIFI_EVENT_AP_STOP, NULL, 0);
+    if(!gadget_sim_has(was, WIFI_IF_STA) && gadget_sim_has(mode, WIFI_IF_STA))
+        gadget_sim_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0);
+    if(!gadget_sim_has(was, WIFI_IF_AP) && gadget_sim_has(mode, WIFI_IF_AP))
+        gadget_sim_post(WIFI_EVENT, WIFI_EVENT_AP_START, NULL, 0);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    if(!sim_init)
+        return ESP_ERR_WIFI_NOT_INIT;
+    if(conf == NULL || (interface != WIFI_IF_STA && interface != WIFI_IF_AP))
+        return ESP_ERR_INVALID_ARG;
+
+    sim_config[interface] = *conf;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    if(!sim_init)
+        return ESP_ERR_WIFI_NOT_INIT;
+    if(sim_started)
+        return ESP_OK;
+
+    sim_started = true;
+    if(gadget_sim_has(sim_mode, WIFI_IF_STA))
+        gadget_sim_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0);
+    if(gadget_sim_has(sim_mode, WIFI_IF_AP))
+        gadget_sim_post(WIFI_EVENT, WIFI_EVENT_AP_START, NULL, 0);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+    if(!sim_init)
+        return ESP_ERR_WIFI_NOT_INIT;
+    if(!sim_started)
+        return ESP_OK;
+
+    if(gadget_sim_has(sim_mode, WIFI_IF_STA))
+    {
+        gadget_sim_sta_drop(WIFI_REASON_ASSOC_LEAVE);
+        gadget_sim_post(WIFI_EVENT, WIFI_EVENT_STA_STOP, NULL, 0);
+    }
+    if(gadget_sim_has(sim_mode, WIFI_IF_AP))
+        gadget_sim_post(WIFI_EVENT, WIFI_EVENT_AP_STOP, NULL, 0);
+    sim_started = false;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    if(!sim_init)
+        return ESP_ERR_WIFI_NOT_INIT;
+    if(!sim_started || !gadget_sim_has(sim_mode, WIFI_IF_STA))
+        return ESP_ERR_WIFI_NOT_STARTED;
+
+    //a connect while connecting or connected starts over, as the driver does
+    esp_timer_stop(sim_connect_timer);
+    portENTER_CRITICAL(&sim_lock);
+    sim_sta = gadget_sim_sta_connecting;
+    portEXIT_CRITICAL(&sim_lock);
+
+    return esp_timer_start_once(sim_connect_timer, (uint64_t)GADGET_SIM_CONNECT_MS * 1000);
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    if(!sim_init)
+        return ESP_ERR_WIFI_NOT_INIT;
+    if(!sim_started)
+        return ESP_ERR_WIFI_NOT_STARTED;
+
+    gadget_sim_sta_drop(WIFI_REASON_ASSOC_LEAVE);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    bool online;
+
+    portENTER_CRITICAL(&sim_lock);
+    online = sim_sta == gadget_sim_sta_online;
+    portEXIT_CRITICAL(&sim_lock);
+
+    if(!online)
+        return ESP_ERR_WIFI_NOT_CONNECT;
+
+    memset(ap_info, 0, sizeof(wifi_ap_record_t));
+    memcpy(ap_info->bssid, sim_bssid, sizeof(ap_info->bssid));
+    memcpy(ap_info->ssid, sim_config[WIFI_IF_STA].sta.ssid, sizeof(sim_config[WIFI_IF_STA].sta.ssid));
+    ap_info->primary = GADGET_SIM_CHANNEL;
+    ap_info->rssi = -50;
+    ap_info->authmode = WIFI_AUTH_WPA2_PSK;
+    return ESP_OK;
+}
@@ -0,0 +1,50 @@
+#ifndef GADGET_SIM_ESP_NETIF_H
+#define GADGET_SIM_ESP_NETIF_H
+
+/*
+ * Host build stand-in for esp_netif. There is no IP stack behind the
+ * simulated interfaces, sockets go through the host's own.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "esp_event.h"
+
+ESP_EVENT_DECLARE_BASE(IP_EVENT);
+
+typedef struct esp_netif_obj esp_netif_t;
+
+typedef struct {
+    uint32_t addr;              //network order
+} esp_ip4_addr_t;
+
+typedef struct {
+    esp_ip4_addr_t ip;
+    esp_ip4_addr_t netmask;
+    esp_ip4_addr_t gw;
+} esp_netif_ip_info_t;
+
+typedef enum {
+    IP_EVENT_STA_GOT_IP,
+    IP_EVENT_STA_LOST_IP,
+} ip_event_t;
+
+typedef struct {
+    esp_netif_t *esp_netif;
+    esp_netif_ip_info_t ip_info;
+    bool ip_changed;
+} ip_event_got_ip_t;
+
+#define ESP_IP4TOADDR(a, b, c, d)   (((uint32_t)(d) << 24) | ((uint32_t)(c) << 16) | \
+                                     ((uint32_t)(b) << 8) | (uint32_t)(a))
+
+#define IPSTR                       "%d.%d.%d.%d"
+#define IP2STR(ipaddr)              (int)((ipaddr)->addr & 0xff), (int)(((ipaddr)->addr >> 8) & 0xff), \
+                                    (int)(((ipaddr)->addr >> 16) & 0xff), (int)(((ipaddr)->addr >> 24) & 0xff)
+
+esp_err_t esp_netif_init(void);
+esp_err_t esp_netif_set_default_netif(esp_netif_t *esp_netif);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef GADGET_SIM_ESP_NETIF_NET_STACK_H
+#define GADGET_SIM_ESP_NETIF_NET_STACK_H
+
+#include "esp_netif.h"
+
+#endif
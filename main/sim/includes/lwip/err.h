@@ -0,0 +1,8 @@
+#ifndef GADGET_SIM_LWIP_ERR_H
+#define GADGET_SIM_LWIP_ERR_H
+
+typedef signed char err_t;
+
+#define ERR_OK                      0
+
+#endif
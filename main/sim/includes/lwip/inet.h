@@ -0,0 +1,12 @@
+#ifndef GADGET_SIM_LWIP_INET_H
+#define GADGET_SIM_LWIP_INET_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "lwip/ip_addr.h"
+
+#define inet_addr_to_ip4addr(target_ip4addr, source_inaddr) \
+    ((target_ip4addr)->addr = (source_inaddr)->s_addr)
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef GADGET_SIM_LWIP_IP_ADDR_H
+#define GADGET_SIM_LWIP_IP_ADDR_H
+
+#include <stdint.h>
+
+//host build stand-in, IPv4 only
+
+typedef struct {
+    uint32_t addr;              //network order
+} ip4_addr_t;
+
+typedef struct {
+    union {
+        ip4_addr_t ip4;
+    } u_addr;
+    uint8_t type;
+} ip_addr_t;
+
+#define IPADDR_TYPE_V4              0
+
+#define ip_2_ip4(ipaddr)            (&((ipaddr)->u_addr.ip4))
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef GADGET_SIM_LWIP_NETDB_H
+#define GADGET_SIM_LWIP_NETDB_H
+
+#include <netdb.h>
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef GADGET_SIM_LWIP_SOCKETS_H
+#define GADGET_SIM_LWIP_SOCKETS_H
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#endif
@@ -0,0 +1,4 @@
+#ifndef GADGET_SIM_LWIP_SYS_H
+#define GADGET_SIM_LWIP_SYS_H
+
+#endif
@@ -4,6 +4,8 @@
 
 #include "gadget_includes.h"
 #include "gadget_ap.h"
+#include "gadget_proto.h"
+#include "gadget_wifi.h"
 
 #include "esp_log.h"
 #include "esp_mac.h"
@@ -25,18 +27,51 @@ const static char *gadget_tag = "gadget_mk1_ap";
 #define GADGET_AP_SSID          CONFIG_GADGET_AP_SSID
 #define GADGET_AP_PASSWORD      CONFIG_GADGET_AP_PASSWORD
 #define GADGET_AP_WIFI_CHANNEL  1
-#define GADGET_AP_MAX_CONN      1
+#define GADGET_AP_MAX_CONN      CONFIG_GADGET_AP_MAX_CONN
 
-#define WIFI_CONN_BIT           BIT0
-#define WIFI_FAIL_BIT           BIT1
+#define GADGET_WS_MAX_CLIENTS   CONFIG_GADGET_WS_MAX_CLIENTS
+#define GADGET_WS_PORT          CONFIG_GADGET_WS_PORT
+#define GADGET_WS_TX_SLOTS      8       // pending msgs per client before it counts as slow
+#define GADGET_WS_TX_BLOCK_SIZE CONFIG_GADGET_WS_TX_BLOCK_SIZE
+#define GADGET_WS_TX_BLOCKS     CONFIG_GADGET_WS_TX_BLOCKS
+#define GADGET_WS_SEND_TIMEOUT  1       // seconds, bounds how long one dead client stalls httpd
+#define GADGET_WS_RX_SIZE       256     // largest inbound frame, bigger ones close the session
 
 static esp_err_t gadget_start_websocket();
 static void gadget_async_send(void *arg);
-static esp_err_t gadget_send_over_ws(httpd_handle_t handle, const char *payload);
 static esp_err_t async_ws_handler(httpd_req_t *request);
 
 httpd_handle_t gadget_global_server;
-int websocket_fd;
+
+//outbound payload shared by every session it is queued to, refs under ws_clients_lock
+typedef struct {
+    uint16_t refs;          // 0 when the block is free
+    size_t len;
+    uint8_t *data;
+} gadget_ws_buf_t;
+
+//pending outbound msg, references a shared buffer holding its own copy of the data
+typedef struct {
+    gadget_ws_buf_t *buf;
+    httpd_ws_type_t type;
+} gadget_ws_tx_slot_t;
+
+//connected websocket session
+typedef struct {
+    int fd;
+    bool active;
+    bool work_queued;   // a gadget_async_send is pending for this session
+    uint8_t tx_head;
+    uint8_t tx_count;
+    gadget_ws_tx_slot_t tx[GADGET_WS_TX_SLOTS];
+    gadget_ws_tx_stats_t stats;
+    uint32_t rx_cmds;       // commands posted to central
+    uint32_t rx_errors;     // malformed or undeliverable commands
+    uint8_t rx[GADGET_WS_RX_SIZE];  // receive buffer, only touched from the httpd task
+} gadget_ws_client_t;
+
+static gadget_ws_client_t ws_clients[GADGET_WS_MAX_CLIENTS];
+static portMUX_TYPE ws_clients_lock = portMUX_INITIALIZER_UNLOCKED;
 
 bool start_ws()
 {
@@ -60,7 +95,7 @@ static const httpd_uri_t ws = {
 };
 
 //wifi ap
-static EventGroupHandle_t ap_wifi_event_group;
+static bool ap_handler_registered = false;
 
 /**
  * @brief Wifi AP event handler
@@ -85,13 +120,15 @@ static void ap_event_handler(void *arg, esp_event_base_t event_base,
 }
 
 /**
- * @brief initialize network interface for SoftAP
+ * @brief bring up the SoftAP next to whatever else runs, the wifi stack is
+ * only initialized on first use
  * 
- * @return esp_netif_t* 
+ * @return true 
+ * @return false 
  */
-esp_netif_t *gadget_ap_init_config()
+bool gadget_ap_init()
 {
-    esp_netif_t *esp_netif_ap = esp_netif_create_default_wifi_ap();
+    esp_err_t ret;
 
     wifi_config_t wifi_ap_config = {
         .ap = {
@@ -107,113 +144,530 @@ esp_netif_t *gadget_ap_init_config()
         },
     };
 
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_ap_config));
+    if(gadget_wifi_init() != ESP_OK)
+        return false;
+
+    if(!ap_handler_registered)
+    {
+        //Register WIFI_EVENT
+        ret = esp_event_handler_instance_register(WIFI_EVENT,
+                        ESP_EVENT_ANY_ID,
+                        &ap_event_handler,
+                        NULL,
+                        NULL);
+        if(ret != ESP_OK)
+        {
+            ESP_LOGE(gadget_tag, "ERROR registering ap event handler CODE(%s)", esp_err_to_name(ret));
+            return false;
+        }
+        ap_handler_registered = true;
+    }
+
+    ESP_LOGI(gadget_tag, "esp_wifi initializing ap");
+    if(gadget_wifi_add(WIFI_IF_AP, &wifi_ap_config) == NULL)
+        return false;
 
     ESP_LOGI(gadget_tag, "gadget_ap_init SSID:%s password:%s channel:%d",
              GADGET_AP_SSID, GADGET_AP_PASSWORD, GADGET_AP_WIFI_CHANNEL);
 
-    return esp_netif_ap;
+    return true;
 }
 
 /**
- * @brief initialize ap & websocket
+ * @brief take the SoftAP down, the websocket server stays up for a later init
  * 
  */
-void gadget_ap_init()
+void gadget_ap_stop()
 {
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    gadget_wifi_remove(WIFI_IF_AP);
+}
 
-    ap_wifi_event_group = xEventGroupCreate();
+//WEBSOCKET
+//fixed send buffers of the websocket alone, bursts here never starve the msg bus pool
+static uint8_t ws_tx_blocks[GADGET_WS_TX_BLOCKS][GADGET_WS_TX_BLOCK_SIZE] __attribute__((aligned(4)));
+static gadget_ws_buf_t ws_tx_bufs[GADGET_WS_TX_BLOCKS];
+static uint32_t ws_tx_oversize = 0;     // broadcasts larger than a block, under ws_clients_lock
+
+/**
+ * @brief a shared send buffer holding a copy of payload, with one reference
+ *
+ * Every buffer is a fixed block, the send path never touches the heap.
+ * Producers size their frames to GADGET_WS_TX_BLOCK_SIZE, telemetry and
+ * profile batches check it at build time.
+ *
+ * @param payload
+ * @param len       at most GADGET_WS_TX_BLOCK_SIZE
+ * @return gadget_ws_buf_t* NULL when every block is in use
+ */
+static gadget_ws_buf_t *gadget_ws_buf_alloc(const uint8_t *payload, size_t len)
+{
+    gadget_ws_buf_t *buf = NULL;
+
+    portENTER_CRITICAL(&ws_clients_lock);
+    for(int i = 0; i < GADGET_WS_TX_BLOCKS; i++)
+    {
+        if(ws_tx_bufs[i].refs == 0)
+        {
+            buf = &ws_tx_bufs[i];
+            buf->refs = 1;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&ws_clients_lock);
+    if(buf == NULL)
+        return NULL;
+
+    buf->data = ws_tx_blocks[buf - ws_tx_bufs];
+    buf->len = len;
+    memcpy(buf->data, payload, len);
+    return buf;
+}
 
-    //Register WIFI_EVENT
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                    ESP_EVENT_ANY_ID,
-                    &ap_event_handler,
-                    NULL,
-                    NULL));
+/**
+ * @brief drop a reference, the buffer is free again after the last one
+ *
+ * @param buf
+ */
+static void gadget_ws_buf_release(gadget_ws_buf_t *buf)
+{
+    portENTER_CRITICAL(&ws_clients_lock);
+    buf->refs--;
+    portEXIT_CRITICAL(&ws_clients_lock);
+}
 
-    //init wifi config
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
+/**
+ * @brief track a new websocket session
+ * 
+ * @param fd 
+ * @return true 
+ * @return false registry full
+ */
+static bool gadget_ws_client_add(int fd)
+{
+    int free_slot = -1;
 
-    ESP_LOGI(gadget_tag, "esp_wifi initializing ap");
-    gadget_ap_init_config();
+    portENTER_CRITICAL(&ws_clients_lock);
+    for(int i = 0; i < GADGET_WS_MAX_CLIENTS; i++)
+    {
+        if(ws_clients[i].active && ws_clients[i].fd == fd)
+        {
+            portEXIT_CRITICAL(&ws_clients_lock);
+            return true;
+        }
+        if(!ws_clients[i].active && free_slot < 0)
+            free_slot = i;
+    }
+    if(free_slot >= 0)
+    {
+        ws_clients[free_slot].fd = fd;
+        ws_clients[free_slot].active = true;
+        memset(&ws_clients[free_slot].stats, 0, sizeof(gadget_ws_tx_stats_t));
+        ws_clients[free_slot].rx_cmds = 0;
+        ws_clients[free_slot].rx_errors = 0;
+    }
+    portEXIT_CRITICAL(&ws_clients_lock);
 
-    ESP_ERROR_CHECK(esp_wifi_start());
+    return free_slot >= 0;
 }
 
-//WEBSOCKET
-//Asynchronous response data structure
-struct async_resp_arg
+/**
+ * @brief take up to max pending msgs off a session
+ * 
+ * Caller holds ws_clients_lock.
+ * 
+ * @return size_t msgs taken
+ */
+static size_t gadget_ws_tx_take(gadget_ws_client_t *client, gadget_ws_tx_slot_t *out, size_t max)
 {
-    httpd_handle_t hd; // Server instance
-    int fd;            // Session socket file descriptor
-    char *payload;
-};
+    size_t taken = 0;
+
+    while(taken < max && client->tx_count > 0)
+    {
+        out[taken++] = client->tx[client->tx_head];
+        client->tx_head = (client->tx_head + 1) % GADGET_WS_TX_SLOTS;
+        client->tx_count--;
+    }
+
+    return taken;
+}
+
+static void gadget_ws_client_remove(int fd)
+{
+    gadget_ws_tx_slot_t pending[GADGET_WS_TX_SLOTS];
+    size_t count = 0;
+
+    portENTER_CRITICAL(&ws_clients_lock);
+    for(int i = 0; i < GADGET_WS_MAX_CLIENTS; i++)
+    {
+        if(ws_clients[i].active && ws_clients[i].fd == fd)
+        {
+            ws_clients[i].active = false;
+            count = gadget_ws_tx_take(&ws_clients[i], pending, GADGET_WS_TX_SLOTS);
+            ws_clients[i].tx_count = 0;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&ws_clients_lock);
+
+    for(size_t i = 0; i < count; i++)
+        gadget_ws_buf_release(pending[i].buf);
+}
 
 /**
- * @brief generate asynchronous response
+ * @brief httpd session close hook, drops the session from the registry
  * 
- * @param arg 
+ * @param hd 
+ * @param sockfd 
+ */
+static void gadget_ws_close_fn(httpd_handle_t hd, int sockfd)
+{
+    gadget_ws_client_remove(sockfd);
+    ESP_LOGI(gadget_tag, "Websocket Connection Closed | fd: %d", sockfd);
+    close(sockfd);
+}
+
+/**
+ * @brief drain one session's send ring, runs in the httpd task
+ * 
+ * Msgs that queued up before this ran ride the same work item but each
+ * still goes out as its own frame, so clients see one msg per frame. The
+ * work item saves httpd_queue_work calls, not frames, which is why there is
+ * no coalesced counter, frames always equal msgs.
+ * 
+ * @param arg ws_clients index
  */
 static void gadget_async_send(void *arg)
 {
-    // Initialize asynchronous response data structure
-    struct async_resp_arg *resp_arg = (struct async_resp_arg *)arg;
-    //create websocket packet
+    gadget_ws_client_t *client = &ws_clients[(intptr_t)arg];
+    gadget_ws_tx_slot_t batch[GADGET_WS_TX_SLOTS];
     httpd_ws_frame_t ws_pkt;
-    memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-    ws_pkt.payload = (uint8_t*)resp_arg->payload;
-    ws_pkt.len = strlen(resp_arg->payload);
-    ws_pkt.type = HTTPD_WS_TYPE_TEXT;
+    size_t count;
+    size_t sent;
+    bool live;
+    int fd;
 
-    //send
-    httpd_ws_send_frame_async(resp_arg->hd, resp_arg->fd, &ws_pkt);
-    free(resp_arg);
+    while(1)
+    {
+        portENTER_CRITICAL(&ws_clients_lock);
+        count = gadget_ws_tx_take(client, batch, GADGET_WS_TX_SLOTS);
+        if(count == 0)
+            client->work_queued = false;
+        live = client->active;
+        fd = client->fd;
+        portEXIT_CRITICAL(&ws_clients_lock);
+
+        if(count == 0)
+            break;
+
+        //send each straight from its buffer, sessions that closed while msgs were pending are skipped
+        live = live && httpd_ws_get_fd_info(gadget_global_server, fd) == HTTPD_WS_CLIENT_WEBSOCKET;
+        sent = 0;
+        for(size_t i = 0; i < count; i++)
+        {
+            memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
+            ws_pkt.type = batch[i].type;
+            ws_pkt.payload = batch[i].buf->data;
+            ws_pkt.len = batch[i].buf->len;
+            if(live && httpd_ws_send_frame_async(gadget_global_server, fd, &ws_pkt) == ESP_OK)
+                sent++;
+            else
+                live = false;
+            gadget_ws_buf_release(batch[i].buf);
+        }
+
+        portENTER_CRITICAL(&ws_clients_lock);
+        client->stats.frames += sent;
+        client->stats.msgs += sent;
+        client->stats.dropped += count - sent;
+        portEXIT_CRITICAL(&ws_clients_lock);
+    }
 }
 
-static esp_err_t gadget_send_over_ws(httpd_handle_t handle, const char *payload)
+/**
+ * @brief queue one shared copy of payload to every connected websocket session
+ * 
+ * The payload is copied once into a refcounted websocket buffer and each
+ * session's send ring takes a reference. Sessions whose ring is full are
+ * skipped rather than waited on. A payload above GADGET_WS_TX_BLOCK_SIZE is
+ * dropped for every session and counted as oversize.
+ * 
+ * @param payload 
+ * @param len 
+ * @param binary    binary frame if true, text otherwise
+ * @return size_t sessions the payload was queued to
+ */
+size_t gadget_ws_broadcast(const uint8_t *payload, size_t len, bool binary)
 {
-    struct async_resp_arg *resp_arg = malloc(sizeof(struct async_resp_arg));
-    if (resp_arg == NULL) {
-        return ESP_ERR_NO_MEM;
+    gadget_ws_client_t *client;
+    gadget_ws_tx_slot_t *slot;
+    gadget_ws_buf_t *buf;
+    size_t queued = 0;
+    bool need_work;
+
+    if(gadget_global_server == NULL || gadget_ws_client_count() == 0)
+        return 0;
+
+    //the broadcaster holds one reference until fan-out is done
+    buf = len <= GADGET_WS_TX_BLOCK_SIZE ? gadget_ws_buf_alloc(payload, len) : NULL;
+    if(buf == NULL)
+    {
+        portENTER_CRITICAL(&ws_clients_lock);
+        if(len > GADGET_WS_TX_BLOCK_SIZE)
+            ws_tx_oversize++;
+        for(int i = 0; i < GADGET_WS_MAX_CLIENTS; i++)
+        {
+            if(ws_clients[i].active)
+                ws_clients[i].stats.dropped++;
+        }
+        portEXIT_CRITICAL(&ws_clients_lock);
+        return 0;
+    }
+
+    for(int i = 0; i < GADGET_WS_MAX_CLIENTS; i++)
+    {
+        client = &ws_clients[i];
+        need_work = false;
+
+        portENTER_CRITICAL(&ws_clients_lock);
+        if(client->active && client->tx_count >= GADGET_WS_TX_SLOTS)
+            client->stats.dropped++;
+        else if(client->active)
+        {
+            slot = &client->tx[(client->tx_head + client->tx_count) % GADGET_WS_TX_SLOTS];
+            slot->buf = buf;
+            slot->type = binary ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT;
+            buf->refs++;
+            client->tx_count++;
+            if(client->tx_count > client->stats.max_depth)
+                client->stats.max_depth = client->tx_count;
+            need_work = !client->work_queued;
+            client->work_queued = true;
+            queued++;
+        }
+        portEXIT_CRITICAL(&ws_clients_lock);
+
+        //one work item drains everything queued before it runs
+        if(need_work && httpd_queue_work(gadget_global_server, gadget_async_send, (void *)(intptr_t)i) != ESP_OK)
+        {
+            portENTER_CRITICAL(&ws_clients_lock);
+            client->work_queued = false;
+            portEXIT_CRITICAL(&ws_clients_lock);
+        }
+    }
+
+    gadget_ws_buf_release(buf);
+    return queued;
+}
+
+/**
+ * @brief number of connected websocket sessions
+ * 
+ * @return size_t 
+ */
+size_t gadget_ws_client_count(void)
+{
+    size_t count = 0;
+
+    portENTER_CRITICAL(&ws_clients_lock);
+    for(int i = 0; i < GADGET_WS_MAX_CLIENTS; i++)
+    {
+        if(ws_clients[i].active)
+            count++;
+    }
+    portEXIT_CRITICAL(&ws_clients_lock);
+
+    return count;
+}
+
+/**
+ * @brief send counters summed over every connected session
+ * 
+ * @param stats 
+ */
+void gadget_ws_get_tx_stats(gadget_ws_tx_stats_t *stats)
+{
+    memset(stats, 0, sizeof(gadget_ws_tx_stats_t));
+
+    portENTER_CRITICAL(&ws_clients_lock);
+    for(int i = 0; i < GADGET_WS_MAX_CLIENTS; i++)
+    {
+        if(!ws_clients[i].active)
+            continue;
+        stats->depth += ws_clients[i].tx_count;
+        stats->frames += ws_clients[i].stats.frames;
+        stats->msgs += ws_clients[i].stats.msgs;
+        stats->dropped += ws_clients[i].stats.dropped;
+        if(ws_clients[i].stats.max_depth > stats->max_depth)
+            stats->max_depth = ws_clients[i].stats.max_depth;
     }
-    resp_arg->hd = handle;
-    resp_arg->fd = websocket_fd;
-    resp_arg->payload = payload;
-    ESP_LOGW(gadget_tag, "fd: %d", resp_arg->fd);
-    esp_err_t ret = httpd_queue_work(handle, gadget_async_send, resp_arg);
-    if (ret != ESP_OK) {
-        free(resp_arg);
+    stats->oversize = ws_tx_oversize;
+    portEXIT_CRITICAL(&ws_clients_lock);
+}
+
+/**
+ * @brief print per session send counters
+ * 
+ */
+void gadget_ws_log_clients(void)
+{
+    gadget_ws_client_t client;
+    uint32_t oversize;
+
+    portENTER_CRITICAL(&ws_clients_lock);
+    oversize = ws_tx_oversize;
+    portEXIT_CRITICAL(&ws_clients_lock);
+    if(oversize > 0)
+        ESP_LOGW(gadget_tag, "ws broadcasts dropped as larger than %d bytes: %lu",
+                 GADGET_WS_TX_BLOCK_SIZE, (unsigned long)oversize);
+
+    for(int i = 0; i < GADGET_WS_MAX_CLIENTS; i++)
+    {
+        portENTER_CRITICAL(&ws_clients_lock);
+        client.fd = ws_clients[i].fd;
+        client.active = ws_clients[i].active;
+        client.tx_count = ws_clients[i].tx_count;
+        client.stats = ws_clients[i].stats;
+        client.rx_cmds = ws_clients[i].rx_cmds;
+        client.rx_errors = ws_clients[i].rx_errors;
+        portEXIT_CRITICAL(&ws_clients_lock);
+
+        if(client.active)
+            ESP_LOGI(gadget_tag, "ws client fd %d: depth %d (max %lu), frames %lu, msgs %lu, dropped %lu, cmds %lu, rx errors %lu",
+                     client.fd, client.tx_count, (unsigned long)client.stats.max_depth,
+                     (unsigned long)client.stats.frames, (unsigned long)client.stats.msgs,
+                     (unsigned long)client.stats.dropped,
+                     (unsigned long)client.rx_cmds, (unsigned long)client.rx_errors);
     }
-    return ret;
+}
+
+/**
+ * @brief registry index of an open session
+ * 
+ * @param fd 
+ * @return int -1 if fd is not tracked
+ */
+static int gadget_ws_client_find(int fd)
+{
+    int found = -1;
+
+    portENTER_CRITICAL(&ws_clients_lock);
+    for(int i = 0; i < GADGET_WS_MAX_CLIENTS; i++)
+    {
+        if(ws_clients[i].active && ws_clients[i].fd == fd)
+        {
+            found = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&ws_clients_lock);
+
+    return found;
+}
+
+/**
+ * @brief copy a decoded frame's payload into msg
+ *
+ * Uses the inline data array or a pool block, never the heap.
+ *
+ * @param frame
+ * @param msg
+ * @return esp_err_t ESP_ERR_NO_MEM if the payload does not fit
+ */
+static esp_err_t gadget_ws_frame_to_msg(const gadget_proto_frame_t *frame, gadget_msg_t *msg)
+{
+    uint8_t *payload;
+
+    memset(msg, 0, sizeof(gadget_msg_t));
+    msg->msg_type = frame->msg_type;
+    msg->msg_prio = frame->prio;
+    if(frame->len == 0)
+        return ESP_OK;
+
+    payload = gadget_msg_alloc_payload(msg, frame->len);
+    if(payload == NULL)
+        return ESP_ERR_NO_MEM;
+    memcpy(payload, frame->payload, frame->len);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief decode every command frame of a binary ws msg and post it to central
+ * 
+ * @param client 
+ * @param buf 
+ * @param len 
+ */
+static void gadget_ws_dispatch(gadget_ws_client_t *client, const uint8_t *buf, size_t len)
+{
+    gadget_proto_frame_t frame;
+    gadget_msg_t msg;
+    esp_err_t ret;
+    size_t consumed;
+    uint32_t cmds = 0;
+    uint32_t errors = 0;
+
+    while(len > 0)
+    {
+        ret = gadget_proto_decode(buf, len, &frame, &consumed);
+        if(ret == ESP_OK)
+            ret = gadget_ws_frame_to_msg(&frame, &msg);
+        if(ret == ESP_OK && gadget_send_msg(gadget_central_msg_queue, 0, frame.prio,
+                                            gadget_ws_id, frame.msg_type, &msg) != pdPASS)
+            ret = ESP_ERR_TIMEOUT;
+
+        if(ret == ESP_OK)
+            cmds++;
+        else
+        {
+            errors++;
+            ESP_LOGW(gadget_tag, "ws fd %d: dropped command CODE(%s)", client->fd, esp_err_to_name(ret));
+        }
+
+        //a truncated or unversioned frame leaves nothing to resync on
+        if(consumed == 0)
+            break;
+        buf += consumed;
+        len -= consumed;
+    }
+
+    portENTER_CRITICAL(&ws_clients_lock);
+    client->rx_cmds += cmds;
+    client->rx_errors += errors;
+    portEXIT_CRITICAL(&ws_clients_lock);
 }
 
 /**
  * @brief Asychronous Websocket handler
  * 
+ * Binary msgs carry gadget_proto command frames. They are received into the
+ * session's own buffer and forwarded to central without touching the heap.
+ * 
  * @param request 
  * @return esp_err_t 
  */
 static esp_err_t async_ws_handler(httpd_req_t *request)
 {
+    int fd = httpd_req_to_sockfd(request);
+
     //Check websocket request for HTTP_GET validity
-    //ESP_LOGI("async","request->handle: %d", request->handle);
     if(request->method == HTTP_GET)
     {
-        websocket_fd = httpd_req_to_sockfd(request);
-        ESP_LOGI(gadget_tag, "Websocket Connection Established | fd: %d", websocket_fd);
+        if(!gadget_ws_client_add(fd))
+        {
+            ESP_LOGW(gadget_tag, "Websocket client limit reached, rejecting fd: %d", fd);
+            return ESP_FAIL;
+        }
+        ESP_LOGI(gadget_tag, "Websocket Connection Established | fd: %d", fd);
         return ESP_OK;
     }
 
     esp_err_t ws_ret;
+    gadget_ws_client_t *client;
+    int idx = gadget_ws_client_find(fd);
     //Handle websocket packet
     httpd_ws_frame_t ws_pkt;
-    uint8_t *data_buf = NULL;
     memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-    ws_pkt.type = HTTPD_WS_TYPE_TEXT;
     //set 0 to get frame length
     ws_ret = httpd_ws_recv_frame(request, &ws_pkt, 0);
     if(ws_ret != ESP_OK)
@@ -221,34 +675,35 @@ static esp_err_t async_ws_handler(httpd_req_t *request)
         ESP_LOGE(gadget_tag, "ERROR httpd_ws_recv_frame(1) failed! CODE(%s)", esp_err_to_name(ws_ret) );
         return ws_ret;
     }
-    //display frame length
-    ESP_LOGI(gadget_tag, "websocket packet length: %d", ws_pkt.len);
-    if(ws_pkt.len)
+    if(idx < 0)
     {
-        //string based comm from ws, add 1 additional space for \0 char
-        data_buf = calloc(1, ws_pkt.len + 1);
-        if(data_buf == NULL)
-        {
-            ESP_LOGE(gadget_tag, "ERROR failed to calloc onto ws data_buf!");
-            return ESP_ERR_NO_MEM;
-        }
-        ws_pkt.payload = data_buf;
+        ESP_LOGE(gadget_tag, "ERROR websocket fd %d is not registered", fd);
+        return ESP_FAIL;
+    }
+    client = &ws_clients[idx];
+    //the payload has to be read off the socket, an oversized frame cannot be skipped
+    if(ws_pkt.len > GADGET_WS_RX_SIZE)
+    {
+        ESP_LOGE(gadget_tag, "ERROR websocket frame of %d bytes exceeds %d, closing fd %d",
+                 (int)ws_pkt.len, GADGET_WS_RX_SIZE, fd);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if(ws_pkt.len == 0)
+        return ESP_OK;
 
-        //retrieve frame
-        ws_ret = httpd_ws_recv_frame(request, &ws_pkt, ws_pkt.len);
-        if(ws_ret != ESP_OK)
-        {
-            ESP_LOGE(gadget_tag, "ERROR http_ws_recv_frame(2) failed! CODE(%s)", esp_err_to_name(ws_ret));
-            free(data_buf);
-            return ws_ret;
-        }
-        ESP_LOGI(gadget_tag, "received packet with message: %s", ws_pkt.payload);
+    //retrieve frame
+    ws_pkt.payload = client->rx;
+    ws_ret = httpd_ws_recv_frame(request, &ws_pkt, GADGET_WS_RX_SIZE);
+    if(ws_ret != ESP_OK)
+    {
+        ESP_LOGE(gadget_tag, "ERROR http_ws_recv_frame(2) failed! CODE(%s)", esp_err_to_name(ws_ret));
+        return ws_ret;
     }
-    ESP_LOGI(gadget_tag, "ws_pkt.type: %d", ws_pkt.type);
 
-    //PROCESS INCOMING DATA HERE FOR
-    
-    free(data_buf);
+    if(ws_pkt.type == HTTPD_WS_TYPE_BINARY)
+        gadget_ws_dispatch(client, ws_pkt.payload, ws_pkt.len);
+    else
+        ESP_LOGD(gadget_tag, "ignoring ws frame type %d from fd %d", ws_pkt.type, fd);
 
     return ESP_OK;
 }
@@ -262,6 +717,9 @@ static esp_err_t gadget_start_websocket()
 {
     esp_err_t init = ESP_FAIL;
     httpd_config_t cfg = HTTPD_DEFAULT_CONFIG();
+    cfg.close_fn = gadget_ws_close_fn;
+    cfg.send_wait_timeout = GADGET_WS_SEND_TIMEOUT;
+    cfg.server_port = GADGET_WS_PORT;
     
     ESP_LOGI(gadget_tag, "attempting to start websocket server on port: %d", cfg.server_port);
     if(httpd_start(&gadget_global_server, &cfg) == ESP_OK)
@@ -276,7 +734,7 @@ static esp_err_t gadget_start_websocket()
 }
 
 /**
- * @brief send text over wifi
+ * @brief send text to every connected websocket client
  * 
  * @param payload 
  * @return true 
@@ -284,14 +742,12 @@ static esp_err_t gadget_start_websocket()
  */
 bool gadget_send_text_ws(const char *payload)
 {
-    esp_err_t sent = ESP_OK;
-    sent = gadget_send_over_ws(gadget_global_server, payload);
-    if(sent != ESP_OK)
+    size_t sent = gadget_ws_broadcast((const uint8_t *)payload, strlen(payload), false);
+    if(sent == 0)
     {
-        ESP_LOGI(gadget_tag, "ERROR failed to send message over websocket! CODE(%s)", esp_err_to_name(sent));
+        ESP_LOGI(gadget_tag, "ERROR failed to send message over websocket, no client reached");
         return false;
     }
-    ESP_LOGI(gadget_tag, "Sending payload: %s", payload);
+    ESP_LOGI(gadget_tag, "Sending payload to %d client(s): %s", (int)sent, payload);
     return true;
 }
-
@@ -0,0 +1,560 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "gadget_includes.h"
+#include "gadget_bus.h"
+#include "gadget_bench.h"
+
+const static char *gadget_tag = "gadget_mk1_bench";
+
+#if CONFIG_GADGET_BENCH
+
+#define GADGET_BENCH_MSGS           CONFIG_GADGET_BENCH_MSGS
+#define GADGET_BENCH_VERSION        2       // bumped when the result line changes
+#define GADGET_BENCH_SINKS          2       // gpio, comms
+#define GADGET_BENCH_SETTLE_MS      2000    // longest wait for msgs still in flight
+#define GADGET_BENCH_IDLE_MS        100     // nothing delivered for this long, the rest is lost
+
+#if CONFIG_GADGET_BUS_POOLED
+#define GADGET_BENCH_POOLED         true
+#else
+#define GADGET_BENCH_POOLED         false
+#endif
+
+/*
+ * End to end bus benchmark. Producer tasks send through central the same way
+ * every other module does, central forwards to the gpio and comms tasks and
+ * their handlers hand the msgs to gadget_bench_sink. Each payload carries the
+ * time it was first sent, so latency is producer to handler across both hops
+ * and does not see the restamp at central. Queue lengths and transports are
+ * fixed at build time, every result line records them so runs of differently
+ * configured builds can be put side by side. Latency is also kept per
+ * destination and lane, so a flood on one lane can be seen against the
+ * other.
+ */
+
+static const gadget_bench_case_t gadget_bench_cases[] = {
+    //name                   producers  prio  gpio%  gpio high%  comms high%  rate
+    { "single_gpio",            1,       -1,   100,       0,          0,         0 },
+    { "single_comms",           1,       -1,     0,       0,          0,         0 },
+    { "single_split",           1,       -1,    50,       0,          0,         0 },
+    { "single_high",            1,       -1,    50,     100,        100,         0 },
+    { "single_mixed_lanes",     1,       -1,    50,      20,         20,         0 },
+    { "paced_1k",               1,       -1,    50,      20,         20,      1000 },
+    { "multi2_split",           2,       -1,    50,      20,         20,         0 },
+    { "multi4_split",           4,       -1,    50,      20,         20,         0 },
+    { "multi4_equal_prio",      4,        0,    50,      20,         20,         0 },
+    { "multi4_above_central",   4,        1,    50,      20,         20,         0 },
+    { "multi4_paced",           4,       -1,    50,      20,         20,       500 },
+    //comms bulk lane flooded back to back, gpio control msgs on the high lane
+    { "comms_flood_gpio_high",  2,       -1,    10,     100,          0,         0 },
+};
+
+static const size_t gadget_bench_case_count = sizeof(gadget_bench_cases) / sizeof(gadget_bench_cases[0]);
+
+typedef struct {
+    const gadget_bench_case_t *bench;
+    TaskHandle_t task;
+    uint8_t id;
+    uint32_t offered;
+    uint32_t accepted;          //taken by central's queue
+    uint32_t no_payload;        //counted as offered and lost
+} gadget_bench_producer_t;
+
+//one per destination and lane, written only by the task whose handler feeds it
+typedef struct {
+    gadget_queue_stats_t stats;
+    uint32_t last_us;
+} gadget_bench_sink_t;
+
+typedef struct {
+    uint32_t offered;
+    uint32_t accepted;
+    uint32_t delivered;
+    uint32_t no_payload;        //payload pool empty, never sent
+    uint32_t ingress_drops;     //central queue full
+    uint32_t forward_drops;     //gpio or comms queue full
+    uint32_t duration_us;
+    gadget_queue_stats_t latency;
+    gadget_queue_stats_t lanes[GADGET_BENCH_SINKS][gadget_prio_max];
+} gadget_bench_result_t;
+
+static gadget_bench_producer_t bench_producers[GADGET_BENCH_MAX_PRODUCERS];
+static gadget_bench_sink_t bench_sinks[GADGET_BENCH_SINKS][gadget_prio_max];
+static const char *bench_sink_names[GADGET_BENCH_SINKS] = { "gpio", "comms" };
+static const char *bench_lane_names[gadget_prio_max] = { "high", "bulk" };
+static volatile uint8_t bench_run = 0;
+static volatile uint8_t bench_active_producers = 0;
+static volatile bool bench_running = false;
+static const char *bench_only = NULL;       //single case, NULL for the suite
+
+/**
+ * @brief find a case by name
+ *
+ */
+static const gadget_bench_case_t *gadget_bench_find(const char *name)
+{
+    for(size_t i = 0; i < gadget_bench_case_count; i++)
+    {
+        if(strcmp(gadget_bench_cases[i].name, name) == 0)
+            return &gadget_bench_cases[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief a priority offset from central, kept clear of idle and the top
+ *
+ */
+static UBaseType_t gadget_bench_priority(int offset)
+{
+    int prio = GADGET_CENTRAL_TASK_PRIORITY + offset;
+
+    if(prio < 1)
+        prio = 1;
+    if(prio > configMAX_PRIORITIES - 1)
+        prio = configMAX_PRIORITIES - 1;
+    return (UBaseType_t)prio;
+}
+
+/**
+ * @brief sum of the drops of both lanes of a queue
+ *
+ */
+static uint32_t gadget_bench_queue_drops(const gadget_msg_queue_t *msg_queue)
+{
+    gadget_queue_stats_t stats;
+    uint32_t drops = 0;
+
+    if(msg_queue == NULL)
+        return 0;
+
+    for(int prio = 0; prio < gadget_prio_max; prio++)
+    {
+        gadget_bus_get_queue_stats(msg_queue, prio, &stats);
+        drops += stats.drops;
+    }
+    return drops;
+}
+
+/**
+ * @brief send GADGET_BENCH_MSGS msgs to central once the runner says go
+ *
+ * Destination and lane are spread over every 100 msgs by stepping with a
+ * stride coprime to 100, so each producer sends the same mix in a different
+ * order without a random source. The lane share is per destination. Paced producers send rate / tick rate msgs
+ * a tick, or one every few ticks below the tick rate.
+ *
+ * @param pvParams the producer
+ */
+static void gadget_bench_producer(void *pvParams)
+{
+    gadget_bench_producer_t *producer = pvParams;
+    const gadget_bench_case_t *bench = producer->bench;
+    uint8_t run = bench_run;
+    uint32_t batch = 0;
+    TickType_t period = 1;
+    TickType_t wake;
+    gadget_msg_t msg;
+    uint8_t *payload;
+    uint32_t stamp;
+    msg_type_t msg_type;
+    msg_prio_t msg_prio;
+    uint8_t high_pct;
+
+    if(bench->rate > 0)
+    {
+        batch = bench->rate / configTICK_RATE_HZ;
+        if(batch == 0)
+        {
+            batch = 1;
+            period = configTICK_RATE_HZ / bench->rate;
+        }
+    }
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    wake = xTaskGetTickCount();
+
+    for(uint32_t seq = 0; seq < GADGET_BENCH_MSGS; seq++)
+    {
+        msg_type = ((seq * 61 + producer->id * 17) % 100 < bench->gpio_pct) ?
+                   gadget_msg_bench_gpio : gadget_msg_bench_comms;
+        high_pct = msg_type == gadget_msg_bench_gpio ? bench->gpio_high_pct : bench->comms_high_pct;
+        msg_prio = ((seq * 29 + producer->id * 7) % 100 < high_pct) ?
+                   gadget_prio_high : gadget_prio_bulk;
+
+        producer->offered++;
+        memset(&msg, 0, sizeof(gadget_msg_t));
+        payload = gadget_msg_alloc_payload(&msg, GADGET_BENCH_PAYLOAD_SIZE);
+        if(payload == NULL)
+        {
+            producer->no_payload++;
+        }
+        else
+        {
+            stamp = (uint32_t)esp_timer_get_time();
+            memcpy(payload, &stamp, sizeof(stamp));
+            payload[4] = seq & 0xFF;
+            payload[5] = (seq >> 8) & 0xFF;
+            payload[6] = producer->id;
+            payload[7] = run;
+            if(gadget_send_msg(gadget_central_msg_queue, 0, msg_prio, gadget_bench_id, msg_type, &msg) == pdPASS)
+                producer->accepted++;
+        }
+
+        if(batch > 0 && (seq + 1) % batch == 0)
+            vTaskDelayUntil(&wake, period);
+    }
+
+    __atomic_sub_fetch(&bench_active_producers, 1, __ATOMIC_RELEASE);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief msgs the sinks have taken this run
+ *
+ */
+static uint32_t gadget_bench_delivered(void)
+{
+    uint32_t delivered = 0;
+
+    for(int s = 0; s < GADGET_BENCH_SINKS; s++)
+    {
+        for(int prio = 0; prio < gadget_prio_max; prio++)
+            delivered += __atomic_load_n(&bench_sinks[s][prio].stats.receives, __ATOMIC_ACQUIRE);
+    }
+    return delivered;
+}
+
+/**
+ * @brief print one result as a single JSON line on stdout
+ *
+ */
+static void gadget_bench_report(const gadget_bench_case_t *bench, const gadget_bench_result_t *result)
+{
+    uint32_t lost = result->offered - result->delivered;
+    uint32_t drop_permille = result->offered ? (uint32_t)((uint64_t)lost * 1000 / result->offered) : 0;
+    uint32_t msgs_per_s = result->duration_us ?
+                          (uint32_t)((uint64_t)result->delivered * 1000000 / result->duration_us) : 0;
+
+    printf("{\"bench\":\"gadget_bus\",\"version\":%d,\"target\":\"%s\",\"case\":\"%s\","
+           "\"producers\":%u,\"producer_prio\":%u,\"central_prio\":%d,\"gpio_pct\":%u,"
+           "\"gpio_high_pct\":%u,\"comms_high_pct\":%u,\"rate\":%lu,"
+           "\"central_q\":[%d,%d],\"gpio_q\":[%d,%d],\"comms_q\":[%d,%d],"
+           "\"gpio_link\":\"%s\",\"comms_link\":\"%s\",\"pooled\":%s,\"burst\":%d,"
+           "\"offered\":%lu,\"accepted\":%lu,\"delivered\":%lu,"
+           "\"no_payload\":%lu,\"ingress_drops\":%lu,\"forward_drops\":%lu,\"drop_pct\":%lu.%lu,"
+           "\"duration_us\":%lu,\"msgs_per_s\":%lu,\"p50_us\":%lu,\"p99_us\":%lu,\"max_us\":%lu,\"lanes\":{",
+           GADGET_BENCH_VERSION, CONFIG_IDF_TARGET, bench->name,
+           bench->producers, (unsigned)gadget_bench_priority(bench->prio_offset), GADGET_CENTRAL_TASK_PRIORITY,
+           bench->gpio_pct, bench->gpio_high_pct, bench->comms_high_pct, (unsigned long)bench->rate,
+           GADGET_CENTRAL_HI_Q_SIZE, GADGET_CENTRAL_Q_SIZE,
+           GADGET_GPIO_HI_Q_SIZE, GADGET_GPIO_Q_SIZE,
+           GADGET_COMMS_HI_Q_SIZE, GADGET_COMMS_Q_SIZE,
+           gadget_gpio_msg_queue->transport == gadget_transport_ring ? "ring" : "queue",
+           gadget_comms_msg_queue->transport == gadget_transport_ring ? "ring" : "queue",
+           GADGET_BENCH_POOLED ? "true" : "false", GADGET_MSG_BURST_SIZE,
+           (unsigned long)result->offered, (unsigned long)result->accepted, (unsigned long)result->delivered,
+           (unsigned long)result->no_payload, (unsigned long)result->ingress_drops, (unsigned long)result->forward_drops,
+           (unsigned long)(drop_permille / 10), (unsigned long)(drop_permille % 10),
+           (unsigned long)result->duration_us, (unsigned long)msgs_per_s,
+           (unsigned long)gadget_bus_latency_percentile(&result->latency, 50),
+           (unsigned long)gadget_bus_latency_percentile(&result->latency, 99),
+           (unsigned long)result->latency.max_latency_us);
+
+    //"gpio":{"high":{...},"bulk":{...}},"comms":{...}
+    for(int s = 0; s < GADGET_BENCH_SINKS; s++)
+    {
+        printf("%s\"%s\":{", s ? "," : "", bench_sink_names[s]);
+        for(int prio = 0; prio < gadget_prio_max; prio++)
+        {
+            const gadget_queue_stats_t *lane = &result->lanes[s][prio];
+
+            printf("%s\"%s\":{\"delivered\":%lu,\"p50_us\":%lu,\"p99_us\":%lu,\"max_us\":%lu}",
+                   prio ? "," : "", bench_lane_names[prio], (unsigned long)lane->receives,
+                   (unsigned long)gadget_bus_latency_percentile(lane, 50),
+                   (unsigned long)gadget_bus_latency_percentile(lane, 99),
+                   (unsigned long)lane->max_latency_us);
+        }
+        printf("}");
+    }
+    printf("}}\n");
+    fflush(stdout);
+}
+
+/**
+ * @brief run one case to completion and report it
+ *
+ * @return true
+ * @return false a producer could not be created, nothing is reported
+ */
+static bool gadget_bench_run(const gadget_bench_case_t *bench)
+{
+    //the per lane histograms are too big for the bench task stack, one run at a time
+    static gadget_bench_result_t result;
+    uint32_t ingress_drops;
+    uint32_t forward_drops;
+    uint32_t delivered;
+    uint32_t last_delivered;
+    uint32_t start_us;
+    uint32_t last_us = 0;
+    int64_t settle_start;
+    int64_t idle_since;
+    uint8_t created = 0;
+
+    //new run id first, a late msg of the last run then misses the reset stats
+    __atomic_store_n(&bench_run, (uint8_t)(bench_run + 1), __ATOMIC_RELEASE);
+    memset(bench_sinks, 0, sizeof(bench_sinks));
+    memset(bench_producers, 0, sizeof(bench_producers));
+    ingress_drops = gadget_bench_queue_drops(gadget_central_msg_queue);
+    forward_drops = gadget_bench_queue_drops(gadget_gpio_msg_queue) + gadget_bench_queue_drops(gadget_comms_msg_queue);
+
+    bench_active_producers = 0;
+    for(uint8_t p = 0; p < bench->producers && p < GADGET_BENCH_MAX_PRODUCERS; p++)
+    {
+        bench_producers[p].bench = bench;
+        bench_producers[p].id = p;
+        if(xTaskCreate(gadget_bench_producer, "gadget_bench_prod", (ESP32_BIT*96), &bench_producers[p],
+                       gadget_bench_priority(bench->prio_offset), &bench_producers[p].task) != pdPASS)
+        {
+            ESP_LOGE(gadget_tag, "ERROR with creation of bench producer TASK!");
+            break;
+        }
+        created++;
+    }
+
+    bench_active_producers = created;
+    if(created != bench->producers)
+    {
+        //the ones made are still parked on their notification
+        for(uint8_t p = 0; p < created; p++)
+            vTaskDelete(bench_producers[p].task);
+        return false;
+    }
+
+    start_us = (uint32_t)esp_timer_get_time();
+    for(uint8_t p = 0; p < created; p++)
+        xTaskNotifyGive(bench_producers[p].task);
+
+    while(__atomic_load_n(&bench_active_producers, __ATOMIC_ACQUIRE) != 0)
+        vTaskDelay(1);
+
+    memset(&result, 0, sizeof(result));
+    for(uint8_t p = 0; p < created; p++)
+    {
+        result.offered += bench_producers[p].offered;
+        result.accepted += bench_producers[p].accepted;
+        result.no_payload += bench_producers[p].no_payload;
+    }
+
+    //central and the handlers drain what was accepted, or give up when it stops moving
+    settle_start = esp_timer_get_time();
+    idle_since = settle_start;
+    last_delivered = gadget_bench_delivered();
+    while((delivered = gadget_bench_delivered()) < result.accepted)
+    {
+        if(delivered != last_delivered)
+        {
+            last_delivered = delivered;
+            idle_since = esp_timer_get_time();
+        }
+        if(esp_timer_get_time() - idle_since > GADGET_BENCH_IDLE_MS * 1000 ||
+           esp_timer_get_time() - settle_start > GADGET_BENCH_SETTLE_MS * 1000)
+            break;
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    result.delivered = delivered;
+    result.ingress_drops = gadget_bench_queue_drops(gadget_central_msg_queue) - ingress_drops;
+    result.forward_drops = gadget_bench_queue_drops(gadget_gpio_msg_queue) +
+                           gadget_bench_queue_drops(gadget_comms_msg_queue) - forward_drops;
+
+    for(int s = 0; s < GADGET_BENCH_SINKS; s++)
+    {
+        for(int prio = 0; prio < gadget_prio_max; prio++)
+        {
+            const gadget_bench_sink_t *sink = &bench_sinks[s][prio];
+            const gadget_queue_stats_t *stats = &sink->stats;
+
+            if(stats->receives == 0)
+                continue;
+            result.lanes[s][prio] = *stats;
+            for(int b = 0; b < GADGET_LATENCY_BUCKETS; b++)
+                result.latency.latency[b] += stats->latency[b];
+            result.latency.receives += stats->receives;
+            if(stats->max_latency_us > result.latency.max_latency_us)
+                result.latency.max_latency_us = stats->max_latency_us;
+            if(sink->last_us - start_us > last_us - start_us || last_us == 0)
+                last_us = sink->last_us;
+        }
+    }
+    result.duration_us = result.delivered ? last_us - start_us : 0;
+
+    gadget_bench_report(bench, &result);
+    return true;
+}
+
+/**
+ * @brief run the picked case or the whole suite, then go away
+ *
+ * @param pvParams
+ */
+static void gadget_bench_task(void *pvParams)
+{
+    uint32_t failed = 0;
+
+    gadget_bus_set_drop_log(false);
+    for(size_t i = 0; i < gadget_bench_case_count; i++)
+    {
+        if(bench_only != NULL && strcmp(bench_only, gadget_bench_cases[i].name) != 0)
+            continue;
+        if(!gadget_bench_run(&gadget_bench_cases[i]))
+            failed++;
+    }
+    gadget_bus_set_drop_log(true);
+
+    if(failed)
+        ESP_LOGE(gadget_tag, "ERROR %lu bench case(s) did not run", (unsigned long)failed);
+    else
+        ESP_LOGI(gadget_tag, "bench done");
+
+#if CONFIG_GADGET_BENCH_AT_BOOT && CONFIG_IDF_TARGET_LINUX
+    //scripted host run, the exit code is the verdict
+    if(bench_only == NULL)
+        exit(failed ? 1 : 0);
+#endif
+
+    bench_running = false;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief run a benchmark case in the background, one JSON result line each
+ *
+ * @param name case name, NULL for every case
+ * @return true
+ * @return false unknown case, already running or no memory for the task
+ */
+bool gadget_bench_start(const char *name)
+{
+    const gadget_bench_case_t *bench = NULL;
+
+    if(name != NULL)
+    {
+        bench = gadget_bench_find(name);
+        if(bench == NULL)
+        {
+            ESP_LOGW(gadget_tag, "no bench case %s", name);
+            return false;
+        }
+    }
+
+    if(bench_running)
+    {
+        ESP_LOGW(gadget_tag, "bench already running");
+        return false;
+    }
+
+    ESP_LOGI(gadget_tag, "bench %s: %d msgs per producer", bench ? bench->name : "suite", GADGET_BENCH_MSGS);
+    bench_only = bench ? bench->name : NULL;
+    bench_running = true;
+    //above every producer so the start notifications all go out before one runs
+    if(xTaskCreate(gadget_bench_task, "gadget_bench", (ESP32_BIT*128), NULL,
+                   gadget_bench_priority(2), NULL) != pdPASS)
+    {
+        ESP_LOGE(gadget_tag, "ERROR with creation of bench TASK!");
+        bench_running = false;
+        return false;
+    }
+
+    return true;
+}
+
+bool gadget_bench_running(void)
+{
+    return bench_running;
+}
+
+/**
+ * @brief print the cases
+ *
+ */
+void gadget_bench_list(void)
+{
+    for(size_t i = 0; i < gadget_bench_case_count; i++)
+    {
+        const gadget_bench_case_t *bench = &gadget_bench_cases[i];
+
+        ESP_LOGI(gadget_tag, "%-22s %u producer(s), prio %+d, gpio %u%% (high %u%%), comms high %u%%, rate %lu",
+                 bench->name, bench->producers, bench->prio_offset, bench->gpio_pct, bench->gpio_high_pct,
+                 bench->comms_high_pct, (unsigned long)bench->rate);
+    }
+}
+
+/**
+ * @brief take a bench msg at the end of its route, from the gpio or comms
+ * handler. Msgs of an earlier run or that do not carry a bench payload are
+ * ignored.
+ *
+ * @param msg
+ */
+void gadget_bench_sink(const gadget_msg_t *msg)
+{
+    gadget_bench_sink_t *sink;
+    const uint8_t *payload = gadget_msg_payload(msg);
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    uint32_t stamp;
+    uint32_t latency;
+    uint32_t bucket = 0;
+
+    if(payload == NULL || gadget_msg_payload_len(msg) < GADGET_BENCH_PAYLOAD_SIZE)
+        return;
+    if(payload[7] != __atomic_load_n(&bench_run, __ATOMIC_ACQUIRE))
+        return;
+
+    sink = &bench_sinks[msg->msg_type == gadget_msg_bench_gpio ? 0 : 1]
+                       [msg->msg_prio < gadget_prio_max ? msg->msg_prio : gadget_prio_bulk];
+    memcpy(&stamp, payload, sizeof(stamp));
+    latency = now - stamp;
+    while(bucket < GADGET_LATENCY_BUCKETS - 1 && (latency >> bucket) != 0)
+        bucket++;
+
+    sink->stats.latency[bucket]++;
+    if(latency > sink->stats.max_latency_us)
+        sink->stats.max_latency_us = latency;
+    sink->last_us = now;
+    __atomic_store_n(&sink->stats.receives, sink->stats.receives + 1, __ATOMIC_RELEASE);
+}
+
+#else
+
+bool gadget_bench_start(const char *name)
+{
+    ESP_LOGI(gadget_tag, "benchmark disabled, enable GADGET_BENCH");
+    return false;
+}
+
+bool gadget_bench_running(void)
+{
+    return false;
+}
+
+void gadget_bench_list(void)
+{
+    ESP_LOGI(gadget_tag, "benchmark disabled, enable GADGET_BENCH");
+}
+
+void gadget_bench_sink(const gadget_msg_t *msg)
+{
+}
+
+#endif
@@ -0,0 +1,683 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "gadget_includes.h"
+#include "gadget_bus.h"
+#include "gadget_pool.h"
+#include "gadget_ring.h"
+
+const static char *gadget_tag = "gadget_msg_sender";
+
+#define GADGET_COALESCE_ENTRY(type, wire, queue, handler, coalesce, remote) [type] = coalesce,
+
+#define GADGET_COALESCE_DEST(type, wire, queue, handler, coalesce, remote) [type] = &queue,
+
+//coalescing rule, one entry per msg_type_t
+static const uint8_t gadget_coalesce_rules[gadget_msg_type_max] = {
+    GADGET_MSG_TYPE_LIST(GADGET_COALESCE_ENTRY)
+};
+
+//final destination, msgs for other queues never keep a toggle pair apart
+static gadget_msg_queue_t **const gadget_coalesce_dests[gadget_msg_type_max] = {
+    GADGET_MSG_TYPE_LIST(GADGET_COALESCE_DEST)
+};
+
+#define GADGET_MSG_QUEUE_MAX        4
+
+static gadget_msg_queue_t msg_queues[GADGET_MSG_QUEUE_MAX];
+static size_t msg_queue_count = 0;
+
+static const char *lane_names[gadget_prio_max] = { "high", "bulk" };
+
+//a full lane is logged on every drop unless a load test turned it off
+static volatile bool bus_drop_log = true;
+
+/**
+ * @brief back one lane with the queue's transport, on caller owned storage
+ *
+ */
+static bool gadget_lane_create(gadget_lane_t *lane, UBaseType_t length, gadget_transport_t transport, gadget_msg_t *buf)
+{
+    if(transport == gadget_transport_ring)
+    {
+        //no rounding up into memory the caller did not give us
+        if(gadget_ring_capacity_for(length) != length)
+        {
+            ESP_LOGE(gadget_tag, "ERROR ring lane length %u is not a power of two", (unsigned)length);
+            return false;
+        }
+        gadget_ring_init(&lane->ring, buf, sizeof(gadget_msg_t), length);
+        return true;
+    }
+
+    lane->queue = xQueueCreateStatic(length, sizeof(gadget_msg_t), (uint8_t *)buf, &lane->queue_buf);
+    return lane->queue != NULL;
+}
+
+/**
+ * @brief create a two lane msg queue on the requested transport
+ *
+ * Nothing is taken from the heap: the control blocks live in the bus and
+ * the msgs in storage, declared with GADGET_MSG_QUEUE_STORAGE. A ring lane
+ * must be a power of two long and must only ever have one producer.
+ * Consumers on either transport are woken by task notification.
+ *
+ * @param name          label used in logs and stats
+ * @param high_length   msgs held by the high priority lane
+ * @param bulk_length   msgs held by the bulk lane
+ * @param transport     gadget_transport_queue or gadget_transport_ring
+ * @param storage       high_length + bulk_length msgs
+ * @return gadget_msg_queue_t* NULL on failure
+ */
+gadget_msg_queue_t *gadget_msg_queue_create(const char *name,
+                    UBaseType_t high_length,
+                    UBaseType_t bulk_length,
+                    gadget_transport_t transport,
+                    gadget_msg_t *storage)
+{
+    gadget_msg_queue_t *msg_queue;
+
+    if(msg_queue_count >= GADGET_MSG_QUEUE_MAX)
+        return NULL;
+
+    msg_queue = &msg_queues[msg_queue_count];
+    memset(msg_queue, 0, sizeof(gadget_msg_queue_t));
+    msg_queue->name = name;
+    msg_queue->transport = transport;
+
+    if(!gadget_lane_create(&msg_queue->lane[gadget_prio_high], high_length, transport, storage) ||
+       !gadget_lane_create(&msg_queue->lane[gadget_prio_bulk], bulk_length, transport, storage + high_length))
+        return NULL;
+
+    msg_queue_count++;
+    return msg_queue;
+}
+
+/**
+ * @brief set the task notified on every send
+ *
+ * Msgs sent before this is set are still picked up on the consumer's first
+ * receive.
+ *
+ * @param msg_queue
+ * @param consumer
+ */
+void gadget_msg_queue_set_consumer(gadget_msg_queue_t *msg_queue, TaskHandle_t consumer)
+{
+    msg_queue->consumer = consumer;
+}
+
+/**
+ * @brief fill out from the sender fields and msg payload, IRAM for gadget_send_msg_from_isr
+ *
+ */
+static IRAM_ATTR void gadget_compile_msg(gadget_msg_t *out,
+                    msg_prio_t msg_prio,
+                    msg_sender_t msg_sender,
+                    msg_type_t msg_type,
+                    const gadget_msg_t *msg)
+{
+    out->msg_sender = msg_sender;
+    out->msg_type = msg_type;
+    out->msg_prio = (msg_prio < gadget_prio_max) ? msg_prio : gadget_prio_bulk;
+    out->msg_stamp = (uint32_t)esp_timer_get_time();
+#if CONFIG_GADGET_BUS_POOLED
+    out->payload = (msg != NULL) ? msg->payload : GADGET_POOL_NONE;
+    out->payload_len = (msg != NULL) ? msg->payload_len : 0;
+#else
+    if (msg != NULL)
+        memcpy(out->data, msg->data, GADGET_MSG_DATA_SIZE);
+    else
+        memset(out->data, 0, GADGET_MSG_DATA_SIZE);
+#endif
+}
+
+/**
+ * @brief msgs currently waiting on one lane, IRAM safe on a ring lane
+ *
+ */
+static IRAM_ATTR uint32_t gadget_lane_depth(gadget_msg_queue_t *msg_queue, gadget_lane_t *lane)
+{
+    if(msg_queue->transport == gadget_transport_ring)
+        return gadget_ring_count(&lane->ring);
+    return uxQueueMessagesWaiting(lane->queue);
+}
+
+/**
+ * @brief count a send attempt, relaxed atomics so several producers can share a lane
+ *
+ * IRAM safe on a ring lane, where it only reads the ring indices.
+ *
+ */
+static IRAM_ATTR void gadget_note_send(gadget_msg_queue_t *msg_queue, gadget_lane_t *lane, BaseType_t xStatus)
+{
+    gadget_queue_stats_t *stats = &lane->stats;
+    uint32_t depth;
+    uint32_t max_depth;
+
+    if(xStatus != pdPASS)
+    {
+        __atomic_add_fetch(&stats->drops, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    __atomic_add_fetch(&stats->sends, 1, __ATOMIC_RELAXED);
+
+    depth = gadget_lane_depth(msg_queue, lane);
+    max_depth = __atomic_load_n(&stats->max_depth, __ATOMIC_RELAXED);
+    while(depth > max_depth &&
+          !__atomic_compare_exchange_n(&stats->max_depth, &max_depth, depth, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief count a receive and bin its enqueue-to-dequeue latency, consumer side only
+ *
+ */
+static void gadget_note_recv(gadget_lane_t *lane, const gadget_msg_t *msg)
+{
+    gadget_queue_stats_t *stats = &lane->stats;
+    uint32_t latency = (uint32_t)esp_timer_get_time() - msg->msg_stamp;
+    uint32_t bucket = 0;
+
+    while(bucket < GADGET_LATENCY_BUCKETS - 1 && (latency >> bucket) != 0)
+        bucket++;
+
+    stats->receives++;
+    stats->latency[bucket]++;
+    if(latency > stats->max_latency_us)
+        stats->max_latency_us = latency;
+}
+
+/**
+ * @brief push on a lane, a full ring blocks until its consumer frees a slot
+ *
+ * The producer publishes itself as the lane's waiter before its last look at
+ * the ring, so a pop landing between that look and the block still notifies
+ * it. The wait shares notification index 0 with the producer's own inbox,
+ * which is harmless as gadget_recv_msg re-checks its lanes after every wake.
+ *
+ */
+static BaseType_t gadget_lane_push(gadget_msg_queue_t *msg_queue, gadget_lane_t *lane,
+                    const gadget_msg_t *out, TickType_t ticks_to_wait)
+{
+    TimeOut_t timeout;
+    bool pushed;
+
+    if(msg_queue->transport != gadget_transport_ring)
+        return xQueueSendToBack(lane->queue, out, ticks_to_wait);
+
+    pushed = gadget_ring_push(&lane->ring, out);
+    if(pushed || ticks_to_wait == 0)
+        return pushed ? pdPASS : errQUEUE_FULL;
+
+    vTaskSetTimeOutState(&timeout);
+    while(1)
+    {
+        __atomic_store_n(&lane->waiter, xTaskGetCurrentTaskHandle(), __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        pushed = gadget_ring_push(&lane->ring, out);
+        if(pushed || xTaskCheckForTimeOut(&timeout, &ticks_to_wait) == pdTRUE)
+            break;
+        ulTaskNotifyTake(pdTRUE, ticks_to_wait);
+    }
+    __atomic_store_n(&lane->waiter, NULL, __ATOMIC_RELAXED);
+
+    return pushed ? pdPASS : errQUEUE_FULL;
+}
+
+/**
+ * @brief non-blocking pop from one lane, wakes a producer waiting on a full ring
+ *
+ */
+static bool gadget_lane_pop(gadget_msg_queue_t *msg_queue, gadget_lane_t *lane, gadget_msg_t *msg)
+{
+    TaskHandle_t waiter;
+
+    if(msg_queue->transport != gadget_transport_ring)
+        return xQueueReceive(lane->queue, msg, 0) == pdPASS;
+
+    if(!gadget_ring_pop(&lane->ring, msg))
+        return false;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    waiter = __atomic_load_n(&lane->waiter, __ATOMIC_RELAXED);
+    if(waiter != NULL)
+        xTaskNotifyGive(waiter);
+
+    return true;
+}
+
+/**
+ * @brief pop the next msg, high lane first
+ *
+ * After GADGET_MSG_STARVATION_BOUND high msgs in a row one waiting bulk msg
+ * is let through.
+ *
+ */
+static bool gadget_msg_queue_pop(gadget_msg_queue_t *msg_queue, gadget_msg_t *msg)
+{
+    gadget_lane_t *high = &msg_queue->lane[gadget_prio_high];
+    gadget_lane_t *bulk = &msg_queue->lane[gadget_prio_bulk];
+
+    if(msg_queue->high_streak < GADGET_MSG_STARVATION_BOUND && gadget_lane_pop(msg_queue, high, msg))
+    {
+        msg_queue->high_streak++;
+        gadget_note_recv(high, msg);
+        return true;
+    }
+
+    msg_queue->high_streak = 0;
+    if(gadget_lane_pop(msg_queue, bulk, msg))
+    {
+        gadget_note_recv(bulk, msg);
+        return true;
+    }
+
+    if(gadget_lane_pop(msg_queue, high, msg))
+    {
+        msg_queue->high_streak = 1;
+        gadget_note_recv(high, msg);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief switch the per drop error log, drops are still counted either way
+ *
+ * @param on
+ */
+void gadget_bus_set_drop_log(bool on)
+{
+    bus_drop_log = on;
+}
+
+/**
+ * @brief compile and offload msg
+ *
+ * With CONFIG_GADGET_BUS_POOLED the payload reference held by msg is handed
+ * over to the queue, and released again if the lane is full. Either way msg
+ * no longer holds it afterwards and can be reused.
+ *
+ * @param msg_queue     target queue
+ * @param ticks_to_wait send timeout in ticks (0 = non-blocking)
+ * @param msg_prio      lane, gadget_prio_high or gadget_prio_bulk
+ * @param msg_sender    sender ID
+ * @param msg_type      message type
+ * @param msg           optional data payload, or NULL
+ */
+BaseType_t gadget_send_msg(gadget_msg_queue_t *msg_queue,
+                    TickType_t ticks_to_wait,
+                    msg_prio_t msg_prio,
+                    msg_sender_t msg_sender,
+                    msg_type_t msg_type,
+                    gadget_msg_t *msg)
+{
+    BaseType_t xStatus;
+    gadget_msg_t out;
+    gadget_lane_t *lane;
+    gadget_compile_msg(&out, msg_prio, msg_sender, msg_type, msg);
+#if CONFIG_GADGET_BUS_POOLED
+    if(msg != NULL)
+    {
+        msg->payload = GADGET_POOL_NONE;
+        msg->payload_len = 0;
+    }
+#endif
+
+    lane = &msg_queue->lane[out.msg_prio];
+    xStatus = gadget_lane_push(msg_queue, lane, &out, ticks_to_wait);
+
+    gadget_note_send(msg_queue, lane, xStatus);
+    if(xStatus != pdPASS)
+    {
+        if(bus_drop_log)
+            ESP_LOGE(gadget_tag, "msg queue (%s/%s) FULL!", msg_queue->name, lane_names[out.msg_prio]);
+        gadget_msg_release(&out);
+    }
+    else if(msg_queue->consumer != NULL)
+        xTaskNotifyGive(msg_queue->consumer);
+
+    return(xStatus);
+}
+
+/**
+ * @brief compile and offload msg from an ISR, ring transport only
+ *
+ * Safe with the flash cache disabled as long as it stays IRAM only:
+ * - the ring push, the stats atomics and gadget_compile_msg are IRAM,
+ *   esp_timer_get_time and vTaskNotifyGiveFromISR are IRAM in IDF;
+ * - nothing touches the pool, on a full lane the payload reference stays
+ *   with msg and the caller decides what to do with it;
+ * - no logging, a drop only shows in the lane stats.
+ * The ISR must be the lane's only producer, a task may not send on it too.
+ *
+ * @param msg_queue     target queue, gadget_transport_ring
+ * @param msg_prio      lane, gadget_prio_high or gadget_prio_bulk
+ * @param msg_sender    sender ID
+ * @param msg_type      message type
+ * @param msg           optional data payload, or NULL
+ * @param task_woken    set to pdTRUE if a yield is needed before leaving the ISR
+ * @return BaseType_t errQUEUE_FULL on a full lane or a queue transport
+ */
+IRAM_ATTR BaseType_t gadget_send_msg_from_isr(gadget_msg_queue_t *msg_queue,
+                    msg_prio_t msg_prio,
+                    msg_sender_t msg_sender,
+                    msg_type_t msg_type,
+                    gadget_msg_t *msg,
+                    BaseType_t *task_woken)
+{
+    BaseType_t xStatus;
+    gadget_msg_t out;
+    gadget_lane_t *lane;
+
+    if(msg_queue->transport != gadget_transport_ring)
+        return errQUEUE_FULL;
+
+    gadget_compile_msg(&out, msg_prio, msg_sender, msg_type, msg);
+    lane = &msg_queue->lane[out.msg_prio];
+    xStatus = gadget_ring_push(&lane->ring, &out) ? pdPASS : errQUEUE_FULL;
+
+    gadget_note_send(msg_queue, lane, xStatus);
+    if(xStatus != pdPASS)
+        return xStatus;
+
+#if CONFIG_GADGET_BUS_POOLED
+    //the queue owns the payload now
+    if(msg != NULL)
+    {
+        msg->payload = GADGET_POOL_NONE;
+        msg->payload_len = 0;
+    }
+#endif
+    if(msg_queue->consumer != NULL)
+        vTaskNotifyGiveFromISR(msg_queue->consumer, task_woken);
+
+    return(xStatus);
+}
+
+/**
+ * @brief receive one msg, high lane first
+ *
+ * @param msg_queue     source queue
+ * @param msg           output
+ * @param ticks_to_wait receive timeout in ticks
+ * @return BaseType_t pdPASS if msg was filled
+ */
+BaseType_t gadget_recv_msg(gadget_msg_queue_t *msg_queue,
+                    gadget_msg_t *msg,
+                    TickType_t ticks_to_wait)
+{
+    //notifications can outnumber msgs after a burst drain, so re-check the lanes
+    while(!gadget_msg_queue_pop(msg_queue, msg))
+    {
+        if(ticks_to_wait == 0 || ulTaskNotifyTake(pdTRUE, ticks_to_wait) == 0)
+            return gadget_msg_queue_pop(msg_queue, msg) ? pdPASS : pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+/**
+ * @brief reserve a payload of len bytes on msg
+ *
+ * msg must be zeroed or hold a payload of its own, which is released first.
+ *
+ * @param msg
+ * @param len
+ * @return uint8_t* writable payload, NULL if it does not fit
+ */
+uint8_t *gadget_msg_alloc_payload(gadget_msg_t *msg, size_t len)
+{
+#if CONFIG_GADGET_BUS_POOLED
+    gadget_pool_release(msg->payload);
+    msg->payload = gadget_pool_alloc(len);
+    if(msg->payload == GADGET_POOL_NONE)
+    {
+        msg->payload_len = 0;
+        return NULL;
+    }
+    msg->payload_len = len;
+    return gadget_pool_data(msg->payload);
+#else
+    if(len > GADGET_MSG_DATA_SIZE)
+        return NULL;
+    memset(msg->data, 0, GADGET_MSG_DATA_SIZE);
+    return msg->data;
+#endif
+}
+
+const uint8_t *gadget_msg_payload(const gadget_msg_t *msg)
+{
+#if CONFIG_GADGET_BUS_POOLED
+    return gadget_pool_data(msg->payload);
+#else
+    return msg->data;
+#endif
+}
+
+size_t gadget_msg_payload_len(const gadget_msg_t *msg)
+{
+#if CONFIG_GADGET_BUS_POOLED
+    return msg->payload_len;
+#else
+    return GADGET_MSG_DATA_SIZE;
+#endif
+}
+
+/**
+ * @brief drop the payload reference held by a received msg
+ *
+ * @param msg
+ */
+void gadget_msg_release(gadget_msg_t *msg)
+{
+#if CONFIG_GADGET_BUS_POOLED
+    gadget_pool_release(msg->payload);
+    msg->payload = GADGET_POOL_NONE;
+    msg->payload_len = 0;
+#else
+    (void)msg;
+#endif
+}
+
+/**
+ * @brief merge idempotent and cancelling msgs of a burst in place
+ *
+ * Order of the remaining msgs is kept. Dropped msgs are released. A toggle
+ * only cancels the same toggle right before it, nothing else for the same
+ * destination may sit between the two.
+ *
+ * @param burst
+ * @param count
+ * @return size_t msgs left in burst
+ */
+static size_t gadget_coalesce_burst(gadget_msg_t *burst, size_t count)
+{
+    size_t kept = 0;
+    size_t prev;
+    gadget_coalesce_t rule;
+
+    for(size_t i = 0; i < count; i++)
+    {
+        rule = gadget_coalesce_none;
+        if(burst[i].msg_type < gadget_msg_type_max)
+            rule = gadget_coalesce_rules[burst[i].msg_type];
+
+        prev = kept;
+        if(rule == gadget_coalesce_once)
+        {
+            for(prev = 0; prev < kept; prev++)
+            {
+                if(burst[prev].msg_type == burst[i].msg_type)
+                    break;
+            }
+        }
+        else if(rule == gadget_coalesce_toggle)
+        {
+            //last kept msg for the same destination, it has to be the partner
+            for(prev = kept; prev > 0; prev--)
+            {
+                if(burst[prev - 1].msg_type < gadget_msg_type_max &&
+                   gadget_coalesce_dests[burst[prev - 1].msg_type] == gadget_coalesce_dests[burst[i].msg_type])
+                    break;
+            }
+            if(prev > 0 && burst[prev - 1].msg_type == burst[i].msg_type)
+                prev--;
+            else
+                prev = kept;
+        }
+
+        if(prev == kept)
+        {
+            if(kept != i)
+                burst[kept] = burst[i];
+            kept++;
+            continue;
+        }
+
+        gadget_msg_release(&burst[i]);
+        if(rule == gadget_coalesce_toggle)
+        {
+            gadget_msg_release(&burst[prev]);
+            memmove(&burst[prev], &burst[prev + 1], (kept - prev - 1) * sizeof(gadget_msg_t));
+            kept--;
+        }
+    }
+
+    return kept;
+}
+
+/**
+ * @brief wait for a msg, then drain up to max_msgs without blocking
+ *
+ * @param msg_queue     source queue
+ * @param burst         output array of at least max_msgs
+ * @param max_msgs      burst bound
+ * @param ticks_to_wait timeout for the first msg
+ * @return size_t msgs left in burst after coalescing, 0 on timeout
+ */
+size_t gadget_recv_burst(gadget_msg_queue_t *msg_queue,
+                    gadget_msg_t *burst,
+                    size_t max_msgs,
+                    TickType_t ticks_to_wait)
+{
+    gadget_burst_stats_t *stats = &msg_queue->burst;
+    size_t count = 0;
+    size_t kept;
+
+    if(gadget_recv_msg(msg_queue, &burst[0], ticks_to_wait) != pdPASS)
+        return 0;
+
+    count = 1;
+    while(count < max_msgs && gadget_recv_msg(msg_queue, &burst[count], 0) == pdPASS)
+        count++;
+
+    kept = gadget_coalesce_burst(burst, count);
+
+    stats->bursts++;
+    stats->received += count;
+    stats->merged += count - kept;
+    if(count > stats->max_burst)
+        stats->max_burst = count;
+
+    return kept;
+}
+
+void gadget_bus_get_burst_stats(const gadget_msg_queue_t *msg_queue, gadget_burst_stats_t *stats)
+{
+    if(msg_queue == NULL || stats == NULL)
+        return;
+
+    *stats = msg_queue->burst;
+}
+
+/**
+ * @brief print burst and coalescing counters of every msg queue
+ *
+ */
+void gadget_bus_log_burst_stats(void)
+{
+    gadget_burst_stats_t *stats;
+
+    for(size_t i = 0; i < msg_queue_count; i++)
+    {
+        stats = &msg_queues[i].burst;
+        ESP_LOGI(gadget_tag, "%s(%s): bursts %lu, msgs %lu, merged %lu, max burst %d",
+                 msg_queues[i].name,
+                 msg_queues[i].transport == gadget_transport_ring ? "ring" : "queue",
+                 (unsigned long)stats->bursts, (unsigned long)stats->received,
+                 (unsigned long)stats->merged, stats->max_burst);
+    }
+}
+
+void gadget_bus_get_queue_stats(const gadget_msg_queue_t *msg_queue, msg_prio_t msg_prio, gadget_queue_stats_t *stats)
+{
+    if(msg_queue == NULL || msg_prio >= gadget_prio_max || stats == NULL)
+        return;
+
+    *stats = msg_queue->lane[msg_prio].stats;
+}
+
+/**
+ * @brief upper bound of the latency bucket holding the given percentile
+ *
+ * @param stats
+ * @param percentile 0 - 100
+ * @return uint32_t latency in us, 0 if nothing was received yet
+ */
+uint32_t gadget_bus_latency_percentile(const gadget_queue_stats_t *stats, uint8_t percentile)
+{
+    uint32_t total = 0;
+    uint32_t target;
+    uint32_t seen = 0;
+
+    for(int b = 0; b < GADGET_LATENCY_BUCKETS; b++)
+        total += stats->latency[b];
+    if(total == 0)
+        return 0;
+
+    target = ((uint64_t)total * percentile + 99) / 100;
+    for(int b = 0; b < GADGET_LATENCY_BUCKETS; b++)
+    {
+        seen += stats->latency[b];
+        if(seen >= target && seen > 0)
+            return (b == GADGET_LATENCY_BUCKETS - 1) ? stats->max_latency_us : (1UL << b);
+    }
+
+    return stats->max_latency_us;
+}
+
+/**
+ * @brief print traffic, depth and latency counters of every msg queue lane
+ *
+ */
+void gadget_bus_log_queue_stats(void)
+{
+    gadget_queue_stats_t stats;
+
+    for(size_t i = 0; i < msg_queue_count; i++)
+    {
+        for(int prio = 0; prio < gadget_prio_max; prio++)
+        {
+            gadget_bus_get_queue_stats(&msg_queues[i], prio, &stats);
+            ESP_LOGI(gadget_tag, "%s/%s: sent %lu, recv %lu, dropped %lu, max depth %lu, latency p50 <%luus p99 <%luus max %luus",
+                     msg_queues[i].name, lane_names[prio],
+                     (unsigned long)stats.sends, (unsigned long)stats.receives, (unsigned long)stats.drops,
+                     (unsigned long)stats.max_depth,
+                     (unsigned long)gadget_bus_latency_percentile(&stats, 50),
+                     (unsigned long)gadget_bus_latency_percentile(&stats, 99),
+                     (unsigned long)stats.max_latency_us);
+        }
+    }
+}
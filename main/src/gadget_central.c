@@ -10,10 +10,99 @@
 #include "esp_log.h"
 
 #include "gadget_includes.h"
+#include "gadget_bus.h"
+#include "gadget_input.h"
 #include "gadget_central.h"
+#include "gadget_telemetry.h"
 
 const static char *gadget_tag = "gadget_mk1_central";
 
+typedef void (*gadget_route_handler_t)(gadget_msg_queue_t *dest, gadget_msg_t *msg);
+
+typedef struct {
+    gadget_msg_queue_t **dest;
+    gadget_route_handler_t handler;
+} gadget_route_t;
+
+static void gadget_route_forward(gadget_msg_queue_t *dest, gadget_msg_t *msg);
+static void gadget_route_telemetry(gadget_msg_queue_t *dest, gadget_msg_t *msg);
+static void gadget_route_input(gadget_msg_queue_t *dest, gadget_msg_t *msg);
+
+#define GADGET_ROUTE_ENTRY(type, wire, queue, handler, coalesce, remote) [type] = { &queue, handler },
+
+//route table, one entry per msg_type_t
+static const gadget_route_t gadget_routes[gadget_msg_type_max] = {
+    GADGET_MSG_TYPE_LIST(GADGET_ROUTE_ENTRY)
+};
+
+/**
+ * @brief forward msg unchanged to its destination queue
+ * 
+ * The msg keeps its lane and any payload reference moves with it, nothing
+ * is copied.
+ * 
+ * @param dest 
+ * @param msg 
+ */
+static void gadget_route_forward(gadget_msg_queue_t *dest, gadget_msg_t *msg)
+{
+    gadget_send_msg(dest, 0, msg->msg_prio, gadget_central_id, msg->msg_type, msg);
+}
+
+/**
+ * @brief apply a telemetry period change in place
+ * 
+ * Payload is the new period in ms as a little endian uint16, 0 pauses the
+ * stream.
+ * 
+ * @param dest unused
+ * @param msg 
+ */
+static void gadget_route_telemetry(gadget_msg_queue_t *dest, gadget_msg_t *msg)
+{
+    const uint8_t *payload = gadget_msg_payload(msg);
+
+    if(payload != NULL && gadget_msg_payload_len(msg) >= 2)
+        gadget_telemetry_set_period(payload[0] | (payload[1] << 8));
+    else
+        ESP_LOGW(gadget_tag, "telemetry rate msg without a period");
+
+    gadget_msg_release(msg);
+}
+
+/**
+ * @brief a debounced input changed
+ * 
+ * @param dest unused
+ * @param msg 
+ */
+static void gadget_route_input(gadget_msg_queue_t *dest, gadget_msg_t *msg)
+{
+    gadget_input_handle_event(msg);
+    gadget_msg_release(msg);
+}
+
+/**
+ * @brief hand one msg to the handler of its type
+ * 
+ * @param msg 
+ */
+static void gadget_central_route(gadget_msg_t *msg)
+{
+    const gadget_route_t *route;
+
+    if(msg->msg_type < gadget_msg_type_max)
+    {
+        route = &gadget_routes[msg->msg_type];
+        route->handler(*route->dest, msg);
+    }
+    else
+    {
+        ESP_LOGW(gadget_tag, "UNKNOWN MESSAGE SENT TO CENTRAL %d", msg->msg_type);
+        gadget_msg_release(msg);
+    }
+}
+
 /**
  * @brief central task
  * 
@@ -21,55 +110,18 @@ const static char *gadget_tag = "gadget_mk1_central";
  */
 void gadget_central_task(void *pvParams)
 {
-    static BaseType_t gStatus;
-    static gadget_msg_t incoming_msg;
+    static gadget_msg_t burst[GADGET_MSG_BURST_SIZE];
+    size_t count;
 
     ESP_LOGI(gadget_tag, "Launching gadget central");
 
     while(1)
     {
-        gStatus = xQueueReceive(gadget_central_msg_queue, &incoming_msg, GADGET_MSG_SHORT_DELAY);
-        
-        if(gStatus == pdPASS)
-        {
-            switch(incoming_msg.msg_type)
-            {
-                case gadget_msg_init_gpio:
-                    ESP_LOGI(gadget_tag, "Sending msg to init_gpio");
-                    gadget_send_msg(gadget_gpio_msg_queue, 0, gadget_central_id, incoming_msg.msg_type, &incoming_msg);
-                break;
-
-                case gadget_msg_toggle_led_1:
-                    ESP_LOGI(gadget_tag, "Sending msg to blink led");
-                    gadget_send_msg(gadget_gpio_msg_queue, 0, gadget_central_id, incoming_msg.msg_type, &incoming_msg);
-                break;
-
-                case gadget_msg_toggle_led_2:
-                    ESP_LOGI(gadget_tag, "Sending msg to blink led");
-                    gadget_send_msg(gadget_gpio_msg_queue, 0, gadget_central_id, incoming_msg.msg_type, &incoming_msg);
-                break;
-
-                case gadget_msg_init_wifi_ap:
-                    ESP_LOGI(gadget_tag, "Sending msg to init wifi ap");
-                    gadget_send_msg(gadget_comms_msg_queue, 0, gadget_central_id, incoming_msg.msg_type, &incoming_msg);
-                break;
-
-                case gadget_msg_init_wifi_sta:
-                    ESP_LOGI(gadget_tag, "Sending msg to init wifi sta");
-                    gadget_send_msg(gadget_comms_msg_queue, 0, gadget_central_id, incoming_msg.msg_type, &incoming_msg);
-                break;
-
-                case gadget_msg_init_ping:
-                    ESP_LOGI(gadget_tag, "Initializing ping!");
-                    gadget_send_msg(gadget_comms_msg_queue, 0, gadget_central_id, incoming_msg.msg_type, &incoming_msg);
-                break;
-
-                default:
-                    ESP_LOGW(gadget_tag, "UNKNOWN MESSAGE SENT TO CENTRAL %d", incoming_msg.msg_type);
-                break;
-
-            }
-        }
+        count = gadget_recv_burst(gadget_central_msg_queue, burst,
+                                  GADGET_MSG_BURST_SIZE, portMAX_DELAY);
+
+        for(size_t i = 0; i < count; i++)
+            gadget_central_route(&burst[i]);
     }
 
 }
\ No newline at end of file
@@ -10,72 +10,171 @@
 #include "esp_log.h"
 
 #include "gadget_includes.h"
+#include "gadget_bus.h"
 #include "gadget_comms.h"
 #include "gadget_ap.h"
 #include "gadget_sta.h"
+#include "gadget_telemetry.h"
+#include "gadget_probe.h"
+#include "gadget_wifi.h"
+#include "gadget_bench.h"
 
 const static char *gadget_tag = "gadget_mk1_comms";
 
+static bool ap_init = false;
+static bool ws_init = false;
+static bool sta_init = false;
+static bool ping_init = false;
+static bool ping_pending = false;      //start deferred on DNS, a stop clears it
+static bool sta_online = false;
+
 /**
- * @brief central task
+ * @brief handle one comms msg
  * 
- * @param pvParams 
+ * @param msg 
  */
-void gadget_comms_task(void *pvParams)
+static void gadget_comms_handle_msg(gadget_msg_t *msg)
 {
-    static BaseType_t gStatus;
-    static gadget_msg_t incoming_msg;
-
-    static bool ap_init = false;
-    static bool sta_init = false;
-    static bool ping_init = false;
-
-    ESP_LOGI(gadget_tag, "Launching gadget comms");
+    const uint8_t *payload;
 
-    while(1)
+    switch(msg->msg_type)
     {
-        gStatus = xQueueReceive(gadget_comms_msg_queue, &incoming_msg, GADGET_MSG_SHORT_DELAY);
-        
-        if(gStatus == pdPASS)
-        {
-            switch(incoming_msg.msg_type)
+        //ap and sta toggle independently, neither restarts the wifi stack
+        case gadget_msg_init_wifi_ap:
+            if(!ap_init)
             {
-                case gadget_msg_init_wifi_ap:
-                    if(!ap_init)
-                    {
-                        ESP_LOGI(gadget_tag, "initializing ap");
-                        gadget_ap_init();
-                        ap_init = start_ws();
-                    }
-                    else
-                        ESP_LOGW(gadget_tag, "ap already initialized.");
-                break;
-                case gadget_msg_init_wifi_sta:
-                    ESP_LOGI(gadget_tag, "initializing sta");
-                    if(!sta_init)
-                        sta_init = gadget_sta_init(CONFIG_GADGET_STA_SSID, CONFIG_GADGET_STA_PASSWORD);
-                    else
-                        ESP_LOGW(gadget_tag, "sta already initialized.");
-                break;
+                ESP_LOGI(gadget_tag, "initializing ap");
+                ap_init = gadget_ap_init();
+                if(ap_init && !ws_init)
+                {
+                    ws_init = start_ws();
+                    if(ws_init)
+                        gadget_telemetry_start();
+                }
+            }
+            else
+            {
+                ESP_LOGW(gadget_tag, "stopping ap.");
+                gadget_ap_stop();
+                ap_init = false;
+            }
+        break;
+        case gadget_msg_init_wifi_sta:
+            if(!sta_init)
+            {
+                ESP_LOGI(gadget_tag, "initializing sta");
+                sta_init = gadget_sta_init(CONFIG_GADGET_STA_SSID, CONFIG_GADGET_STA_PASSWORD);
+            }
+            else
+            {
+                ESP_LOGW(gadget_tag, "stopping sta.");
+                ping_pending = false;
+                if(ping_init)
+                    ping_init = !gadget_stop_ping();
+                sta_init = !gadget_sta_stop();
+            }
+        break;
 
-                case gadget_msg_init_ping:
-                    if(!ping_init)
-                    {
-                        ESP_LOGI(gadget_tag, "starting ping.");
-                        ping_init = gadget_init_ping();
-                    }
-                    else
-                    {
-                        ESP_LOGW(gadget_tag, "stopping ping.");
-                        ping_init = !gadget_stop_ping();
-                    }
+        case gadget_msg_init_ping:
+            if(ping_pending)
+            {
+                ESP_LOGW(gadget_tag, "ping stopped before its target resolved.");
+                ping_pending = false;
+            }
+            else if(!ping_init)
+            {
+                ESP_LOGI(gadget_tag, "starting ping.");
+                ping_init = gadget_init_ping(&ping_pending);
+            }
+            else
+            {
+                ESP_LOGW(gadget_tag, "stopping ping.");
+                ping_init = !gadget_stop_ping();
+            }
+        break;
+
+        //only a start still waiting on DNS goes ahead, a stop in between wins
+        case gadget_msg_ping_resolved:
+            payload = gadget_msg_payload(msg);
+            if(!ping_pending || ping_init)
                 break;
+            ping_pending = false;
+            if(payload != NULL && payload[0])
+            {
+                ESP_LOGI(gadget_tag, "starting ping.");
+                ping_init = gadget_init_ping(&ping_pending);
+            }
+        break;
 
-                default:
-                    ESP_LOGW(gadget_tag, "UNKNOWN MESSAGE SENT TO CENTRAL %d", incoming_msg.msg_type);
+        case gadget_msg_sta_state:
+            payload = gadget_msg_payload(msg);
+            if(payload == NULL)
                 break;
+            sta_online = payload[0] == gadget_sta_online;
+            if(payload[0] == gadget_sta_backoff)
+                ESP_LOGW(gadget_tag, "sta link down, reason %d", payload[1]);
+            else
+                ESP_LOGI(gadget_tag, "sta state %d", payload[0]);
+        break;
 
+        case gadget_msg_init_probes:
+            if(!gadget_probe_running())
+            {
+                ESP_LOGI(gadget_tag, "starting probes.");
+                gadget_probe_start();
+            }
+            else
+            {
+                ESP_LOGW(gadget_tag, "stopping probes.");
+                gadget_probe_stop();
             }
+        break;
+
+        case gadget_msg_bench_comms:
+            gadget_bench_sink(msg);
+        break;
+
+        default:
+            ESP_LOGW(gadget_tag, "UNKNOWN MESSAGE SENT TO CENTRAL %d", msg->msg_type);
+        break;
+
+    }
+}
+
+/**
+ * @brief which links are up, GADGET_COMMS_* bits
+ * 
+ * @return uint8_t 
+ */
+uint8_t gadget_comms_get_status(void)
+{
+    return (ap_init ? GADGET_COMMS_AP_UP : 0) |
+           (sta_online ? GADGET_COMMS_STA_UP : 0) |
+           (ping_init ? GADGET_COMMS_PING_UP : 0) |
+           (ping_pending ? GADGET_COMMS_PING_WAIT : 0);
+}
+
+/**
+ * @brief central task
+ * 
+ * @param pvParams 
+ */
+void gadget_comms_task(void *pvParams)
+{
+    static gadget_msg_t burst[GADGET_MSG_BURST_SIZE];
+    size_t count;
+
+    ESP_LOGI(gadget_tag, "Launching gadget comms");
+
+    while(1)
+    {
+        count = gadget_recv_burst(gadget_comms_msg_queue, burst,
+                                  GADGET_MSG_BURST_SIZE, portMAX_DELAY);
+
+        for(size_t i = 0; i < count; i++)
+        {
+            gadget_comms_handle_msg(&burst[i]);
+            gadget_msg_release(&burst[i]);
         }
     }
 
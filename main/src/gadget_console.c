@@ -0,0 +1,763 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_wifi.h"
+#if CONFIG_GADGET_CONSOLE_STDIN
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include "driver/uart.h"
+#endif
+#if CONFIG_GADGET_POWER_LIGHT_SLEEP
+#include "esp_sleep.h"
+#endif
+
+#include "gadget_includes.h"
+#include "gadget_console.h"
+#include "gadget_bus.h"
+#include "gadget_pool.h"
+#include "gadget_gpio.h"
+#include "gadget_pattern.h"
+#include "gadget_input.h"
+#include "gadget_comms.h"
+#include "gadget_ap.h"
+#include "gadget_sta.h"
+#include "gadget_wifi.h"
+#include "gadget_probe.h"
+#include "gadget_dns.h"
+#include "gadget_telemetry.h"
+#include "gadget_power.h"
+#include "gadget_task.h"
+#include "gadget_profile.h"
+#include "gadget_bench.h"
+
+const static char *gadget_tag = "gadget_mk1_console";
+
+#if CONFIG_GADGET_CONSOLE_STDIN
+#define GADGET_CONSOLE_POLL_MS      20      // stdin poll, a blocking read would stall every task on the host
+#else
+#define GADGET_CONSOLE_UART         CONFIG_GADGET_CONSOLE_UART_NUM
+#define GADGET_CONSOLE_RX_BUF       CONFIG_GADGET_CONSOLE_RX_BUF
+#define GADGET_CONSOLE_EVENTS       16
+#endif
+
+#define GADGET_CONSOLE_PROMPT       "gadget> "
+
+/*
+ * The UART driver's ISR moves received bytes into its ring buffer and posts
+ * an event; the console task sleeps on that event queue with no timeout, so
+ * it costs nothing until a key is pressed. Bytes go through a small line
+ * editor (backspace, ctrl-u, ctrl-c, escape sequences swallowed) and a
+ * finished line is split into words and looked up in gadget_cmds.
+ *
+ * The host build reads stdin instead. Tasks of the POSIX port share one
+ * thread of execution, so stdin is polled non blocking rather than waited on.
+ */
+
+typedef enum {
+    gadget_esc_none,
+    gadget_esc_start,           //got ESC
+    gadget_esc_csi,             //got ESC [, wait for the final byte
+} gadget_esc_state_t;
+
+static char console_line[GADGET_CONSOLE_LINE_LEN];
+static size_t console_len = 0;
+static bool console_last_cr = false;
+static gadget_esc_state_t console_esc = gadget_esc_none;
+
+#if !CONFIG_GADGET_CONSOLE_STDIN
+static QueueHandle_t console_uart_queue = NULL;
+#endif
+static TaskHandle_t console_task = NULL;
+
+static gadget_console_stats_t console_stats;
+static portMUX_TYPE console_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_err_t gadget_cmd_help(int argc, char **argv);
+
+static void gadget_console_write(const char *text, size_t len)
+{
+#if CONFIG_GADGET_CONSOLE_STDIN
+    fwrite(text, 1, len, stdout);
+    fflush(stdout);
+#else
+    uart_write_bytes(GADGET_CONSOLE_UART, text, len);
+#endif
+}
+
+static void gadget_console_puts(const char *text)
+{
+    gadget_console_write(text, strlen(text));
+}
+
+static void gadget_console_count_error(void)
+{
+    portENTER_CRITICAL(&console_lock);
+    console_stats.errors++;
+    portEXIT_CRITICAL(&console_lock);
+}
+
+/**
+ * @brief led number from the command line, 1 based like the LED toggles
+ *
+ * @param arg
+ * @return int pin table entry, -1 if there is no such output
+ */
+static int gadget_console_led(const char *arg)
+{
+    char *end;
+    long led = strtol(arg, &end, 10);
+
+    if(end == arg || *end != '\0' || gadget_gpio_pin(led - 1) < 0)
+        return -1;
+    return led - 1;
+}
+
+/**
+ * @brief unsigned argument with an upper bound
+ *
+ * @param arg
+ * @param max
+ * @param value
+ * @return true parsed and in range
+ */
+static bool gadget_console_uint(const char *arg, unsigned long max, unsigned long *value)
+{
+    char *end;
+
+    *value = strtoul(arg, &end, 10);
+    return end != arg && *end == '\0' && *value <= max;
+}
+
+static bool gadget_console_send(msg_prio_t prio, msg_type_t type)
+{
+    return gadget_send_msg(gadget_central_msg_queue, 0, prio, gadget_main_id, type, NULL) == pdPASS;
+}
+
+static esp_err_t gadget_cmd_led(int argc, char **argv)
+{
+    int entry = gadget_console_led(argv[1]);
+    uint32_t mask;
+
+    if(entry < 0)
+        return ESP_ERR_INVALID_ARG;
+    mask = 1UL << entry;
+
+    if(strcmp(argv[2], "on") == 0)
+        return gadget_gpio_write(mask, 0, gadget_main_id) ? ESP_OK : ESP_FAIL;
+    if(strcmp(argv[2], "off") == 0)
+        return gadget_gpio_write(0, mask, gadget_main_id) ? ESP_OK : ESP_FAIL;
+    if(strcmp(argv[2], "toggle") == 0)
+    {
+        if(gadget_gpio_get_states() & mask)
+            return gadget_gpio_write(0, mask, gadget_main_id) ? ESP_OK : ESP_FAIL;
+        return gadget_gpio_write(mask, 0, gadget_main_id) ? ESP_OK : ESP_FAIL;
+    }
+
+    return ESP_ERR_INVALID_ARG;
+}
+
+#if CONFIG_GADGET_GPIO_MOCK
+/**
+ * @brief drive a mocked input, the edge takes the ISR and debounce path
+ *
+ * @param argc
+ * @param argv
+ * @return esp_err_t
+ */
+static esp_err_t gadget_cmd_input(int argc, char **argv)
+{
+    unsigned long input;
+    unsigned long level;
+
+    if(!gadget_console_uint(argv[1], GADGET_GPIO_MAX_PINS - 1, &input) ||
+       !gadget_console_uint(argv[2], 1, &level))
+        return ESP_ERR_INVALID_ARG;
+
+    gadget_input_mock_edge((int)input, (int)level);
+    return ESP_OK;
+}
+#endif
+
+/**
+ * @brief build and send a gadget_msg_pattern, see gadget_pattern.h for the layout
+ *
+ * @param entry
+ * @param kind
+ * @param repeat
+ * @param args
+ * @param args_len
+ * @return esp_err_t
+ */
+static esp_err_t gadget_console_pattern(int entry, gadget_pattern_kind_t kind, uint16_t repeat,
+                                        const uint8_t *args, size_t args_len)
+{
+    gadget_msg_t msg;
+    uint8_t *payload;
+
+    memset(&msg, 0, sizeof(gadget_msg_t));
+    payload = gadget_msg_alloc_payload(&msg, 4 + args_len);
+    if(payload == NULL)
+        return ESP_ERR_NO_MEM;
+
+    payload[0] = entry;
+    payload[1] = kind;
+    payload[2] = repeat;
+    payload[3] = repeat >> 8;
+    if(args_len > 0)
+        memcpy(&payload[4], args, args_len);
+
+    if(gadget_send_msg(gadget_central_msg_queue, 0, gadget_prio_high, gadget_main_id, gadget_msg_pattern, &msg) != pdPASS)
+        return ESP_FAIL;
+    return ESP_OK;
+}
+
+static esp_err_t gadget_cmd_pattern(int argc, char **argv)
+{
+    unsigned long a = 0;
+    unsigned long b = 0;
+    unsigned long repeat = 0;
+    uint8_t args[4];
+    int entry;
+
+    if(strcmp(argv[1], "test") == 0)
+        return gadget_pattern_load_test() ? ESP_OK : ESP_FAIL;
+
+    if(argc < 3 || (entry = gadget_console_led(argv[2])) < 0)
+        return ESP_ERR_INVALID_ARG;
+
+    if(strcmp(argv[1], "stop") == 0)
+        return gadget_console_pattern(entry, gadget_pattern_kind_off, 0, NULL, 0);
+
+    if(argc < 5 || (argc > 5 && !gadget_console_uint(argv[5], 0xFFFF, &repeat)))
+        return ESP_ERR_INVALID_ARG;
+
+    if(strcmp(argv[1], "blink") == 0)
+    {
+        if(!gadget_console_uint(argv[3], 0x7FFF, &a) || !gadget_console_uint(argv[4], 0x7FFF, &b))
+            return ESP_ERR_INVALID_ARG;
+        args[0] = a;
+        args[1] = a >> 8;
+        args[2] = b;
+        args[3] = b >> 8;
+        return gadget_console_pattern(entry, gadget_pattern_kind_blink, repeat, args, 4);
+    }
+
+    if(strcmp(argv[1], "fade") == 0)
+    {
+        if(!gadget_console_uint(argv[3], 0xFFFF, &a) || !gadget_console_uint(argv[4], 100, &b))
+            return ESP_ERR_INVALID_ARG;
+        args[0] = a;
+        args[1] = a >> 8;
+        args[2] = b;
+        return gadget_console_pattern(entry, gadget_pattern_kind_fade, repeat, args, 3);
+    }
+
+    return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t gadget_cmd_wifi(int argc, char **argv)
+{
+    wifi_interface_t ifx;
+    msg_type_t type;
+    bool on;
+
+    if(strcmp(argv[1], "ap") == 0)
+    {
+        ifx = WIFI_IF_AP;
+        type = gadget_msg_init_wifi_ap;
+    }
+    else if(strcmp(argv[1], "sta") == 0)
+    {
+        ifx = WIFI_IF_STA;
+        type = gadget_msg_init_wifi_sta;
+    }
+    else
+        return ESP_ERR_INVALID_ARG;
+
+    if(strcmp(argv[2], "on") == 0)
+        on = true;
+    else if(strcmp(argv[2], "off") == 0)
+        on = false;
+    else
+        return ESP_ERR_INVALID_ARG;
+
+    //comms toggles, only ask for a change
+    if(gadget_wifi_is_up(ifx) == on)
+    {
+        ESP_LOGI(gadget_tag, "wifi %s already %s", argv[1], argv[2]);
+        return ESP_OK;
+    }
+    return gadget_console_send(gadget_prio_bulk, type) ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t gadget_cmd_ping(int argc, char **argv)
+{
+    if(strcmp(argv[1], "stats") == 0)
+    {
+        gadget_ping_log_stats();
+        return ESP_OK;
+    }
+
+    if(strcmp(argv[1], "start") == 0)
+    {
+        //init_ping toggles, a start while one waits on DNS would cancel it
+        if(gadget_ping_running() || (gadget_comms_get_status() & GADGET_COMMS_PING_WAIT))
+        {
+            ESP_LOGW(gadget_tag, "ping already running, stop it first");
+            return ESP_ERR_INVALID_STATE;
+        }
+        if(argc > 2 && !gadget_ping_set_target(argv[2]))
+            return ESP_ERR_INVALID_ARG;
+        return gadget_console_send(gadget_prio_bulk, gadget_msg_init_ping) ? ESP_OK : ESP_FAIL;
+    }
+
+    if(strcmp(argv[1], "stop") == 0)
+    {
+        if(!gadget_ping_running() && !(gadget_comms_get_status() & GADGET_COMMS_PING_WAIT))
+            return ESP_OK;
+        return gadget_console_send(gadget_prio_bulk, gadget_msg_init_ping) ? ESP_OK : ESP_FAIL;
+    }
+
+    return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t gadget_cmd_probes(int argc, char **argv)
+{
+    bool on;
+
+    if(strcmp(argv[1], "stats") == 0)
+    {
+        gadget_probe_log_stats();
+        return ESP_OK;
+    }
+
+    if(strcmp(argv[1], "start") == 0)
+        on = true;
+    else if(strcmp(argv[1], "stop") == 0)
+        on = false;
+    else
+        return ESP_ERR_INVALID_ARG;
+
+    if(gadget_probe_running() == on)
+        return ESP_OK;
+    return gadget_console_send(gadget_prio_bulk, gadget_msg_init_probes) ? ESP_OK : ESP_FAIL;
+}
+
+//stats reports, one per subsystem
+static const struct {
+    const char *name;
+    void (*log)(void);
+} gadget_stats[] = {
+    { "pool",       gadget_pool_log_stats },
+    { "burst",      gadget_bus_log_burst_stats },
+    { "queue",      gadget_bus_log_queue_stats },
+    { "ws",         gadget_ws_log_clients },
+    { "telemetry",  gadget_telemetry_log_stats },
+    { "ping",       gadget_ping_log_stats },
+    { "sta",        gadget_sta_log_metrics },
+    { "wifi",       gadget_wifi_log_stats },
+    { "probes",     gadget_probe_log_stats },
+    { "dns",        gadget_dns_log_stats },
+    { "pattern",    gadget_pattern_log_stats },
+    { "input",      gadget_input_log_stats },
+    { "console",    gadget_console_log_stats },
+    { "power",      gadget_power_log_stats },
+    { "stacks",     gadget_task_log_stacks },
+    { "cpu",        gadget_profile_log_stats },
+};
+
+static esp_err_t gadget_cmd_stats(int argc, char **argv)
+{
+    if(argc == 1)
+    {
+        for(size_t i = 0; i < sizeof(gadget_stats) / sizeof(gadget_stats[0]); i++)
+            ESP_LOGI(gadget_tag, "stats %s", gadget_stats[i].name);
+        return ESP_OK;
+    }
+
+    for(size_t i = 0; i < sizeof(gadget_stats) / sizeof(gadget_stats[0]); i++)
+    {
+        if(strcmp(argv[1], gadget_stats[i].name) == 0)
+        {
+            gadget_stats[i].log();
+            return ESP_OK;
+        }
+    }
+
+    return ESP_ERR_INVALID_ARG;
+}
+
+/**
+ * @brief bus benchmark, one case or the whole suite, results go to stdout
+ *
+ */
+static esp_err_t gadget_cmd_bench(int argc, char **argv)
+{
+    if(argc > 1 && strcmp(argv[1], "list") == 0)
+    {
+        gadget_bench_list();
+        return ESP_OK;
+    }
+
+    return gadget_bench_start(argc > 1 ? argv[1] : NULL) ? ESP_OK : ESP_FAIL;
+}
+
+static const gadget_cmd_t gadget_cmds[] = {
+    { "help",    "[command]",                       "list commands",                0, 1, gadget_cmd_help },
+    { "led",     "<n> on|off|toggle",               "drive an output",              2, 2, gadget_cmd_led },
+#if CONFIG_GADGET_GPIO_MOCK
+    { "input",   "<n> 0|1",                         "set a mocked input level",     2, 2, gadget_cmd_input },
+#endif
+    { "pattern", "blink <n> <on ms> <off ms> [repeat] | fade <n> <ramp ms> <peak %> [repeat] | stop <n> | test",
+                                                    "led patterns",                 1, 5, gadget_cmd_pattern },
+    { "wifi",    "ap|sta on|off",                   "start / stop an interface",    2, 2, gadget_cmd_wifi },
+    { "ping",    "start [host] | stop | stats",     "ping session",                 1, 2, gadget_cmd_ping },
+    { "probes",  "start|stop|stats",                "reachability probes",          1, 1, gadget_cmd_probes },
+    { "stats",   "[name]",                          "subsystem reports",            0, 1, gadget_cmd_stats },
+    { "bench",   "[list|<case>]",                   "message bus benchmark",        0, 1, gadget_cmd_bench },
+};
+
+static const size_t gadget_cmd_count = sizeof(gadget_cmds) / sizeof(gadget_cmds[0]);
+
+static esp_err_t gadget_cmd_help(int argc, char **argv)
+{
+    for(size_t i = 0; i < gadget_cmd_count; i++)
+    {
+        if(argc > 1 && strcmp(argv[1], gadget_cmds[i].name) != 0)
+            continue;
+        ESP_LOGI(gadget_tag, "%s %s - %s", gadget_cmds[i].name, gadget_cmds[i].usage, gadget_cmds[i].help);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief split a line into words and run its command
+ *
+ * @param line modified in place
+ * @return esp_err_t ESP_ERR_NOT_FOUND for an unknown command
+ */
+esp_err_t gadget_console_exec(char *line)
+{
+    char *argv[GADGET_CONSOLE_MAX_ARGS + 1];
+    int argc = 0;
+    char *save = NULL;
+    char *word;
+    esp_err_t ret;
+
+    for(word = strtok_r(line, " \t", &save); word != NULL; word = strtok_r(NULL, " \t", &save))
+    {
+        if(argc == GADGET_CONSOLE_MAX_ARGS + 1)
+            break;
+        argv[argc++] = word;
+    }
+    if(argc == 0)
+        return ESP_OK;
+
+    for(size_t i = 0; i < gadget_cmd_count; i++)
+    {
+        const gadget_cmd_t *cmd = &gadget_cmds[i];
+
+        if(strcmp(argv[0], cmd->name) != 0)
+            continue;
+
+        if(argc - 1 < cmd->min_args || argc - 1 > cmd->max_args)
+            ret = ESP_ERR_INVALID_ARG;
+        else
+            ret = cmd->fn(argc, argv);
+
+        if(ret == ESP_ERR_INVALID_ARG)
+            ESP_LOGW(gadget_tag, "usage: %s %s", cmd->name, cmd->usage);
+        else if(ret != ESP_OK)
+            ESP_LOGW(gadget_tag, "%s failed CODE(%s)", cmd->name, esp_err_to_name(ret));
+        if(ret != ESP_OK)
+            gadget_console_count_error();
+        return ret;
+    }
+
+    ESP_LOGW(gadget_tag, "unknown command \"%s\", try help", argv[0]);
+    gadget_console_count_error();
+    return ESP_ERR_NOT_FOUND;
+}
+
+/**
+ * @brief line editor, feed it received bytes in order
+ *
+ * @param data
+ * @param len
+ */
+void gadget_console_feed(const uint8_t *data, size_t len)
+{
+    uint32_t lines = 0;
+    char c;
+
+    for(size_t i = 0; i < len; i++)
+    {
+        c = data[i];
+
+        //arrow and function keys, not supported, keep them off the line
+        if(console_esc == gadget_esc_start)
+        {
+            console_esc = c == '[' ? gadget_esc_csi : gadget_esc_none;
+            continue;
+        }
+        if(console_esc == gadget_esc_csi)
+        {
+            if(c >= 0x40 && c <= 0x7E)
+                console_esc = gadget_esc_none;
+            continue;
+        }
+
+        //CR LF is one line end
+        if(c == '\n' && console_last_cr)
+        {
+            console_last_cr = false;
+            continue;
+        }
+        console_last_cr = c == '\r';
+
+        switch(c)
+        {
+            case '\r':
+            case '\n':
+                gadget_console_puts("\r\n");
+                console_line[console_len] = '\0';
+                console_len = 0;
+                lines++;
+                gadget_console_exec(console_line);
+                gadget_console_puts(GADGET_CONSOLE_PROMPT);
+            break;
+
+            case 0x08:      //backspace
+            case 0x7F:      //delete, sent by most terminals for backspace
+                if(console_len > 0)
+                {
+                    console_len--;
+                    gadget_console_puts("\b \b");
+                }
+            break;
+
+            case 0x15:      //ctrl-u, kill the line
+                while(console_len > 0)
+                {
+                    console_len--;
+                    gadget_console_puts("\b \b");
+                }
+            break;
+
+            case 0x03:      //ctrl-c, abandon the line
+                console_len = 0;
+                gadget_console_puts("^C\r\n" GADGET_CONSOLE_PROMPT);
+            break;
+
+            case 0x1B:
+                console_esc = gadget_esc_start;
+            break;
+
+            default:
+                //printable only, leave room for the terminator
+                if(c >= 0x20 && c < 0x7F && console_len < GADGET_CONSOLE_LINE_LEN - 1)
+                {
+                    console_line[console_len++] = c;
+                    gadget_console_write(&c, 1);
+                }
+            break;
+        }
+    }
+
+    portENTER_CRITICAL(&console_lock);
+    console_stats.bytes += len;
+    console_stats.lines += lines;
+    portEXIT_CRITICAL(&console_lock);
+}
+
+#if CONFIG_GADGET_CONSOLE_STDIN
+/**
+ * @brief console task, polls stdin and feeds whatever arrived
+ *
+ * @param pvParams
+ */
+static void gadget_console_task(void *pvParams)
+{
+    uint8_t chunk[32];
+    ssize_t got;
+
+    gadget_console_puts(GADGET_CONSOLE_PROMPT);
+
+    while(1)
+    {
+        got = read(STDIN_FILENO, chunk, sizeof(chunk));
+        if(got <= 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS(GADGET_CONSOLE_POLL_MS));
+            continue;
+        }
+
+        portENTER_CRITICAL(&console_lock);
+        console_stats.wakeups++;
+        portEXIT_CRITICAL(&console_lock);
+        gadget_console_feed(chunk, got);
+    }
+}
+#else
+/**
+ * @brief console task, sleeps on the uart event queue until input arrives
+ *
+ * @param pvParams
+ */
+static void gadget_console_task(void *pvParams)
+{
+    uart_event_t event;
+    uint8_t chunk[32];
+    size_t left;
+    int got;
+
+    gadget_console_puts(GADGET_CONSOLE_PROMPT);
+
+    while(1)
+    {
+        if(xQueueReceive(console_uart_queue, &event, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        portENTER_CRITICAL(&console_lock);
+        console_stats.wakeups++;
+        portEXIT_CRITICAL(&console_lock);
+
+        switch(event.type)
+        {
+            case UART_DATA:
+                left = event.size;
+                while(left > 0)
+                {
+                    got = uart_read_bytes(GADGET_CONSOLE_UART, chunk, left < sizeof(chunk) ? left : sizeof(chunk), 0);
+                    if(got <= 0)
+                        break;
+                    gadget_console_feed(chunk, got);
+                    left -= got;
+                }
+            break;
+
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                //what is queued is a fragment now, start over clean
+                uart_flush_input(GADGET_CONSOLE_UART);
+                xQueueReset(console_uart_queue);
+                console_len = 0;
+                portENTER_CRITICAL(&console_lock);
+                console_stats.overruns++;
+                portEXIT_CRITICAL(&console_lock);
+                ESP_LOGW(gadget_tag, "console input overrun, line dropped");
+                gadget_console_puts(GADGET_CONSOLE_PROMPT);
+            break;
+
+            default:
+            break;
+        }
+    }
+}
+
+#endif
+
+GADGET_TASK_STATIC(console_task_def, "gadget_console_task", gadget_console_task,
+                   CONFIG_GADGET_CONSOLE_TASK_STACK, CONFIG_GADGET_CONSOLE_TASK_PRIORITY, CONFIG_GADGET_CONSOLE_TASK_CORE);
+
+#if CONFIG_GADGET_CONSOLE_STDIN
+/**
+ * @brief switch stdin to non blocking and start the console task
+ *
+ * @return esp_err_t
+ */
+esp_err_t gadget_console_init(void)
+{
+    int flags;
+
+    if(console_task != NULL)
+        return ESP_OK;
+
+    flags = fcntl(STDIN_FILENO, F_GETFL, 0);
+    if(flags < 0 || fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        ESP_LOGE(gadget_tag, "ERROR stdin cannot be made non blocking");
+        return ESP_FAIL;
+    }
+
+    console_task = gadget_task_start(&console_task_def, NULL);
+    if(console_task == NULL)
+        return ESP_FAIL;
+
+    ESP_LOGI(gadget_tag, "console on stdin, type help");
+    return ESP_OK;
+}
+#else
+/**
+ * @brief install the uart driver on the console port and start the console task
+ *
+ * @return esp_err_t
+ */
+esp_err_t gadget_console_init(void)
+{
+    esp_err_t ret;
+
+    if(console_task != NULL)
+        return ESP_OK;
+
+    ret = uart_driver_install(GADGET_CONSOLE_UART, GADGET_CONSOLE_RX_BUF, 0, GADGET_CONSOLE_EVENTS, &console_uart_queue, 0);
+    if(ret != ESP_OK)
+    {
+        ESP_LOGE(gadget_tag, "ERROR uart %d driver install CODE(%s)", GADGET_CONSOLE_UART, esp_err_to_name(ret));
+        return ret;
+    }
+
+#if CONFIG_GADGET_POWER_DFS || CONFIG_GADGET_POWER_LIGHT_SLEEP
+    //APB scales with the CPU under power management, clock the UART from the crystal so the baud holds
+    uart_config_t uart_config = {
+        .baud_rate = CONFIG_ESP_CONSOLE_UART_BAUDRATE,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_XTAL,
+    };
+    uart_param_config(GADGET_CONSOLE_UART, &uart_config);
+#endif
+#if CONFIG_GADGET_POWER_LIGHT_SLEEP
+    //rx edges wake the chip, the waking character itself is not received
+    uart_set_wakeup_threshold(GADGET_CONSOLE_UART, 3);
+    esp_sleep_enable_uart_wakeup(GADGET_CONSOLE_UART);
+#endif
+
+    console_task = gadget_task_start(&console_task_def, NULL);
+    if(console_task == NULL)
+    {
+        uart_driver_delete(GADGET_CONSOLE_UART);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(gadget_tag, "console on uart %d, type help", GADGET_CONSOLE_UART);
+    return ESP_OK;
+}
+#endif
+
+void gadget_console_get_stats(gadget_console_stats_t *stats)
+{
+    portENTER_CRITICAL(&console_lock);
+    *stats = console_stats;
+    portEXIT_CRITICAL(&console_lock);
+}
+
+void gadget_console_log_stats(void)
+{
+    gadget_console_stats_t stats;
+
+    gadget_console_get_stats(&stats);
+    ESP_LOGI(gadget_tag, "console: wakeups %lu, bytes %lu, lines %lu, errors %lu, overruns %lu",
+             (unsigned long)stats.wakeups, (unsigned long)stats.bytes, (unsigned long)stats.lines,
+             (unsigned long)stats.errors, (unsigned long)stats.overruns);
+}
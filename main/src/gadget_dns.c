@@ -0,0 +1,447 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "gadget_includes.h"
+#include "gadget_dns.h"
+#include "gadget_task.h"
+
+const static char *gadget_tag = "gadget_mk1_dns";
+
+#define GADGET_DNS_CACHE_SIZE       CONFIG_GADGET_DNS_CACHE_SIZE
+#define GADGET_DNS_TTL_MS           (CONFIG_GADGET_DNS_TTL_S * 1000UL)
+#define GADGET_DNS_NEG_TTL_MS       10000   // retry gap after a failed lookup
+#define GADGET_DNS_REFRESH_PCT      75      // refresh in the background past this share of the ttl
+#define GADGET_DNS_WAITERS          4       // callers that can wait on one lookup
+
+typedef enum {
+    gadget_dns_empty,
+    gadget_dns_pending,         //queued, no address yet
+    gadget_dns_valid,           //has an address, possibly stale
+    gadget_dns_failed,          //negative entry until expires_ms
+} gadget_dns_state_t;
+
+typedef struct {
+    gadget_dns_state_t state;
+    bool queued;                //in the resolver queue
+    char host[GADGET_DNS_HOST_LEN];
+    struct in_addr addr;
+    uint32_t resolved_ms;
+    uint32_t expires_ms;
+    uint32_t used_ms;
+    uint8_t waiter_count;       //one shot callbacks, fired when the queued lookup ends
+    gadget_dns_cb_t waiter_cb[GADGET_DNS_WAITERS];
+    void *waiter_arg[GADGET_DNS_WAITERS];
+} gadget_dns_entry_t;
+
+static gadget_dns_entry_t dns_cache[GADGET_DNS_CACHE_SIZE];
+static gadget_dns_stats_t dns_stats;
+static portMUX_TYPE dns_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static QueueHandle_t dns_queue = NULL;     //cache indices to resolve
+static StaticQueue_t dns_queue_buf;
+static uint8_t dns_queue_storage[GADGET_DNS_CACHE_SIZE];
+static TaskHandle_t dns_task = NULL;
+
+static inline uint32_t gadget_dns_now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+//wrap safe a >= b
+static inline bool gadget_dns_reached(uint32_t now, uint32_t when)
+{
+    return (int32_t)(now - when) >= 0;
+}
+
+/**
+ * @brief index of host in the cache, or a slot to put it in
+ *
+ * Takes an empty slot first and otherwise evicts the least recently used
+ * entry that is not being resolved or waited on. Caller holds dns_lock.
+ *
+ * @param host
+ * @param found     set if host was already cached
+ * @return int -1 if every slot is busy resolving
+ */
+static int gadget_dns_slot(const char *host, bool *found)
+{
+    int victim = -1;
+
+    *found = false;
+    for(int i = 0; i < GADGET_DNS_CACHE_SIZE; i++)
+    {
+        if(dns_cache[i].state != gadget_dns_empty && strcmp(dns_cache[i].host, host) == 0)
+        {
+            *found = true;
+            return i;
+        }
+    }
+
+    for(int i = 0; i < GADGET_DNS_CACHE_SIZE; i++)
+    {
+        if(dns_cache[i].state == gadget_dns_empty)
+            return i;
+        //a caller still waits on a lookup in flight or on the negative entry
+        if(dns_cache[i].queued || dns_cache[i].waiter_count > 0)
+            continue;
+        if(victim < 0 || (int32_t)(dns_cache[i].used_ms - dns_cache[victim].used_ms) < 0)
+            victim = i;
+    }
+    if(victim >= 0)
+        dns_stats.evictions++;
+
+    return victim;
+}
+
+/**
+ * @brief claim an entry for the resolver, caller holds dns_lock
+ *
+ * No FreeRTOS call may be made inside the critical section, so the index is
+ * only claimed here and handed over by gadget_dns_send once the lock is
+ * released.
+ *
+ * @param idx
+ * @return true the caller must send idx
+ */
+static bool gadget_dns_claim(int idx)
+{
+    if(dns_cache[idx].queued)
+        return false;
+    dns_cache[idx].queued = true;
+    return true;
+}
+
+/**
+ * @brief hand claimed entries to the resolver task, called without dns_lock
+ *
+ * @param idx
+ * @param count
+ */
+static void gadget_dns_send(const uint8_t *idx, int count)
+{
+    //queue depth equals the cache size and an entry is claimed once, so this cannot fail
+    for(int i = 0; i < count; i++)
+        xQueueSendToBack(dns_queue, &idx[i], 0);
+}
+
+/**
+ * @brief add cb to the callers waiting on an entry, caller holds dns_lock
+ *
+ * @return true
+ * @return false every waiter slot is taken
+ */
+static bool gadget_dns_add_waiter(gadget_dns_entry_t *entry, gadget_dns_cb_t cb, void *arg)
+{
+    for(int i = 0; i < entry->waiter_count; i++)
+    {
+        if(entry->waiter_cb[i] == cb && entry->waiter_arg[i] == arg)
+            return true;
+    }
+    if(entry->waiter_count >= GADGET_DNS_WAITERS)
+        return false;
+
+    entry->waiter_cb[entry->waiter_count] = cb;
+    entry->waiter_arg[entry->waiter_count] = arg;
+    entry->waiter_count++;
+    return true;
+}
+
+/**
+ * @brief cached address of host, never blocks
+ *
+ * A fresh entry is returned directly. A stale one is still returned while
+ * a refresh runs in the background. On a miss the lookup is queued and cb,
+ * if given, fires from the resolver task when it completes. Up to
+ * GADGET_DNS_WAITERS callers can wait on the same host, each is called once.
+ *
+ * @param host
+ * @param addr
+ * @param cb        optional
+ * @param arg
+ * @return esp_err_t ESP_OK with addr filled, ESP_ERR_NOT_FOUND while the
+ *                   lookup is pending or after it failed, ESP_ERR_NO_MEM if
+ *                   cb could not be added to the waiters
+ */
+esp_err_t gadget_dns_lookup(const char *host, struct in_addr *addr, gadget_dns_cb_t cb, void *arg)
+{
+    gadget_dns_entry_t *entry;
+    uint32_t now = gadget_dns_now_ms();
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    uint8_t send = 0;
+    int sends = 0;
+    bool found;
+    int idx;
+
+    //literal addresses need no lookup
+    if(inet_pton(AF_INET, host, addr) == 1)
+        return ESP_OK;
+
+    if(dns_queue == NULL || strlen(host) >= GADGET_DNS_HOST_LEN)
+        return ESP_ERR_INVALID_STATE;
+
+    portENTER_CRITICAL(&dns_lock);
+    idx = gadget_dns_slot(host, &found);
+    if(idx >= 0)
+    {
+        entry = &dns_cache[idx];
+        if(!found)
+        {
+            memset(entry, 0, sizeof(gadget_dns_entry_t));
+            strcpy(entry->host, host);
+            entry->state = gadget_dns_pending;
+        }
+        entry->used_ms = now;
+
+        if(entry->state == gadget_dns_valid)
+        {
+            *addr = entry->addr;
+            ret = ESP_OK;
+            if(gadget_dns_reached(now, entry->expires_ms))
+            {
+                dns_stats.stale_hits++;
+                if(gadget_dns_claim(idx))
+                    send = idx, sends = 1;
+            }
+            else
+            {
+                dns_stats.hits++;
+                //back in use past the refresh point, the resolver may be asleep
+                if(gadget_dns_reached(now, entry->resolved_ms + GADGET_DNS_TTL_MS / 100 * GADGET_DNS_REFRESH_PCT) &&
+                   gadget_dns_claim(idx))
+                    send = idx, sends = 1;
+            }
+        }
+        else
+        {
+            dns_stats.misses++;
+            if(cb != NULL && !gadget_dns_add_waiter(entry, cb, arg))
+                ret = ESP_ERR_NO_MEM;
+            if((entry->state == gadget_dns_pending || gadget_dns_reached(now, entry->expires_ms)) &&
+               gadget_dns_claim(idx))
+                send = idx, sends = 1;
+        }
+    }
+    portEXIT_CRITICAL(&dns_lock);
+    gadget_dns_send(&send, sends);
+
+    return ret;
+}
+
+/**
+ * @brief warm the cache for host in the background
+ *
+ * @param host
+ */
+void gadget_dns_prefetch(const char *host)
+{
+    struct in_addr addr;
+
+    gadget_dns_lookup(host, &addr, NULL, NULL);
+}
+
+/**
+ * @brief resolve one entry, runs in the resolver task
+ *
+ * @param idx
+ */
+static void gadget_dns_resolve(int idx)
+{
+    gadget_dns_entry_t *entry = &dns_cache[idx];
+    char host[GADGET_DNS_HOST_LEN];
+    struct addrinfo hint;
+    struct addrinfo *res = NULL;
+    struct in_addr addr;
+    gadget_dns_cb_t waiter_cb[GADGET_DNS_WAITERS];
+    void *waiter_arg[GADGET_DNS_WAITERS];
+    int waiters;
+    uint32_t now;
+    bool ok;
+    bool usable;
+
+    portENTER_CRITICAL(&dns_lock);
+    memcpy(host, entry->host, sizeof(host));
+    portEXIT_CRITICAL(&dns_lock);
+
+    memset(&hint, 0, sizeof(hint));
+    hint.ai_family = AF_INET;
+    ok = getaddrinfo(host, NULL, &hint, &res) == 0 && res != NULL;
+    if(ok)
+    {
+        addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr;
+        freeaddrinfo(res);
+    }
+    now = gadget_dns_now_ms();
+
+    portENTER_CRITICAL(&dns_lock);
+    //the slot may have been evicted and reused while getaddrinfo ran
+    if(strcmp(entry->host, host) != 0)
+    {
+        portEXIT_CRITICAL(&dns_lock);
+        return;
+    }
+    entry->queued = false;
+    dns_stats.resolves++;
+    if(ok)
+    {
+        entry->addr = addr;
+        entry->state = gadget_dns_valid;
+        entry->resolved_ms = now;
+        entry->expires_ms = now + GADGET_DNS_TTL_MS;
+    }
+    else
+    {
+        //keep serving a previously known address, retry later either way
+        dns_stats.failures++;
+        if(entry->state != gadget_dns_valid)
+            entry->state = gadget_dns_failed;
+        entry->expires_ms = now + GADGET_DNS_NEG_TTL_MS;
+    }
+    usable = entry->state == gadget_dns_valid;
+    waiters = entry->waiter_count;
+    memcpy(waiter_cb, entry->waiter_cb, sizeof(waiter_cb));
+    memcpy(waiter_arg, entry->waiter_arg, sizeof(waiter_arg));
+    entry->waiter_count = 0;
+    portEXIT_CRITICAL(&dns_lock);
+
+    if(!ok)
+        ESP_LOGW(gadget_tag, "failed to resolve %s", host);
+    for(int i = 0; i < waiters; i++)
+        waiter_cb[i](host, usable, waiter_arg[i]);
+}
+
+/**
+ * @brief queue refreshes for entries in use that near the end of their ttl
+ *
+ * @return TickType_t until the next refresh falls due, portMAX_DELAY if none will
+ */
+static TickType_t gadget_dns_refresh(void)
+{
+    uint32_t now = gadget_dns_now_ms();
+    gadget_dns_entry_t *entry;
+    uint32_t due;
+    uint32_t wait_ms = UINT32_MAX;
+    uint8_t send[GADGET_DNS_CACHE_SIZE];
+    int sends = 0;
+
+    portENTER_CRITICAL(&dns_lock);
+    for(int i = 0; i < GADGET_DNS_CACHE_SIZE; i++)
+    {
+        entry = &dns_cache[i];
+        //entries nobody asked for within a ttl are left to expire
+        if(entry->state != gadget_dns_valid || entry->queued ||
+           gadget_dns_reached(now, entry->used_ms + GADGET_DNS_TTL_MS))
+            continue;
+        due = entry->resolved_ms + GADGET_DNS_TTL_MS / 100 * GADGET_DNS_REFRESH_PCT;
+        if(gadget_dns_reached(now, due))
+        {
+            if(gadget_dns_claim(i))
+                send[sends++] = i;
+        }
+        else if(!gadget_dns_reached(due, entry->used_ms + GADGET_DNS_TTL_MS) && due - now < wait_ms)
+            wait_ms = due - now;
+    }
+    portEXIT_CRITICAL(&dns_lock);
+    gadget_dns_send(send, sends);
+
+    return wait_ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms) + 1;
+}
+
+/**
+ * @brief resolver task, the only place getaddrinfo blocks
+ *
+ * @param pvParams
+ */
+static void gadget_dns_task(void *pvParams)
+{
+    uint8_t idx;
+    TickType_t wait = portMAX_DELAY;
+
+    ESP_LOGI(gadget_tag, "Launching gadget dns task");
+
+    //sleeps until a lookup is queued or the next background refresh is due
+    while(1)
+    {
+        if(xQueueReceive(dns_queue, &idx, wait) == pdPASS)
+            gadget_dns_resolve(idx);
+        wait = gadget_dns_refresh();
+    }
+}
+
+GADGET_TASK_STATIC(dns_task_def, "gadget_dns_task", gadget_dns_task,
+                   CONFIG_GADGET_DNS_TASK_STACK, CONFIG_GADGET_DNS_TASK_PRIORITY, CONFIG_GADGET_DNS_TASK_CORE);
+
+/**
+ * @brief create the request queue and resolver task
+ *
+ * @return esp_err_t
+ */
+esp_err_t gadget_dns_init(void)
+{
+    if(dns_task != NULL)
+        return ESP_OK;
+
+    dns_queue = xQueueCreateStatic(GADGET_DNS_CACHE_SIZE, sizeof(uint8_t), dns_queue_storage, &dns_queue_buf);
+    if(dns_queue == NULL)
+    {
+        ESP_LOGE(gadget_tag, "ERROR with creation of dns QUEUE!");
+        return ESP_FAIL;
+    }
+
+    dns_task = gadget_task_start(&dns_task_def, NULL);
+    if(dns_task == NULL)
+        return ESP_FAIL;
+
+    return ESP_OK;
+}
+
+void gadget_dns_get_stats(gadget_dns_stats_t *stats)
+{
+    portENTER_CRITICAL(&dns_lock);
+    *stats = dns_stats;
+    portEXIT_CRITICAL(&dns_lock);
+}
+
+/**
+ * @brief print counters and every cached entry
+ *
+ */
+void gadget_dns_log_stats(void)
+{
+    gadget_dns_stats_t stats;
+    gadget_dns_entry_t entry;
+    uint32_t now = gadget_dns_now_ms();
+    char ip[INET_ADDRSTRLEN];
+
+    gadget_dns_get_stats(&stats);
+    ESP_LOGI(gadget_tag, "dns cache: hits %lu, stale hits %lu, misses %lu, resolves %lu, failures %lu, evictions %lu",
+             (unsigned long)stats.hits, (unsigned long)stats.stale_hits, (unsigned long)stats.misses,
+             (unsigned long)stats.resolves, (unsigned long)stats.failures, (unsigned long)stats.evictions);
+
+    for(int i = 0; i < GADGET_DNS_CACHE_SIZE; i++)
+    {
+        portENTER_CRITICAL(&dns_lock);
+        entry = dns_cache[i];
+        portEXIT_CRITICAL(&dns_lock);
+
+        if(entry.state == gadget_dns_empty)
+            continue;
+        inet_ntop(AF_INET, &entry.addr, ip, sizeof(ip));
+        ESP_LOGI(gadget_tag, "%s -> %s, %s, expires in %ld s", entry.host,
+                 entry.state == gadget_dns_valid ? ip : "-",
+                 entry.state == gadget_dns_pending ? "pending" : entry.state == gadget_dns_failed ? "failed" : "valid",
+                 (long)(int32_t)(entry.expires_ms - now) / 1000);
+    }
+}
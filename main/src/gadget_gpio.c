@@ -11,108 +11,394 @@
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_attr.h"
 
 #include "gadget_includes.h"
+#include "gadget_bus.h"
 #include "gadget_gpio.h"
+#include "gadget_pattern.h"
+#include "gadget_input.h"
+#include "gadget_bench.h"
 
+#if !CONFIG_GADGET_GPIO_MOCK
 #include "driver/gpio.h"
+#include "soc/soc.h"
+#include "soc/soc_caps.h"
+#include "soc/gpio_reg.h"
+#endif
 
 const static char *gadget_tag = "gadget_mk1_gpio";
 
 //defines
-#define GPIO_TOTAL                    2
-#define GADGET_LED_OUTPUT_IO_1        5 // Define the output GPIO
-#define GADGET_LED_OUTPUT_IO_2        6 // Define the output GPIO
+#define GADGET_GPIO_PINS            CONFIG_GADGET_GPIO_PINS
+#define GADGET_GPIO_PIN_MAX         64      // pins above this do not fit the two register banks
 
-#define GADGET_GPIO_OUTPUT_PIN_SEL  ( (1ULL << GADGET_LED_OUTPUT_IO_1) | (1ULL << GADGET_LED_OUTPUT_IO_2) )
 static esp_err_t gadget_init_gpio();
 
 static bool gpio_init = false;
 
-static bool gpio_states[GPIO_TOTAL] = { false };
+//pin table, entry n is bit n of every mask
+static uint8_t gpio_pins[GADGET_GPIO_MAX_PINS];
+static uint8_t gpio_pin_count = 0;
+static uint32_t gpio_valid_mask = 0;
+
+//output bitmap, read lock free by anyone
+static uint32_t gpio_states = 0;
+//serializes apply between the gpio task and pattern timer callbacks
+static portMUX_TYPE gpio_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if CONFIG_GADGET_GPIO_MOCK
+static gadget_gpio_regs_t gpio_regs;
+
+static inline IRAM_ATTR void gadget_gpio_reg_w1ts(int bank, uint32_t mask)
+{
+    gpio_regs.out[bank] |= mask;
+    gpio_regs.w1ts_writes++;
+}
+
+static inline IRAM_ATTR void gadget_gpio_reg_w1tc(int bank, uint32_t mask)
+{
+    gpio_regs.out[bank] &= ~mask;
+    gpio_regs.w1tc_writes++;
+}
 
 /**
- * @brief gpio task
- * 
- * @param pvParams 
+ * @brief the mocked register file, for host side checks
+ *
+ * @return const gadget_gpio_regs_t*
  */
-void gadget_gpio_task(void *pvParams)
+const gadget_gpio_regs_t *gadget_gpio_mock_regs(void)
+{
+    return &gpio_regs;
+}
+#else
+//write one set / clear register, every pin in mask changes in the same cycle
+static inline IRAM_ATTR void gadget_gpio_reg_w1ts(int bank, uint32_t mask)
 {
-    static BaseType_t gStatus;
-    static gadget_msg_t incoming_msg;
-    static esp_err_t err;
+#if SOC_GPIO_PIN_COUNT > 32
+    if(bank)
+    {
+        REG_WRITE(GPIO_OUT1_W1TS_REG, mask);
+        return;
+    }
+#endif
+    REG_WRITE(GPIO_OUT_W1TS_REG, mask);
+}
 
-    ESP_LOGI(gadget_tag, "Launching gadget gpio task");
+static inline IRAM_ATTR void gadget_gpio_reg_w1tc(int bank, uint32_t mask)
+{
+#if SOC_GPIO_PIN_COUNT > 32
+    if(bank)
+    {
+        REG_WRITE(GPIO_OUT1_W1TC_REG, mask);
+        return;
+    }
+#endif
+    REG_WRITE(GPIO_OUT_W1TC_REG, mask);
+}
+#endif
 
-    while(1)
+/**
+ * @brief fill the pin table from GADGET_GPIO_PINS
+ *
+ * @return esp_err_t ESP_ERR_INVALID_ARG on a bad or duplicate pin
+ */
+static esp_err_t gadget_gpio_parse_pins(void)
+{
+    const char *p = GADGET_GPIO_PINS;
+    char *end;
+    unsigned long pin;
+    uint64_t seen = 0;
+
+    gpio_pin_count = 0;
+    while(*p != '\0')
     {
-        gStatus = xQueueReceive(gadget_gpio_msg_queue, &incoming_msg, GADGET_MSG_SHORT_DELAY);
-        
-        if(gStatus == pdPASS)
+        pin = strtoul(p, &end, 10);
+        if(end == p || pin >= GADGET_GPIO_PIN_MAX || (seen & (1ULL << pin)) ||
+           gpio_pin_count >= GADGET_GPIO_MAX_PINS)
         {
-            switch(incoming_msg.msg_type)
+            ESP_LOGE(gadget_tag, "ERROR bad gpio pin list \"%s\"", GADGET_GPIO_PINS);
+            gpio_pin_count = 0;
+            return ESP_ERR_INVALID_ARG;
+        }
+        seen |= 1ULL << pin;
+        gpio_pins[gpio_pin_count++] = pin;
+
+        p = end;
+        while(*p == ',' || *p == ' ')
+            p++;
+    }
+
+    gpio_valid_mask = gpio_pin_count >= 32 ? UINT32_MAX : (1UL << gpio_pin_count) - 1;
+    return ESP_OK;
+}
+
+/**
+ * @brief drive outputs and record the new states, caller holds gpio_lock
+ *
+ * Table bits are translated to register bits for each bank, then every
+ * bank gets at most one W1TS and one W1TC write.
+ *
+ * @param set_mask      valid table bits to drive high
+ * @param clear_mask    valid table bits to drive low, none also in set_mask
+ * @return uint32_t the new state bitmap
+ */
+static inline IRAM_ATTR uint32_t gadget_gpio_apply_locked(uint32_t set_mask, uint32_t clear_mask)
+{
+    uint32_t set_reg[2] = { 0, 0 };
+    uint32_t clr_reg[2] = { 0, 0 };
+    uint32_t bits;
+    uint32_t states;
+    int n;
+
+    for(bits = set_mask; bits != 0; bits &= bits - 1)
+    {
+        n = __builtin_ctz(bits);
+        set_reg[gpio_pins[n] >> 5] |= 1UL << (gpio_pins[n] & 31);
+    }
+    for(bits = clear_mask; bits != 0; bits &= bits - 1)
+    {
+        n = __builtin_ctz(bits);
+        clr_reg[gpio_pins[n] >> 5] |= 1UL << (gpio_pins[n] & 31);
+    }
+
+    for(int bank = 0; bank < 2; bank++)
+    {
+        if(set_reg[bank])
+            gadget_gpio_reg_w1ts(bank, set_reg[bank]);
+        if(clr_reg[bank])
+            gadget_gpio_reg_w1tc(bank, clr_reg[bank]);
+    }
+
+    states = (gpio_states | set_mask) & ~clear_mask;
+    __atomic_store_n(&gpio_states, states, __ATOMIC_RELAXED);
+
+    return states;
+}
+
+/**
+ * @brief drive outputs, set wins where both masks name a pin
+ *
+ * Safe from the gpio task, pattern timer callbacks in ISR context, and host
+ * checks with the mock register file.
+ *
+ * @param set_mask      table bits to drive high
+ * @param clear_mask    table bits to drive low
+ * @return uint32_t the new state bitmap
+ */
+uint32_t IRAM_ATTR gadget_gpio_apply(uint32_t set_mask, uint32_t clear_mask)
+{
+    uint32_t states;
+
+    set_mask &= gpio_valid_mask;
+    clear_mask &= gpio_valid_mask & ~set_mask;
+
+    portENTER_CRITICAL_SAFE(&gpio_lock);
+    states = gadget_gpio_apply_locked(set_mask, clear_mask);
+    portEXIT_CRITICAL_SAFE(&gpio_lock);
+
+    return states;
+}
+
+/**
+ * @brief flip outputs
+ *
+ * The states are read under the same lock as the write, so a pattern edge
+ * landing in between cannot be undone by a stale read.
+ *
+ * @param toggle_mask
+ * @return uint32_t the new state bitmap
+ */
+static uint32_t gadget_gpio_apply_toggle(uint32_t toggle_mask)
+{
+    uint32_t states;
+
+    toggle_mask &= gpio_valid_mask;
+
+    portENTER_CRITICAL_SAFE(&gpio_lock);
+    states = gadget_gpio_apply_locked(toggle_mask & ~gpio_states, toggle_mask & gpio_states);
+    portEXIT_CRITICAL_SAFE(&gpio_lock);
+
+    return states;
+}
+
+/**
+ * @brief GPIO number behind a pin table entry
+ *
+ * @param entry
+ * @return int -1 if the entry is not in the table
+ */
+int gadget_gpio_pin(int entry)
+{
+    if(entry < 0 || entry >= gpio_pin_count)
+        return -1;
+    return gpio_pins[entry];
+}
+
+/**
+ * @brief route a pin back to the GPIO output register after a peripheral
+ * such as LEDC drove it, and leave it low
+ *
+ * @param entry
+ * @return esp_err_t
+ */
+esp_err_t gadget_gpio_reclaim(int entry)
+{
+    esp_err_t ret = ESP_OK;
+
+    if(entry < 0 || entry >= gpio_pin_count)
+        return ESP_ERR_INVALID_ARG;
+
+#if !CONFIG_GADGET_GPIO_MOCK
+    gpio_config_t gadget_io_config = {};
+    gadget_io_config.intr_type = GPIO_INTR_DISABLE;
+    gadget_io_config.mode = GPIO_MODE_OUTPUT;
+    gadget_io_config.pin_bit_mask = 1ULL << gpio_pins[entry];
+    gadget_io_config.pull_down_en = 1;
+    gadget_io_config.pull_up_en = 0;
+
+    ret = gpio_config(&gadget_io_config);
+#endif
+    gadget_gpio_apply(0, 1UL << entry);
+
+    return ret;
+}
+
+/**
+ * @brief ask the gpio task to change outputs through central
+ *
+ * @param set_mask
+ * @param clear_mask
+ * @param sender
+ * @return true
+ * @return false central queue full or no payload block
+ */
+bool gadget_gpio_write(uint32_t set_mask, uint32_t clear_mask, msg_sender_t sender)
+{
+    gadget_msg_t msg;
+    uint8_t *payload;
+
+    memset(&msg, 0, sizeof(gadget_msg_t));
+    payload = gadget_msg_alloc_payload(&msg, 8);
+    if(payload == NULL)
+        return false;
+
+    for(int i = 0; i < 4; i++)
+    {
+        payload[i] = set_mask >> (8 * i);
+        payload[4 + i] = clear_mask >> (8 * i);
+    }
+
+    return gadget_send_msg(gadget_central_msg_queue, 0, gadget_prio_high, sender, gadget_msg_gpio_write, &msg) == pdPASS;
+}
+
+/**
+ * @brief handle one gpio msg
+ * 
+ * @param msg 
+ */
+static void gadget_gpio_handle_msg(gadget_msg_t *msg)
+{
+    esp_err_t err;
+    const uint8_t *payload;
+    uint32_t set_mask = 0;
+    uint32_t clear_mask = 0;
+
+    switch(msg->msg_type)
+    {
+        case gadget_msg_init_gpio:
+            ESP_LOGI(gadget_tag, "initializing gpio");
+            if(!gpio_init)
             {
-                case gadget_msg_init_gpio:
-                    ESP_LOGI(gadget_tag, "initializing gpio");
-                    if(!gpio_init)
-                    {
-                        err = gadget_init_gpio();
-                        if(err != ESP_OK)
-                        {
-                            ESP_LOGE(gadget_tag, "ERROR init gpio!");
-                            gpio_init = false;
-                        }
-                        else
-                        {
-                            //ESP_LOGI(gadget_tag, "PASS init gpio!");
-                            gpio_init = true;
-                        }
-                    }
-                    else
-                        ESP_LOGI(gadget_tag, "gpio already initialized.");
-                break;
+                err = gadget_init_gpio();
+                if(err != ESP_OK)
+                {
+                    ESP_LOGE(gadget_tag, "ERROR init gpio!");
+                    gpio_init = false;
+                }
+                else
+                {
+                    //ESP_LOGI(gadget_tag, "PASS init gpio!");
+                    gpio_init = true;
+                }
+                err = gadget_input_init();
+                if(err != ESP_OK)
+                    ESP_LOGE(gadget_tag, "ERROR init gpio inputs CODE(%s)", esp_err_to_name(err));
+            }
+            else
+                ESP_LOGI(gadget_tag, "gpio already initialized.");
+        break;
 
-                case gadget_msg_toggle_led_1:
-                    if(gpio_init)
-                    {
-                        if(!gpio_states[0])
-                        {
-                            ESP_LOGI(gadget_tag, "LED 1 ON");
-                            gpio_set_level(GADGET_LED_OUTPUT_IO_1, 1);
-                            gpio_states[0] = true;
-                        }
-                        else
-                        {
-                            ESP_LOGI(gadget_tag, "LED 1 OFF");
-                            gpio_set_level(GADGET_LED_OUTPUT_IO_1, 0);
-                            gpio_states[0] = false;
-                        }
-                    }
-                break;
+        case gadget_msg_toggle_led_1:
+        case gadget_msg_toggle_led_2:
+            if(gpio_init)
+            {
+                int led = msg->msg_type == gadget_msg_toggle_led_1 ? 0 : 1;
+                uint32_t states = gadget_gpio_apply_toggle(1UL << led);
 
-                case gadget_msg_toggle_led_2:
-                if(gpio_init)
-                    {
-                        if(!gpio_states[1])
-                        {
-                            ESP_LOGI(gadget_tag, "LED 2 ON");
-                            gpio_set_level(GADGET_LED_OUTPUT_IO_2, 1);
-                            gpio_states[1] = true;
-                        }
-                        else
-                        {
-                            ESP_LOGI(gadget_tag, "LED 2 OFF");
-                            gpio_set_level(GADGET_LED_OUTPUT_IO_2, 0);
-                            gpio_states[1] = false;
-                        }
-                    }
-                break;
+                ESP_LOGI(gadget_tag, "LED %d %s", led + 1, (states & (1UL << led)) ? "ON" : "OFF");
+            }
+        break;
 
-                default:
-                    ESP_LOGW(gadget_tag, "UNKNOWN MESSAGE SENT TO GPIO %d", incoming_msg.msg_type);
+        case gadget_msg_gpio_write:
+            payload = gadget_msg_payload(msg);
+            if(!gpio_init || payload == NULL || gadget_msg_payload_len(msg) < 8)
                 break;
-
+            for(int i = 0; i < 4; i++)
+            {
+                set_mask |= (uint32_t)payload[i] << (8 * i);
+                clear_mask |= (uint32_t)payload[4 + i] << (8 * i);
             }
+            gadget_gpio_apply(set_mask, clear_mask);
+        break;
+
+        case gadget_msg_pattern:
+            if(gpio_init)
+                gadget_pattern_handle_msg(msg);
+        break;
+
+        case gadget_msg_bench_gpio:
+            gadget_bench_sink(msg);
+        break;
+
+        default:
+            ESP_LOGW(gadget_tag, "UNKNOWN MESSAGE SENT TO GPIO %d", msg->msg_type);
+        break;
+
+    }
+}
+
+/**
+ * @brief output states as a bitmap, bit n is pin table entry n
+ * 
+ * @return uint32_t 
+ */
+uint32_t gadget_gpio_get_states(void)
+{
+    return __atomic_load_n(&gpio_states, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief gpio task
+ * 
+ * @param pvParams 
+ */
+void gadget_gpio_task(void *pvParams)
+{
+    static gadget_msg_t burst[GADGET_MSG_BURST_SIZE];
+    size_t count;
+
+    ESP_LOGI(gadget_tag, "Launching gadget gpio task");
+
+    while(1)
+    {
+        count = gadget_recv_burst(gadget_gpio_msg_queue, burst,
+                                  GADGET_MSG_BURST_SIZE, portMAX_DELAY);
+
+        for(size_t i = 0; i < count; i++)
+        {
+            gadget_gpio_handle_msg(&burst[i]);
+            gadget_msg_release(&burst[i]);
         }
     }
 
@@ -120,24 +406,37 @@ void gadget_gpio_task(void *pvParams)
 
 
 /**
- * @brief Initialize gadget gpio pins
+ * @brief Initialize gadget gpio pins from the pin table, all driven low
  * 
- * GPIO 5 : LED
- * 
- * @return true 
- * @return false 
+ * @return esp_err_t
  */
 static esp_err_t gadget_init_gpio()
 {
     esp_err_t init = ESP_OK;
+    uint64_t pin_sel = 0;
+
+    init = gadget_gpio_parse_pins();
+    if(init != ESP_OK)
+        return init;
+
+    for(int i = 0; i < gpio_pin_count; i++)
+        pin_sel |= 1ULL << gpio_pins[i];
+
+#if !CONFIG_GADGET_GPIO_MOCK
     gpio_config_t gadget_io_config = {};
     gadget_io_config.intr_type = GPIO_INTR_DISABLE;
     gadget_io_config.mode = GPIO_MODE_OUTPUT;
-    gadget_io_config.pin_bit_mask = GADGET_GPIO_OUTPUT_PIN_SEL;
+    gadget_io_config.pin_bit_mask = pin_sel;
     gadget_io_config.pull_down_en = 1;
     gadget_io_config.pull_up_en = 0;
 
     init = gpio_config(&gadget_io_config);
+    if(init != ESP_OK)
+        return init;
+#endif
+
+    gadget_gpio_apply(0, gpio_valid_mask);
+    ESP_LOGI(gadget_tag, "%d gpio outputs, pin mask 0x%llx", gpio_pin_count, (unsigned long long)pin_sel);
 
     return init;
-}
\ No newline at end of file
+}
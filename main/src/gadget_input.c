@@ -0,0 +1,470 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+
+#include "gadget_includes.h"
+#include "gadget_ring.h"
+#include "gadget_input.h"
+
+#if !CONFIG_GADGET_GPIO_MOCK
+#include "esp_intr_alloc.h"
+#include "driver/gpio.h"
+#include "soc/soc.h"
+#include "soc/soc_caps.h"
+#include "soc/gpio_reg.h"
+#endif
+
+const static char *gadget_tag = "gadget_mk1_input";
+
+#define GADGET_INPUT_PINS           CONFIG_GADGET_INPUT_PINS
+#define GADGET_INPUT_DEBOUNCE_US    (CONFIG_GADGET_INPUT_DEBOUNCE_MS * 1000UL)
+#define GADGET_INPUT_RING_SIZE      CONFIG_GADGET_INPUT_RING_SIZE
+
+/*
+ * Edges are stamped in the GPIO ISR and pushed on a lock-free ring. The ISR
+ * also starts the input's one shot debounce timer if it is not pending.
+ * The timer callback (FreeRTOS timer task, the ring's only consumer) drains
+ * the ring, and once an input has been quiet for the debounce time reads
+ * its level and posts a change to central. A bouncing input re-arms its
+ * timer for the rest of the window, so the ring is drained at least once
+ * per debounce time while edges arrive: no edge is lost as long as fewer
+ * than GADGET_INPUT_RING_SIZE edges, across all inputs, land in one
+ * debounce window.
+ */
+
+//one captured edge
+typedef struct {
+    uint32_t stamp_us;
+    uint8_t input;
+} gadget_input_edge_t;
+
+typedef struct {
+    uint8_t pin;
+    bool armed;                 //debounce timer started by the ISR, not yet settled
+    bool pending;               //edges seen since the last settle
+    bool level;                 //debounced
+    uint32_t last_edge_us;
+    TimerHandle_t timer;
+} gadget_input_t;
+
+static gadget_input_t inputs[GADGET_INPUT_MAX_PINS];
+static uint8_t input_count = 0;
+static uint32_t input_states = 0;
+
+static gadget_input_edge_t input_ring_buf[GADGET_INPUT_RING_SIZE];
+static gadget_ring_t input_ring;
+
+static gadget_input_stats_t input_stats;
+static portMUX_TYPE input_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if CONFIG_GADGET_GPIO_MOCK
+static uint64_t input_mock_levels = 0;
+#endif
+
+static inline uint32_t gadget_input_now_us(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+/**
+ * @brief raw level of an input, safe from ISR
+ *
+ * @param input
+ * @return true high
+ */
+static inline IRAM_ATTR bool gadget_input_level(int input)
+{
+    uint8_t pin = inputs[input].pin;
+
+#if CONFIG_GADGET_GPIO_MOCK
+    return (input_mock_levels >> pin) & 1;
+#else
+#if SOC_GPIO_PIN_COUNT > 32
+    if(pin >= 32)
+        return (REG_READ(GPIO_IN1_REG) >> (pin - 32)) & 1;
+#endif
+    return (REG_READ(GPIO_IN_REG) >> pin) & 1;
+#endif
+}
+
+/**
+ * @brief edge ISR, capture and make sure a debounce timer is coming
+ *
+ * All inputs share the one GPIO ISR so there is a single ring producer.
+ *
+ * @param arg input index
+ */
+static void IRAM_ATTR gadget_input_isr(void *arg)
+{
+    gadget_input_t *in = &inputs[(uintptr_t)arg];
+    BaseType_t task_woken = pdFALSE;
+    gadget_input_edge_t edge = {
+        .stamp_us = gadget_input_now_us(),
+        .input = (uintptr_t)arg,
+    };
+
+    portENTER_CRITICAL_ISR(&input_lock);
+    input_stats.edges++;
+    if(!gadget_ring_push(&input_ring, &edge))
+        input_stats.overflows++;
+    portEXIT_CRITICAL_ISR(&input_lock);
+
+    if(!__atomic_exchange_n(&in->armed, true, __ATOMIC_ACQ_REL))
+    {
+        if(xTimerStartFromISR(in->timer, &task_woken) != pdPASS)
+            __atomic_store_n(&in->armed, false, __ATOMIC_RELEASE);
+    }
+
+    if(task_woken)
+        portYIELD_FROM_ISR();
+}
+
+/**
+ * @brief move captured edges onto their inputs, timer task only
+ *
+ * @param now_us
+ */
+static void gadget_input_drain(uint32_t now_us)
+{
+    gadget_input_edge_t edge;
+    uint32_t dwell_us;
+    uint32_t max_dwell_us = 0;
+
+    while(gadget_ring_pop(&input_ring, &edge))
+    {
+        inputs[edge.input].pending = true;
+        inputs[edge.input].last_edge_us = edge.stamp_us;
+        dwell_us = now_us - edge.stamp_us;
+        if(dwell_us > max_dwell_us)
+            max_dwell_us = dwell_us;
+    }
+
+    portENTER_CRITICAL(&input_lock);
+    if(max_dwell_us > input_stats.max_dwell_us)
+        input_stats.max_dwell_us = max_dwell_us;
+    portEXIT_CRITICAL(&input_lock);
+}
+
+/**
+ * @brief post a debounced change to central
+ *
+ * @param input
+ * @param level
+ * @param last_edge_us
+ * @param settled_us
+ */
+static void gadget_input_post(int input, bool level, uint32_t last_edge_us, uint32_t settled_us)
+{
+    gadget_msg_t msg;
+    uint8_t *payload;
+    BaseType_t sent = errQUEUE_FULL;
+
+    memset(&msg, 0, sizeof(gadget_msg_t));
+    payload = gadget_msg_alloc_payload(&msg, 10);
+    if(payload != NULL)
+    {
+        payload[0] = input;
+        payload[1] = level;
+        for(int i = 0; i < 4; i++)
+        {
+            payload[2 + i] = last_edge_us >> (8 * i);
+            payload[6 + i] = settled_us >> (8 * i);
+        }
+        sent = gadget_send_msg(gadget_central_msg_queue, 0, gadget_prio_high, gadget_main_id, gadget_msg_input_event, &msg);
+    }
+
+    portENTER_CRITICAL(&input_lock);
+    if(sent == pdPASS)
+        input_stats.events++;
+    else
+        input_stats.dropped++;
+    portEXIT_CRITICAL(&input_lock);
+}
+
+/**
+ * @brief debounce timer, settles one input once it has been quiet long enough
+ *
+ * @param timer
+ */
+static void gadget_input_settle(TimerHandle_t timer)
+{
+    int n = (uintptr_t)pvTimerGetTimerID(timer);
+    gadget_input_t *in = &inputs[n];
+    uint32_t now_us;
+    uint32_t quiet_us;
+    bool level;
+
+    //cleared before draining, an edge from here on starts the timer again
+    __atomic_store_n(&in->armed, false, __ATOMIC_RELEASE);
+
+    now_us = gadget_input_now_us();
+    gadget_input_drain(now_us);
+    if(!in->pending)
+        return;
+
+    quiet_us = now_us - in->last_edge_us;
+    if(quiet_us < GADGET_INPUT_DEBOUNCE_US)
+    {
+        //still bouncing, wait out the rest of the window
+        __atomic_store_n(&in->armed, true, __ATOMIC_RELEASE);
+        xTimerChangePeriod(timer, pdMS_TO_TICKS((GADGET_INPUT_DEBOUNCE_US - quiet_us + 999) / 1000) + 1, 0);
+        return;
+    }
+
+    in->pending = false;
+    level = gadget_input_level(n);
+    if(level == in->level)
+        return;
+
+    in->level = level;
+    if(level)
+        __atomic_or_fetch(&input_states, 1UL << n, __ATOMIC_RELAXED);
+    else
+        __atomic_and_fetch(&input_states, ~(1UL << n), __ATOMIC_RELAXED);
+
+    gadget_input_post(n, level, in->last_edge_us, now_us);
+}
+
+/**
+ * @brief fill the input table from GADGET_INPUT_PINS
+ *
+ * @return esp_err_t
+ */
+static esp_err_t gadget_input_parse_pins(void)
+{
+    const char *p = GADGET_INPUT_PINS;
+    char *end;
+    unsigned long pin;
+
+    input_count = 0;
+    while(*p != '\0')
+    {
+        pin = strtoul(p, &end, 10);
+        if(end == p || pin >= 64 || input_count >= GADGET_INPUT_MAX_PINS)
+        {
+            ESP_LOGE(gadget_tag, "ERROR bad input pin list \"%s\"", GADGET_INPUT_PINS);
+            input_count = 0;
+            return ESP_ERR_INVALID_ARG;
+        }
+        inputs[input_count++].pin = pin;
+
+        p = end;
+        while(*p == ',' || *p == ' ')
+            p++;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief configure input pins, debounce timers and the edge ISR
+ *
+ * Inputs have the internal pull-up enabled and trigger on both edges.
+ *
+ * @return esp_err_t
+ */
+esp_err_t gadget_input_init(void)
+{
+    esp_err_t ret;
+    uint64_t pin_sel = 0;
+    uint32_t capacity;
+
+    if(input_count != 0)
+        return ESP_OK;
+
+    ret = gadget_input_parse_pins();
+    if(ret != ESP_OK || input_count == 0)
+        return ret;
+
+    //largest power of two that fits the buffer
+    capacity = gadget_ring_capacity_for(GADGET_INPUT_RING_SIZE);
+    if(capacity > GADGET_INPUT_RING_SIZE)
+        capacity >>= 1;
+    gadget_ring_init(&input_ring, input_ring_buf, sizeof(gadget_input_edge_t), capacity);
+
+    for(int i = 0; i < input_count; i++)
+    {
+        inputs[i].timer = xTimerCreate("gadget_input", pdMS_TO_TICKS(CONFIG_GADGET_INPUT_DEBOUNCE_MS) + 1,
+                                       pdFALSE, (void *)(uintptr_t)i, gadget_input_settle);
+        if(inputs[i].timer == NULL)
+        {
+            ESP_LOGE(gadget_tag, "ERROR with creation of input debounce TIMER!");
+            return ESP_ERR_NO_MEM;
+        }
+        pin_sel |= 1ULL << inputs[i].pin;
+    }
+
+#if !CONFIG_GADGET_GPIO_MOCK
+    gpio_config_t gadget_io_config = {};
+    gadget_io_config.intr_type = GPIO_INTR_ANYEDGE;
+    gadget_io_config.mode = GPIO_MODE_INPUT;
+    gadget_io_config.pin_bit_mask = pin_sel;
+    gadget_io_config.pull_down_en = 0;
+    gadget_io_config.pull_up_en = 1;
+
+    ret = gpio_config(&gadget_io_config);
+    if(ret != ESP_OK)
+        return ret;
+
+    ret = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if(ret != ESP_OK && ret != ESP_ERR_INVALID_STATE)
+        return ret;
+
+    for(int i = 0; i < input_count; i++)
+    {
+        ret = gpio_isr_handler_add(inputs[i].pin, gadget_input_isr, (void *)(uintptr_t)i);
+        if(ret != ESP_OK)
+            return ret;
+    }
+#endif
+
+    //start from the current levels so the first event is a real change
+    for(int i = 0; i < input_count; i++)
+    {
+        inputs[i].level = gadget_input_level(i);
+        if(inputs[i].level)
+            input_states |= 1UL << i;
+    }
+
+    ESP_LOGI(gadget_tag, "%d gpio inputs, pin mask 0x%llx, %lu edges per %d ms without loss",
+             input_count, (unsigned long long)pin_sel, (unsigned long)capacity, CONFIG_GADGET_INPUT_DEBOUNCE_MS);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief debounced levels, bit n is input n
+ *
+ * @return uint32_t
+ */
+uint32_t gadget_input_get_states(void)
+{
+    return __atomic_load_n(&input_states, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief central side of gadget_msg_input_event, logs the change and the
+ * time it took to get here
+ *
+ * @param msg
+ */
+void gadget_input_handle_event(const gadget_msg_t *msg)
+{
+    const uint8_t *payload = gadget_msg_payload(msg);
+    uint32_t now_us = gadget_input_now_us();
+    uint32_t last_edge_us = 0;
+    uint32_t settled_us = 0;
+    uint32_t latency_us;
+    uint32_t delivery_us;
+    uint32_t bucket = 0;
+
+    if(payload == NULL || gadget_msg_payload_len(msg) < 10)
+        return;
+
+    for(int i = 0; i < 4; i++)
+    {
+        last_edge_us |= (uint32_t)payload[2 + i] << (8 * i);
+        settled_us |= (uint32_t)payload[6 + i] << (8 * i);
+    }
+    //the debounce window itself is by design, count only what goes past it
+    latency_us = now_us - last_edge_us;
+    latency_us = latency_us > GADGET_INPUT_DEBOUNCE_US ? latency_us - GADGET_INPUT_DEBOUNCE_US : 0;
+    delivery_us = now_us - settled_us;
+
+    while(bucket < GADGET_INPUT_LATENCY_BUCKETS - 1 && (latency_us >> bucket) != 0)
+        bucket++;
+
+    portENTER_CRITICAL(&input_lock);
+    input_stats.latency[bucket]++;
+    if(latency_us > input_stats.max_latency_us)
+        input_stats.max_latency_us = latency_us;
+    if(delivery_us > input_stats.max_delivery_us)
+        input_stats.max_delivery_us = delivery_us;
+    portEXIT_CRITICAL(&input_lock);
+
+    ESP_LOGI(gadget_tag, "input %d %s", payload[0], payload[1] ? "high" : "low");
+}
+
+void gadget_input_get_stats(gadget_input_stats_t *stats)
+{
+    portENTER_CRITICAL(&input_lock);
+    *stats = input_stats;
+    portEXIT_CRITICAL(&input_lock);
+}
+
+/**
+ * @brief upper bound of the latency bucket holding the given percentile
+ *
+ * @param stats
+ * @param percentile 0 - 100
+ * @return uint32_t latency in us, 0 if no event was handled yet
+ */
+uint32_t gadget_input_latency_percentile(const gadget_input_stats_t *stats, uint8_t percentile)
+{
+    uint32_t total = 0;
+    uint32_t target;
+    uint32_t seen = 0;
+
+    for(int b = 0; b < GADGET_INPUT_LATENCY_BUCKETS; b++)
+        total += stats->latency[b];
+    if(total == 0)
+        return 0;
+
+    target = ((uint64_t)total * percentile + 99) / 100;
+    for(int b = 0; b < GADGET_INPUT_LATENCY_BUCKETS; b++)
+    {
+        seen += stats->latency[b];
+        if(seen >= target && seen > 0)
+            return (b == GADGET_INPUT_LATENCY_BUCKETS - 1) ? stats->max_latency_us : (1UL << b);
+    }
+
+    return stats->max_latency_us;
+}
+
+/**
+ * @brief print input levels and capture counters
+ *
+ */
+void gadget_input_log_stats(void)
+{
+    gadget_input_stats_t stats;
+
+    gadget_input_get_stats(&stats);
+    ESP_LOGI(gadget_tag, "inputs 0x%lx: edges %lu, overflows %lu, events %lu, dropped %lu, max dwell %luus",
+             (unsigned long)gadget_input_get_states(), (unsigned long)stats.edges,
+             (unsigned long)stats.overflows, (unsigned long)stats.events,
+             (unsigned long)stats.dropped, (unsigned long)stats.max_dwell_us);
+    ESP_LOGI(gadget_tag, "past debounce to central p50 <%luus p99 <%luus max %luus, settle to central max %luus",
+             (unsigned long)gadget_input_latency_percentile(&stats, 50),
+             (unsigned long)gadget_input_latency_percentile(&stats, 99),
+             (unsigned long)stats.max_latency_us, (unsigned long)stats.max_delivery_us);
+}
+
+#if CONFIG_GADGET_GPIO_MOCK
+/**
+ * @brief drive a mocked input and run the ISR as the hardware would
+ *
+ * @param input
+ * @param level
+ */
+void gadget_input_mock_edge(int input, int level)
+{
+    if(input < 0 || input >= input_count)
+        return;
+
+    if(level)
+        input_mock_levels |= 1ULL << inputs[input].pin;
+    else
+        input_mock_levels &= ~(1ULL << inputs[input].pin);
+    gadget_input_isr((void *)(uintptr_t)input);
+}
+#endif
@@ -0,0 +1,680 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+
+#include "gadget_includes.h"
+#include "gadget_gpio.h"
+#include "gadget_pattern.h"
+
+#if !CONFIG_GADGET_GPIO_MOCK
+#include "driver/ledc.h"
+#endif
+
+const static char *gadget_tag = "gadget_mk1_pattern";
+
+#define GADGET_PATTERN_LEDC_MODE        LEDC_LOW_SPEED_MODE
+#define GADGET_PATTERN_LEDC_TIMER       LEDC_TIMER_0
+#define GADGET_PATTERN_LEDC_FREQ_HZ     5000
+#define GADGET_PATTERN_LEDC_DUTY_MAX    1023    // 10 bit resolution
+
+#define GADGET_PATTERN_LOAD_EDGE_MS     10      // blink half period while the load test runs
+#define GADGET_PATTERN_LOAD_PHASE_MS    5000    // idle phase, then the same under load
+#define GADGET_PATTERN_LOAD_BUSY_US     20000   // burner spin between yields
+#define GADGET_PATTERN_LOAD_PRIORITY    5       // above every gadget task
+
+//edges run straight from the timer ISR where the port allows it
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+#define GADGET_PATTERN_EDGE_DISPATCH    ESP_TIMER_ISR
+#else
+#define GADGET_PATTERN_EDGE_DISPATCH    ESP_TIMER_TASK
+#endif
+
+//per pin table entry, fields shared with the timer callbacks sit under pattern_lock
+typedef struct {
+    gadget_pattern_kind_t kind;
+    bool ledc;                  //pin is routed to its LEDC channel
+    uint8_t count;
+    uint8_t step;
+    uint16_t repeat;            //0 runs until replaced
+    uint16_t left;
+    uint16_t steps[GADGET_PATTERN_MAX_STEPS];
+    int64_t deadline_us;        //when the next edge is due
+    uint16_t ramp_ms;
+    uint16_t peak_duty;
+    uint32_t ramps;
+    esp_timer_handle_t edge_timer;
+    esp_timer_handle_t fade_timer;  //task dispatch, LEDC calls take locks
+} gadget_pattern_chan_t;
+
+static gadget_pattern_chan_t pattern_chans[GADGET_GPIO_MAX_PINS];
+static portMUX_TYPE pattern_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static gadget_pattern_jitter_t pattern_jitter;
+
+static bool pattern_ledc_ready = false;
+
+static bool pattern_load_running = false;
+static volatile bool pattern_load_busy = false;
+static uint32_t pattern_load_burners = 0;
+
+/**
+ * @brief count one edge in the lateness histogram, caller holds pattern_lock
+ *
+ * @param late_us
+ */
+static inline IRAM_ATTR void gadget_pattern_record(uint32_t late_us)
+{
+    uint32_t bucket = 0;
+
+    while(bucket < GADGET_PATTERN_JITTER_BUCKETS - 1 && (late_us >> bucket) != 0)
+        bucket++;
+
+    pattern_jitter.edges++;
+    pattern_jitter.late[bucket]++;
+    pattern_jitter.total_late_us += late_us;
+    if(late_us > pattern_jitter.max_late_us)
+        pattern_jitter.max_late_us = late_us;
+}
+
+/**
+ * @brief edge timer, drives one step of a blink or sequence
+ *
+ * Each edge is scheduled against an absolute deadline so lateness does not
+ * accumulate. An edge that misses its slot entirely re-anchors to now
+ * instead of replaying the backlog.
+ *
+ * @param arg the channel
+ */
+static void IRAM_ATTR gadget_pattern_edge(void *arg)
+{
+    gadget_pattern_chan_t *chan = arg;
+    uint32_t bit = 1UL << (chan - pattern_chans);
+    int64_t now = esp_timer_get_time();
+    int64_t next = 0;
+    uint16_t step;
+
+    portENTER_CRITICAL_SAFE(&pattern_lock);
+    if(chan->kind != gadget_pattern_kind_blink && chan->kind != gadget_pattern_kind_sequence)
+    {
+        portEXIT_CRITICAL_SAFE(&pattern_lock);
+        return;
+    }
+
+    //a stale arm from before a restart, wait for the real deadline
+    if(now < chan->deadline_us)
+        next = chan->deadline_us;
+    else
+    {
+        gadget_pattern_record((uint32_t)(now - chan->deadline_us));
+
+        step = chan->steps[chan->step];
+        if(step & 0x8000)
+            gadget_gpio_apply(bit, 0);
+        else
+            gadget_gpio_apply(0, bit);
+
+        chan->deadline_us += (int64_t)(step & 0x7FFF) * 1000;
+        if(chan->deadline_us < now)
+            chan->deadline_us = now;
+
+        if(++chan->step >= chan->count)
+        {
+            chan->step = 0;
+            if(chan->repeat != 0 && --chan->left == 0)
+                chan->kind = gadget_pattern_kind_off;
+        }
+        if(chan->kind != gadget_pattern_kind_off)
+            next = chan->deadline_us;
+    }
+    portEXIT_CRITICAL_SAFE(&pattern_lock);
+
+    if(next != 0)
+        esp_timer_start_once(chan->edge_timer, next > now ? next - now : 0);
+}
+
+/**
+ * @brief fade timer, starts the next hardware ramp once per ramp period
+ *
+ * @param arg the channel
+ */
+static void gadget_pattern_ramp(void *arg)
+{
+    gadget_pattern_chan_t *chan = arg;
+    uint32_t ramps;
+    bool done;
+
+    portENTER_CRITICAL(&pattern_lock);
+    if(chan->kind != gadget_pattern_kind_fade)
+    {
+        portEXIT_CRITICAL(&pattern_lock);
+        return;
+    }
+    ramps = chan->ramps++;
+    done = chan->repeat != 0 && ramps >= (uint32_t)chan->repeat * 2;
+    if(done)
+        chan->kind = gadget_pattern_kind_off;
+    portEXIT_CRITICAL(&pattern_lock);
+
+    if(done)
+    {
+        esp_timer_stop(chan->fade_timer);
+        return;
+    }
+
+#if !CONFIG_GADGET_GPIO_MOCK
+    //even ramps go up, odd ones back down
+    ledc_set_fade_time_and_start(GADGET_PATTERN_LEDC_MODE, chan - pattern_chans,
+                                 (ramps & 1) ? 0 : chan->peak_duty, chan->ramp_ms, LEDC_FADE_NO_WAIT);
+#endif
+}
+
+/**
+ * @brief channel for a pin table entry
+ *
+ * @param entry
+ * @return gadget_pattern_chan_t* NULL if the entry is not in the table
+ */
+static gadget_pattern_chan_t *gadget_pattern_chan(int entry)
+{
+    if(gadget_gpio_pin(entry) < 0 || entry >= GADGET_GPIO_MAX_PINS)
+        return NULL;
+    return &pattern_chans[entry];
+}
+
+/**
+ * @brief stop whatever runs on a channel and hand the pin back to GPIO
+ *
+ * @param chan
+ */
+static void gadget_pattern_halt(gadget_pattern_chan_t *chan)
+{
+    bool ledc;
+
+    portENTER_CRITICAL(&pattern_lock);
+    chan->kind = gadget_pattern_kind_off;
+    ledc = chan->ledc;
+    chan->ledc = false;
+    portEXIT_CRITICAL(&pattern_lock);
+
+    if(chan->edge_timer != NULL)
+        esp_timer_stop(chan->edge_timer);
+    if(chan->fade_timer != NULL)
+        esp_timer_stop(chan->fade_timer);
+
+#if CONFIG_GADGET_GPIO_MOCK
+    (void)ledc;
+#else
+    if(ledc)
+    {
+        ledc_fade_stop(GADGET_PATTERN_LEDC_MODE, chan - pattern_chans);
+        ledc_stop(GADGET_PATTERN_LEDC_MODE, chan - pattern_chans, 0);
+        gadget_gpio_reclaim(chan - pattern_chans);
+    }
+#endif
+}
+
+/**
+ * @brief create a channel timer on first use
+ *
+ * @param timer
+ * @param cb
+ * @param arg
+ * @param dispatch
+ * @return esp_err_t
+ */
+static esp_err_t gadget_pattern_timer(esp_timer_handle_t *timer, esp_timer_cb_t cb, void *arg,
+                                      esp_timer_dispatch_t dispatch)
+{
+    esp_err_t ret;
+
+    if(*timer != NULL)
+        return ESP_OK;
+
+    const esp_timer_create_args_t args = {
+        .callback = cb,
+        .arg = arg,
+        .dispatch_method = dispatch,
+        .name = "gadget_pattern",
+    };
+    ret = esp_timer_create(&args, timer);
+    if(ret != ESP_OK)
+        ESP_LOGE(gadget_tag, "ERROR creating pattern timer CODE(%s)", esp_err_to_name(ret));
+
+    return ret;
+}
+
+/**
+ * @brief run a custom sequence, the first step starts right away
+ *
+ * @param entry     pin table entry
+ * @param steps     GADGET_PATTERN_STEP values
+ * @param count
+ * @param repeat    times through the sequence, 0 until replaced
+ * @return esp_err_t
+ */
+esp_err_t gadget_pattern_sequence(int entry, const uint16_t *steps, size_t count, uint16_t repeat)
+{
+    gadget_pattern_chan_t *chan = gadget_pattern_chan(entry);
+    esp_err_t ret;
+
+    if(chan == NULL || count == 0 || count > GADGET_PATTERN_MAX_STEPS)
+        return ESP_ERR_INVALID_ARG;
+    for(size_t i = 0; i < count; i++)
+    {
+        if((steps[i] & 0x7FFF) == 0)
+            return ESP_ERR_INVALID_ARG;
+    }
+
+    gadget_pattern_halt(chan);
+    ret = gadget_pattern_timer(&chan->edge_timer, gadget_pattern_edge, chan, GADGET_PATTERN_EDGE_DISPATCH);
+    if(ret != ESP_OK)
+        return ret;
+
+    portENTER_CRITICAL(&pattern_lock);
+    memcpy(chan->steps, steps, count * sizeof(uint16_t));
+    chan->count = count;
+    chan->step = 0;
+    chan->repeat = repeat;
+    chan->left = repeat;
+    chan->deadline_us = esp_timer_get_time();
+    chan->kind = gadget_pattern_kind_sequence;
+    portEXIT_CRITICAL(&pattern_lock);
+
+    /*
+     * An edge callback already running when halt stopped the timer may have
+     * re-armed it with the old deadline. Drop that arm and start over. Only
+     * a callback of the new arm can run after that, and it sees the new
+     * sequence, so an arm found on the retry is a good one.
+     */
+    ret = esp_timer_start_once(chan->edge_timer, 0);
+    if(ret == ESP_ERR_INVALID_STATE)
+    {
+        esp_timer_stop(chan->edge_timer);
+        ret = esp_timer_start_once(chan->edge_timer, 0);
+        if(ret == ESP_ERR_INVALID_STATE)
+            ret = ESP_OK;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief blink, a two step sequence ending low
+ *
+ * @param entry
+ * @param on_ms
+ * @param off_ms
+ * @param repeat    blinks, 0 until replaced
+ * @return esp_err_t
+ */
+esp_err_t gadget_pattern_blink(int entry, uint16_t on_ms, uint16_t off_ms, uint16_t repeat)
+{
+    const uint16_t steps[2] = { GADGET_PATTERN_STEP(1, on_ms), GADGET_PATTERN_STEP(0, off_ms) };
+    esp_err_t ret;
+
+    ret = gadget_pattern_sequence(entry, steps, 2, repeat);
+    if(ret == ESP_OK)
+    {
+        portENTER_CRITICAL(&pattern_lock);
+        pattern_chans[entry].kind = gadget_pattern_kind_blink;
+        portEXIT_CRITICAL(&pattern_lock);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief breathe through the LEDC fader, up then down once per cycle
+ *
+ * The ramps run in hardware, the only software work is one timer callback
+ * per ramp to start the next one. Pin table entries past the LEDC channel
+ * count cannot fade.
+ *
+ * @param entry
+ * @param ramp_ms   one direction
+ * @param peak_pct  duty at the top, 1 - 100
+ * @param repeat    cycles, 0 until replaced
+ * @return esp_err_t
+ */
+esp_err_t gadget_pattern_fade(int entry, uint16_t ramp_ms, uint8_t peak_pct, uint16_t repeat)
+{
+#if CONFIG_GADGET_GPIO_MOCK
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    gadget_pattern_chan_t *chan = gadget_pattern_chan(entry);
+    esp_err_t ret;
+
+    if(chan == NULL || ramp_ms == 0 || peak_pct == 0 || peak_pct > 100)
+        return ESP_ERR_INVALID_ARG;
+    if(entry >= LEDC_CHANNEL_MAX)
+        return ESP_ERR_NOT_SUPPORTED;
+
+    gadget_pattern_halt(chan);
+
+    if(!pattern_ledc_ready)
+    {
+        const ledc_timer_config_t timer_config = {
+            .speed_mode = GADGET_PATTERN_LEDC_MODE,
+            .duty_resolution = LEDC_TIMER_10_BIT,
+            .timer_num = GADGET_PATTERN_LEDC_TIMER,
+            .freq_hz = GADGET_PATTERN_LEDC_FREQ_HZ,
+            .clk_cfg = LEDC_AUTO_CLK,
+        };
+        ret = ledc_timer_config(&timer_config);
+        if(ret == ESP_OK)
+            ret = ledc_fade_func_install(0);
+        if(ret != ESP_OK)
+        {
+            ESP_LOGE(gadget_tag, "ERROR setting up LEDC CODE(%s)", esp_err_to_name(ret));
+            return ret;
+        }
+        pattern_ledc_ready = true;
+    }
+
+    ret = gadget_pattern_timer(&chan->fade_timer, gadget_pattern_ramp, chan, ESP_TIMER_TASK);
+    if(ret != ESP_OK)
+        return ret;
+
+    const ledc_channel_config_t channel_config = {
+        .gpio_num = gadget_gpio_pin(entry),
+        .speed_mode = GADGET_PATTERN_LEDC_MODE,
+        .channel = entry,
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = GADGET_PATTERN_LEDC_TIMER,
+        .duty = 0,
+        .hpoint = 0,
+    };
+    ret = ledc_channel_config(&channel_config);
+    if(ret != ESP_OK)
+    {
+        ESP_LOGE(gadget_tag, "ERROR routing pin %d to LEDC CODE(%s)", channel_config.gpio_num, esp_err_to_name(ret));
+        gadget_gpio_reclaim(entry);
+        return ret;
+    }
+
+    portENTER_CRITICAL(&pattern_lock);
+    chan->ledc = true;
+    chan->ramp_ms = ramp_ms;
+    chan->peak_duty = GADGET_PATTERN_LEDC_DUTY_MAX * peak_pct / 100;
+    chan->repeat = repeat;
+    chan->ramps = 0;
+    chan->kind = gadget_pattern_kind_fade;
+    portEXIT_CRITICAL(&pattern_lock);
+
+    gadget_pattern_ramp(chan);
+    return esp_timer_start_periodic(chan->fade_timer, (uint64_t)ramp_ms * 1000);
+#endif
+}
+
+/**
+ * @brief stop the pattern on a channel, the output is left low
+ *
+ * @param entry
+ * @return esp_err_t
+ */
+esp_err_t gadget_pattern_stop(int entry)
+{
+    gadget_pattern_chan_t *chan = gadget_pattern_chan(entry);
+
+    if(chan == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    gadget_pattern_halt(chan);
+    gadget_gpio_apply(0, 1UL << entry);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief start or stop a pattern from a gadget_msg_pattern, gpio task only
+ *
+ * @param msg
+ */
+void gadget_pattern_handle_msg(const gadget_msg_t *msg)
+{
+    const uint8_t *payload = gadget_msg_payload(msg);
+    size_t len = gadget_msg_payload_len(msg);
+    uint16_t steps[GADGET_PATTERN_MAX_STEPS];
+    size_t count;
+    uint16_t repeat;
+    esp_err_t ret;
+    int entry;
+
+    if(payload == NULL || len < 2)
+    {
+        ESP_LOGW(gadget_tag, "pattern msg without a kind");
+        return;
+    }
+    entry = payload[0];
+    repeat = len >= 4 ? payload[2] | (payload[3] << 8) : 0;
+
+    switch(payload[1])
+    {
+        case gadget_pattern_kind_off:
+            ret = gadget_pattern_stop(entry);
+        break;
+
+        case gadget_pattern_kind_on:
+            ret = gadget_pattern_stop(entry);
+            if(ret == ESP_OK)
+                gadget_gpio_apply(1UL << entry, 0);
+        break;
+
+        case gadget_pattern_kind_blink:
+            ret = len < 8 ? ESP_ERR_INVALID_SIZE :
+                  gadget_pattern_blink(entry, payload[4] | (payload[5] << 8), payload[6] | (payload[7] << 8), repeat);
+        break;
+
+        case gadget_pattern_kind_fade:
+            ret = len < 7 ? ESP_ERR_INVALID_SIZE :
+                  gadget_pattern_fade(entry, payload[4] | (payload[5] << 8), payload[6], repeat);
+        break;
+
+        case gadget_pattern_kind_sequence:
+            count = len > 4 ? (len - 4) / 2 : 0;
+            if(count > GADGET_PATTERN_MAX_STEPS)
+                count = GADGET_PATTERN_MAX_STEPS;
+            for(size_t i = 0; i < count; i++)
+                steps[i] = payload[4 + 2 * i] | (payload[5 + 2 * i] << 8);
+            ret = gadget_pattern_sequence(entry, steps, count, repeat);
+        break;
+
+        default:
+            ret = ESP_ERR_INVALID_ARG;
+        break;
+    }
+
+    if(ret != ESP_OK)
+        ESP_LOGW(gadget_tag, "pattern %d on entry %d refused CODE(%s)", payload[1], entry, esp_err_to_name(ret));
+}
+
+void gadget_pattern_get_jitter(gadget_pattern_jitter_t *jitter)
+{
+    portENTER_CRITICAL(&pattern_lock);
+    *jitter = pattern_jitter;
+    portEXIT_CRITICAL(&pattern_lock);
+}
+
+void gadget_pattern_reset_jitter(void)
+{
+    portENTER_CRITICAL(&pattern_lock);
+    memset(&pattern_jitter, 0, sizeof(pattern_jitter));
+    portEXIT_CRITICAL(&pattern_lock);
+}
+
+/**
+ * @brief upper bound of the lateness bucket holding the given percentile
+ *
+ * @param jitter
+ * @param percentile 0 - 100
+ * @return uint32_t lateness in us, 0 if no edge ran yet
+ */
+uint32_t gadget_pattern_jitter_percentile(const gadget_pattern_jitter_t *jitter, uint8_t percentile)
+{
+    uint32_t target;
+    uint32_t seen = 0;
+
+    if(jitter->edges == 0)
+        return 0;
+
+    target = ((uint64_t)jitter->edges * percentile + 99) / 100;
+    for(int b = 0; b < GADGET_PATTERN_JITTER_BUCKETS; b++)
+    {
+        seen += jitter->late[b];
+        if(seen >= target && seen > 0)
+            return (b == GADGET_PATTERN_JITTER_BUCKETS - 1) ? jitter->max_late_us : (1UL << b);
+    }
+
+    return jitter->max_late_us;
+}
+
+static void gadget_pattern_log_jitter(const char *label, const gadget_pattern_jitter_t *jitter)
+{
+    ESP_LOGI(gadget_tag, "%s edges %lu, late p50 <%luus p99 <%luus max %luus mean %luus", label,
+             (unsigned long)jitter->edges,
+             (unsigned long)gadget_pattern_jitter_percentile(jitter, 50),
+             (unsigned long)gadget_pattern_jitter_percentile(jitter, 99),
+             (unsigned long)jitter->max_late_us,
+             (unsigned long)(jitter->edges ? jitter->total_late_us / jitter->edges : 0));
+}
+
+/**
+ * @brief print running patterns and edge lateness
+ *
+ */
+void gadget_pattern_log_stats(void)
+{
+    static const char *kinds[] = { "off", "on", "blink", "fade", "sequence" };
+    gadget_pattern_jitter_t jitter;
+    gadget_pattern_kind_t kind;
+
+    for(int i = 0; i < GADGET_GPIO_MAX_PINS && gadget_gpio_pin(i) >= 0; i++)
+    {
+        kind = pattern_chans[i].kind;
+        if(kind != gadget_pattern_kind_off)
+            ESP_LOGI(gadget_tag, "entry %d (gpio %d): %s", i, gadget_gpio_pin(i), kinds[kind]);
+    }
+
+    gadget_pattern_get_jitter(&jitter);
+    gadget_pattern_log_jitter("pattern", &jitter);
+}
+
+/**
+ * @brief post a blink or stop on entry 0 through central, like any other sender
+ *
+ * @param half_ms   0 stops
+ */
+static void gadget_pattern_send_blink(uint16_t half_ms)
+{
+    gadget_msg_t msg;
+    uint8_t *payload;
+
+    memset(&msg, 0, sizeof(gadget_msg_t));
+    payload = gadget_msg_alloc_payload(&msg, 8);
+    if(payload == NULL)
+        return;
+
+    memset(payload, 0, 8);
+    payload[1] = half_ms ? gadget_pattern_kind_blink : gadget_pattern_kind_off;
+    payload[4] = payload[6] = half_ms & 0xFF;
+    payload[5] = payload[7] = half_ms >> 8;
+    gadget_send_msg(gadget_central_msg_queue, 0, gadget_prio_high, gadget_main_id, gadget_msg_pattern, &msg);
+}
+
+/**
+ * @brief load test burner, spins and floods the bus with no-op gpio writes
+ *
+ * @param pvParams
+ */
+static void gadget_pattern_burner(void *pvParams)
+{
+    int64_t until;
+
+    while(pattern_load_busy)
+    {
+        until = esp_timer_get_time() + GADGET_PATTERN_LOAD_BUSY_US;
+        while(esp_timer_get_time() < until)
+            gadget_gpio_write(0, 0, gadget_main_id);
+        vTaskDelay(1);
+    }
+
+    __atomic_sub_fetch(&pattern_load_burners, 1, __ATOMIC_RELAXED);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief blink entry 0 idle, then again with every core loaded, and report
+ * the edge lateness of both phases
+ *
+ * @param pvParams
+ */
+static void gadget_pattern_load_task(void *pvParams)
+{
+    gadget_pattern_jitter_t idle;
+    gadget_pattern_jitter_t loaded;
+
+    gadget_pattern_send_blink(GADGET_PATTERN_LOAD_EDGE_MS);
+    vTaskDelay(pdMS_TO_TICKS(100));
+
+    gadget_pattern_reset_jitter();
+    vTaskDelay(pdMS_TO_TICKS(GADGET_PATTERN_LOAD_PHASE_MS));
+    gadget_pattern_get_jitter(&idle);
+
+    pattern_load_busy = true;
+    for(int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        if(xTaskCreatePinnedToCore(gadget_pattern_burner, "gadget_pattern_burn", (ESP32_BIT*64), NULL,
+                                   GADGET_PATTERN_LOAD_PRIORITY, NULL, core) == pdPASS)
+            __atomic_add_fetch(&pattern_load_burners, 1, __ATOMIC_RELAXED);
+    }
+    gadget_pattern_reset_jitter();
+    vTaskDelay(pdMS_TO_TICKS(GADGET_PATTERN_LOAD_PHASE_MS));
+    gadget_pattern_get_jitter(&loaded);
+
+    pattern_load_busy = false;
+    while(__atomic_load_n(&pattern_load_burners, __ATOMIC_RELAXED) != 0)
+        vTaskDelay(1);
+    gadget_pattern_send_blink(0);
+
+    gadget_pattern_log_jitter("idle", &idle);
+    gadget_pattern_log_jitter("loaded", &loaded);
+
+    pattern_load_running = false;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief run the edge jitter load test in the background
+ *
+ * @return true
+ * @return false already running or no memory for the task
+ */
+bool gadget_pattern_load_test(void)
+{
+    if(pattern_load_running)
+    {
+        ESP_LOGW(gadget_tag, "pattern load test already running");
+        return false;
+    }
+
+    ESP_LOGI(gadget_tag, "pattern load test: %d ms blink, %d ms idle then %d ms loaded",
+             GADGET_PATTERN_LOAD_EDGE_MS, GADGET_PATTERN_LOAD_PHASE_MS, GADGET_PATTERN_LOAD_PHASE_MS);
+    pattern_load_running = true;
+    if(xTaskCreate(gadget_pattern_load_task, "gadget_pattern_load", (ESP32_BIT*96), NULL,
+                   GADGET_PATTERN_LOAD_PRIORITY + 1, NULL) != pdPASS)
+    {
+        ESP_LOGE(gadget_tag, "ERROR with creation of pattern load TASK!");
+        pattern_load_running = false;
+        return false;
+    }
+
+    return true;
+}
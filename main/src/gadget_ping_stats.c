@@ -0,0 +1,177 @@
+#include <string.h>
+
+#include "gadget_ping_stats.h"
+
+/**
+ * @brief histogram bucket of an rtt
+ *
+ * @param rtt_ms
+ * @return int
+ */
+static int gadget_ping_bucket(uint32_t rtt_ms)
+{
+    int msb;
+    int idx;
+
+    if(rtt_ms < 4)
+        return rtt_ms;
+
+    msb = 31 - __builtin_clz(rtt_ms);
+    idx = (msb - 1) * 4 + ((rtt_ms >> (msb - 2)) & 3);
+
+    return idx < GADGET_PING_HIST_BUCKETS ? idx : GADGET_PING_HIST_BUCKETS - 1;
+}
+
+/**
+ * @brief largest rtt falling into bucket idx
+ *
+ * @param idx
+ * @return uint32_t
+ */
+static uint32_t gadget_ping_bucket_upper(int idx)
+{
+    int msb;
+
+    if(idx < 4)
+        return idx;
+
+    msb = idx / 4 + 1;
+    return ((uint32_t)(4 + idx % 4) << (msb - 2)) + (1UL << (msb - 2)) - 1;
+}
+
+/**
+ * @brief record the outcome of the newest probe in the loss window
+ *
+ * @param stats
+ * @param lost
+ */
+static void gadget_ping_window_push(gadget_ping_stats_t *stats, bool lost)
+{
+    uint32_t bit = stats->sent % GADGET_PING_WINDOW_BITS;
+
+    if(lost)
+        stats->window[bit / 32] |= 1UL << (bit % 32);
+    else
+        stats->window[bit / 32] &= ~(1UL << (bit % 32));
+    stats->sent++;
+}
+
+/**
+ * @brief losses among the last n probes, in permille of the probes seen
+ *
+ * @param stats
+ * @param n
+ * @return uint16_t
+ */
+static uint16_t gadget_ping_window_loss(const gadget_ping_stats_t *stats, uint32_t n)
+{
+    uint32_t lost = 0;
+    uint32_t bit;
+
+    if(n > stats->sent)
+        n = stats->sent;
+    if(n == 0)
+        return 0;
+
+    for(uint32_t i = 1; i <= n; i++)
+    {
+        bit = (stats->sent - i) % GADGET_PING_WINDOW_BITS;
+        if(stats->window[bit / 32] & (1UL << (bit % 32)))
+            lost++;
+    }
+
+    return (uint16_t)(lost * 1000 / n);
+}
+
+void gadget_ping_stats_reset(gadget_ping_stats_t *stats)
+{
+    memset(stats, 0, sizeof(gadget_ping_stats_t));
+    stats->min_ms = UINT32_MAX;
+}
+
+/**
+ * @brief account one echo reply
+ *
+ * @param stats
+ * @param rtt_ms
+ */
+void gadget_ping_stats_add_reply(gadget_ping_stats_t *stats, uint32_t rtt_ms)
+{
+    uint32_t delta_us;
+
+    if(stats->received > 0)
+    {
+        delta_us = (rtt_ms > stats->last_ms ? rtt_ms - stats->last_ms : stats->last_ms - rtt_ms) * 1000;
+        //J += (|D| - J) / 16
+        if(delta_us > stats->jitter_us)
+            stats->jitter_us += (delta_us - stats->jitter_us) / 16;
+        else
+            stats->jitter_us -= (stats->jitter_us - delta_us) / 16;
+    }
+
+    gadget_ping_window_push(stats, false);
+    stats->received++;
+    stats->last_ms = rtt_ms;
+    stats->sum_ms += rtt_ms;
+    if(rtt_ms < stats->min_ms)
+        stats->min_ms = rtt_ms;
+    if(rtt_ms > stats->max_ms)
+        stats->max_ms = rtt_ms;
+    stats->hist[gadget_ping_bucket(rtt_ms)]++;
+}
+
+void gadget_ping_stats_add_timeout(gadget_ping_stats_t *stats)
+{
+    gadget_ping_window_push(stats, true);
+}
+
+/**
+ * @brief upper bound of the bucket holding the given rtt percentile
+ *
+ * @param stats
+ * @param percentile 0 - 100
+ * @return uint32_t rtt in ms, 0 if no reply was seen yet
+ */
+uint32_t gadget_ping_stats_percentile(const gadget_ping_stats_t *stats, uint8_t percentile)
+{
+    uint32_t target;
+    uint32_t seen = 0;
+
+    if(stats->received == 0)
+        return 0;
+
+    target = ((uint64_t)stats->received * percentile + 99) / 100;
+    if(target == 0)
+        target = 1;
+
+    for(int i = 0; i < GADGET_PING_HIST_BUCKETS; i++)
+    {
+        seen += stats->hist[i];
+        if(seen >= target)
+        {
+            //never report past the largest rtt actually seen
+            return gadget_ping_bucket_upper(i) < stats->max_ms ? gadget_ping_bucket_upper(i) : stats->max_ms;
+        }
+    }
+
+    return stats->max_ms;
+}
+
+void gadget_ping_stats_summarize(const gadget_ping_stats_t *stats, gadget_ping_summary_t *summary)
+{
+    memset(summary, 0, sizeof(gadget_ping_summary_t));
+    summary->sent = stats->sent;
+    summary->received = stats->received;
+    if(stats->received > 0)
+    {
+        summary->min_ms = stats->min_ms;
+        summary->mean_ms = (uint32_t)(stats->sum_ms / stats->received);
+        summary->max_ms = stats->max_ms;
+        summary->p50_ms = gadget_ping_stats_percentile(stats, 50);
+        summary->p95_ms = gadget_ping_stats_percentile(stats, 95);
+        summary->p99_ms = gadget_ping_stats_percentile(stats, 99);
+    }
+    summary->jitter_us = stats->jitter_us;
+    summary->loss_short_permille = gadget_ping_window_loss(stats, GADGET_PING_WINDOW_SHORT);
+    summary->loss_long_permille = gadget_ping_window_loss(stats, GADGET_PING_WINDOW_LONG);
+}
@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "gadget_includes.h"
+#include "gadget_pool.h"
+
+const static char *gadget_tag = "gadget_mk1_pool";
+
+#if CONFIG_GADGET_BUS_POOLED
+
+#define GADGET_POOL_SMALL_SIZE      CONFIG_GADGET_POOL_SMALL_SIZE
+#define GADGET_POOL_SMALL_COUNT     CONFIG_GADGET_POOL_SMALL_COUNT
+#define GADGET_POOL_LARGE_SIZE      CONFIG_GADGET_POOL_LARGE_SIZE
+#define GADGET_POOL_LARGE_COUNT     CONFIG_GADGET_POOL_LARGE_COUNT
+
+//handle = class in the top bit, block index + 1 below it
+#define GADGET_POOL_CLASS_BIT       15
+#define GADGET_POOL_INDEX_MASK      0x7FFF
+
+#define GADGET_POOL_HANDLE(cls, idx)    ((gadget_pool_handle_t)(((cls) << GADGET_POOL_CLASS_BIT) | ((idx) + 1)))
+#define GADGET_POOL_HANDLE_CLASS(h)     ((h) >> GADGET_POOL_CLASS_BIT)
+#define GADGET_POOL_HANDLE_INDEX(h)     (((h) & GADGET_POOL_INDEX_MASK) - 1)
+
+typedef struct {
+    uint8_t *blocks;
+    uint16_t *refs;
+    uint16_t *free_list;
+    uint16_t free_top;
+    gadget_pool_stats_t stats;
+} gadget_pool_t;
+
+static uint8_t small_blocks[GADGET_POOL_SMALL_COUNT][GADGET_POOL_SMALL_SIZE] __attribute__((aligned(4)));
+static uint16_t small_refs[GADGET_POOL_SMALL_COUNT];
+static uint16_t small_free[GADGET_POOL_SMALL_COUNT];
+
+static uint8_t large_blocks[GADGET_POOL_LARGE_COUNT][GADGET_POOL_LARGE_SIZE] __attribute__((aligned(4)));
+static uint16_t large_refs[GADGET_POOL_LARGE_COUNT];
+static uint16_t large_free[GADGET_POOL_LARGE_COUNT];
+
+static gadget_pool_t pools[gadget_pool_class_max] = {
+    [gadget_pool_small] = {
+        .blocks = &small_blocks[0][0],
+        .refs = small_refs,
+        .free_list = small_free,
+        .stats = { .blocks = GADGET_POOL_SMALL_COUNT, .block_size = GADGET_POOL_SMALL_SIZE },
+    },
+    [gadget_pool_large] = {
+        .blocks = &large_blocks[0][0],
+        .refs = large_refs,
+        .free_list = large_free,
+        .stats = { .blocks = GADGET_POOL_LARGE_COUNT, .block_size = GADGET_POOL_LARGE_SIZE },
+    },
+};
+
+//short critical sections only, safe from task and ISR context
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool pool_ready = false;
+
+/**
+ * @brief fill the free lists of every pool class
+ *
+ */
+void gadget_pool_init(void)
+{
+    gadget_pool_t *pool;
+
+    if(pool_ready)
+        return;
+
+    for(int cls = 0; cls < gadget_pool_class_max; cls++)
+    {
+        pool = &pools[cls];
+        for(uint16_t i = 0; i < pool->stats.blocks; i++)
+        {
+            pool->refs[i] = 0;
+            pool->free_list[i] = pool->stats.blocks - 1 - i;
+        }
+        pool->free_top = pool->stats.blocks;
+    }
+    pool_ready = true;
+
+    ESP_LOGI(gadget_tag, "pool ready: %d x %dB, %d x %dB",
+             GADGET_POOL_SMALL_COUNT, GADGET_POOL_SMALL_SIZE,
+             GADGET_POOL_LARGE_COUNT, GADGET_POOL_LARGE_SIZE);
+}
+
+/**
+ * @brief take one block from a pool class
+ *
+ * @param cls
+ * @return gadget_pool_handle_t GADGET_POOL_NONE when the class is exhausted
+ */
+static gadget_pool_handle_t gadget_pool_take(gadget_pool_class_t cls)
+{
+    gadget_pool_t *pool = &pools[cls];
+    gadget_pool_handle_t handle = GADGET_POOL_NONE;
+    uint16_t idx;
+
+    portENTER_CRITICAL_SAFE(&pool_lock);
+    if(pool->free_top > 0)
+    {
+        idx = pool->free_list[--pool->free_top];
+        pool->refs[idx] = 1;
+        pool->stats.allocs++;
+        pool->stats.in_use++;
+        if(pool->stats.in_use > pool->stats.peak)
+            pool->stats.peak = pool->stats.in_use;
+        handle = GADGET_POOL_HANDLE(cls, idx);
+    }
+    else
+        pool->stats.exhausted++;
+    portEXIT_CRITICAL_SAFE(&pool_lock);
+
+    return handle;
+}
+
+/**
+ * @brief allocate a block able to hold len bytes
+ *
+ * Falls back to the large class when the small class is exhausted.
+ *
+ * @param len
+ * @return gadget_pool_handle_t GADGET_POOL_NONE on failure
+ */
+gadget_pool_handle_t gadget_pool_alloc(size_t len)
+{
+    gadget_pool_handle_t handle = GADGET_POOL_NONE;
+
+    if(len <= GADGET_POOL_SMALL_SIZE)
+        handle = gadget_pool_take(gadget_pool_small);
+    if(handle == GADGET_POOL_NONE && len <= GADGET_POOL_LARGE_SIZE)
+        handle = gadget_pool_take(gadget_pool_large);
+
+    return handle;
+}
+
+/**
+ * @brief block data pointer of handle
+ *
+ * @param handle
+ * @return void* NULL if handle is empty
+ */
+void *gadget_pool_data(gadget_pool_handle_t handle)
+{
+    gadget_pool_t *pool;
+
+    if(handle == GADGET_POOL_NONE)
+        return NULL;
+
+    pool = &pools[GADGET_POOL_HANDLE_CLASS(handle)];
+    return pool->blocks + ((size_t)GADGET_POOL_HANDLE_INDEX(handle) * pool->stats.block_size);
+}
+
+size_t gadget_pool_block_size(gadget_pool_handle_t handle)
+{
+    if(handle == GADGET_POOL_NONE)
+        return 0;
+
+    return pools[GADGET_POOL_HANDLE_CLASS(handle)].stats.block_size;
+}
+
+/**
+ * @brief add a reference, for fanning one payload out to several owners
+ *
+ * Wrapping the count would hand a live block back to the pool, so that
+ * aborts instead.
+ *
+ * @param handle
+ */
+void gadget_pool_retain(gadget_pool_handle_t handle)
+{
+    uint16_t refs;
+
+    if(handle == GADGET_POOL_NONE)
+        return;
+
+    refs = __atomic_add_fetch(&pools[GADGET_POOL_HANDLE_CLASS(handle)].refs[GADGET_POOL_HANDLE_INDEX(handle)],
+                              1, __ATOMIC_RELAXED);
+    configASSERT(refs != 0);
+}
+
+/**
+ * @brief drop a reference, the block returns to its pool on the last one
+ *
+ * @param handle
+ */
+void gadget_pool_release(gadget_pool_handle_t handle)
+{
+    gadget_pool_t *pool;
+    uint16_t idx;
+
+    if(handle == GADGET_POOL_NONE)
+        return;
+
+    pool = &pools[GADGET_POOL_HANDLE_CLASS(handle)];
+    idx = GADGET_POOL_HANDLE_INDEX(handle);
+
+    if(__atomic_sub_fetch(&pool->refs[idx], 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+
+    portENTER_CRITICAL_SAFE(&pool_lock);
+    pool->free_list[pool->free_top++] = idx;
+    pool->stats.frees++;
+    pool->stats.in_use--;
+    portEXIT_CRITICAL_SAFE(&pool_lock);
+}
+
+void gadget_pool_get_stats(gadget_pool_class_t pool_class, gadget_pool_stats_t *stats)
+{
+    if(pool_class >= gadget_pool_class_max || stats == NULL)
+        return;
+
+    portENTER_CRITICAL_SAFE(&pool_lock);
+    *stats = pools[pool_class].stats;
+    portEXIT_CRITICAL_SAFE(&pool_lock);
+}
+
+/**
+ * @brief print usage and exhaustion counters of every pool class
+ *
+ */
+void gadget_pool_log_stats(void)
+{
+    gadget_pool_stats_t stats;
+    static const char *names[gadget_pool_class_max] = { "small", "large" };
+
+    for(int cls = 0; cls < gadget_pool_class_max; cls++)
+    {
+        gadget_pool_get_stats(cls, &stats);
+        ESP_LOGI(gadget_tag, "%s(%dB): in use %d/%d, peak %d, allocs %lu, frees %lu, exhausted %lu",
+                 names[cls], stats.block_size, stats.in_use, stats.blocks, stats.peak,
+                 (unsigned long)stats.allocs, (unsigned long)stats.frees, (unsigned long)stats.exhausted);
+    }
+}
+
+#else
+
+void gadget_pool_init(void)
+{
+}
+
+void gadget_pool_log_stats(void)
+{
+    ESP_LOGI(gadget_tag, "payload pool disabled, enable GADGET_BUS_POOLED");
+}
+
+#endif
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_freertos_hooks.h"
+#endif
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
+
+#include "gadget_includes.h"
+#include "gadget_power.h"
+#include "gadget_task.h"
+
+const static char *gadget_tag = "gadget_mk1_power";
+
+#if CONFIG_GADGET_POWER_LIGHT_SLEEP
+#define GADGET_POWER_MODE_NAME      "light sleep"
+#elif CONFIG_GADGET_POWER_DFS
+#define GADGET_POWER_MODE_NAME      "dynamic frequency"
+#else
+#define GADGET_POWER_MODE_NAME      "always on"
+#endif
+
+//idle residency needs the run time counter to be esp_timer microseconds
+#define GADGET_POWER_RUNTIME        (CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_RUN_TIME_STATS_USING_ESP_TIMER)
+
+/*
+ * Each core's idle task runs its hook once per pass of the idle loop, and
+ * it only loops again after an interrupt woke the core from waiti or light
+ * sleep and the scheduler came back to idle. Counting passes therefore
+ * counts wakeups without touching the wake path. The report is taken
+ * between two reads rather than on a timer, which would itself wake the
+ * CPU it is measuring.
+ */
+
+static volatile uint32_t power_wakeups[GADGET_POWER_CORES];
+
+static int64_t power_last_us = 0;
+static uint32_t power_last_wakeups[GADGET_POWER_CORES];
+#if GADGET_POWER_RUNTIME
+static uint32_t power_last_idle_us[GADGET_POWER_CORES];
+#endif
+static portMUX_TYPE power_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if !CONFIG_IDF_TARGET_LINUX
+static bool IRAM_ATTR gadget_power_idle_hook(void)
+{
+    power_wakeups[xPortGetCoreID()]++;
+    //let the core wait for the next interrupt
+    return true;
+}
+#endif
+
+#if GADGET_POWER_RUNTIME
+static uint32_t gadget_power_idle_us(int core)
+{
+    return (uint32_t)ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+}
+#endif
+
+/**
+ * @brief apply the power management mode and start counting wakeups
+ *
+ * Dynamic frequency drops the CPU to the crystal clock when no task holds
+ * a lock; light sleep adds automatic light sleep from tickless idle.
+ *
+ * @return esp_err_t
+ */
+esp_err_t gadget_power_init(void)
+{
+    esp_err_t ret = ESP_OK;
+
+#if CONFIG_GADGET_POWER_DFS || CONFIG_GADGET_POWER_LIGHT_SLEEP
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+        .light_sleep_enable = gadget_power_light_sleep(),
+    };
+
+    ret = esp_pm_configure(&pm_config);
+    if(ret != ESP_OK)
+    {
+        ESP_LOGE(gadget_tag, "ERROR esp_pm_configure CODE(%s)", esp_err_to_name(ret));
+        return ret;
+    }
+#endif
+
+    //the POSIX port has no idle hooks, wakeups stay at 0 on the host
+#if !CONFIG_IDF_TARGET_LINUX
+    for(int core = 0; core < GADGET_POWER_CORES; core++)
+    {
+        ret = esp_register_freertos_idle_hook_for_cpu(gadget_power_idle_hook, core);
+        if(ret != ESP_OK)
+        {
+            ESP_LOGE(gadget_tag, "ERROR idle hook on core %d CODE(%s)", core, esp_err_to_name(ret));
+            return ret;
+        }
+    }
+#endif
+
+    //first window starts here
+    gadget_power_sample(NULL);
+    ESP_LOGI(gadget_tag, "power mode %s", GADGET_POWER_MODE_NAME);
+
+    return ret;
+}
+
+bool gadget_power_light_sleep(void)
+{
+#if CONFIG_GADGET_POWER_LIGHT_SLEEP
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief close the current report window and start the next one
+ *
+ * @param report NULL to only restart the window
+ */
+void gadget_power_sample(gadget_power_report_t *report)
+{
+    int64_t now_us = esp_timer_get_time();
+    uint32_t wakeups[GADGET_POWER_CORES];
+#if GADGET_POWER_RUNTIME
+    uint32_t idle_us[GADGET_POWER_CORES];
+#endif
+
+    for(int core = 0; core < GADGET_POWER_CORES; core++)
+    {
+        wakeups[core] = power_wakeups[core];
+#if GADGET_POWER_RUNTIME
+        idle_us[core] = gadget_power_idle_us(core);
+#endif
+    }
+
+    portENTER_CRITICAL(&power_lock);
+    if(report != NULL)
+    {
+        report->window_ms = (uint32_t)((now_us - power_last_us) / 1000);
+        for(int core = 0; core < GADGET_POWER_CORES; core++)
+        {
+            report->wakeups[core] = wakeups[core] - power_last_wakeups[core];
+#if GADGET_POWER_RUNTIME
+            report->idle_permille[core] = now_us > power_last_us ?
+                (uint16_t)((uint64_t)(idle_us[core] - power_last_idle_us[core]) * 1000 / (uint64_t)(now_us - power_last_us)) : 0;
+#else
+            report->idle_permille[core] = 0xFFFF;
+#endif
+        }
+    }
+
+    memcpy(power_last_wakeups, wakeups, sizeof(wakeups));
+#if GADGET_POWER_RUNTIME
+    memcpy(power_last_idle_us, idle_us, sizeof(idle_us));
+#endif
+    power_last_us = now_us;
+    portEXIT_CRITICAL(&power_lock);
+}
+
+/**
+ * @brief running wakeup count of each core, for callers keeping their own deltas
+ *
+ * @param wakeups GADGET_POWER_CORES entries
+ */
+void gadget_power_get_wakeups(uint32_t *wakeups)
+{
+    for(int core = 0; core < GADGET_POWER_CORES; core++)
+        wakeups[core] = power_wakeups[core];
+}
+
+/**
+ * @brief print wakeups per second and idle residency since the last call
+ *
+ */
+void gadget_power_log_stats(void)
+{
+    gadget_power_report_t report;
+    uint32_t window_ms;
+
+    gadget_power_sample(&report);
+    window_ms = report.window_ms > 0 ? report.window_ms : 1;
+
+    ESP_LOGI(gadget_tag, "power mode %s, last %lu.%lu s",
+             GADGET_POWER_MODE_NAME, (unsigned long)(report.window_ms / 1000), (unsigned long)(report.window_ms % 1000 / 100));
+    for(int core = 0; core < GADGET_POWER_CORES; core++)
+    {
+        uint32_t rate_x10 = (uint32_t)((uint64_t)report.wakeups[core] * 10000 / window_ms);
+
+        if(report.idle_permille[core] == 0xFFFF)
+            ESP_LOGI(gadget_tag, "core %d: %lu.%lu wakeups/s, idle n/a (enable FreeRTOS run time stats)",
+                     core, (unsigned long)(rate_x10 / 10), (unsigned long)(rate_x10 % 10));
+        else
+            ESP_LOGI(gadget_tag, "core %d: %lu.%lu wakeups/s, idle %u.%u%%",
+                     core, (unsigned long)(rate_x10 / 10), (unsigned long)(rate_x10 % 10),
+                     report.idle_permille[core] / 10, report.idle_permille[core] % 10);
+    }
+
+#if CONFIG_PM_PROFILING
+    //time spent in each pm mode, light sleep included
+    esp_pm_dump_locks(stdout);
+#endif
+}
@@ -0,0 +1,649 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "gadget_includes.h"
+#include "gadget_ping_stats.h"
+#include "gadget_probe.h"
+#include "gadget_dns.h"
+#include "gadget_task.h"
+
+const static char *gadget_tag = "gadget_mk1_probe";
+
+#define GADGET_PROBE_MAX_TARGETS    CONFIG_GADGET_PROBE_MAX_TARGETS
+#define GADGET_PROBE_RESULTS        CONFIG_GADGET_PROBE_RESULTS
+#define GADGET_PROBE_SPACING_MS     CONFIG_GADGET_PROBE_SPACING_MS
+#define GADGET_PROBE_TIMEOUT_MS     CONFIG_GADGET_PROBE_TIMEOUT_MS
+#define GADGET_PROBE_TARGETS        CONFIG_GADGET_PROBE_TARGETS
+
+#define GADGET_PROBE_POLL_MS        200     // longest select, bounds stop and add latency
+#define GADGET_PROBE_ICMP_SIZE      16      // echo header + 8 bytes of payload
+#define GADGET_PROBE_ICMP_ID        0x6a00  // | target index
+
+//unprivileged ping sockets on the host, the kernel owns the echo id there
+#if CONFIG_IDF_TARGET_LINUX
+#define GADGET_PROBE_ICMP_SOCK      SOCK_DGRAM
+#define GADGET_PROBE_MATCH_ID       0
+#else
+#define GADGET_PROBE_ICMP_SOCK      SOCK_RAW
+#define GADGET_PROBE_MATCH_ID       1
+#endif
+
+typedef enum {
+    gadget_probe_slot_free,
+    gadget_probe_slot_active,
+    gadget_probe_slot_removing,
+} gadget_probe_slot_t;
+
+typedef struct {
+    //set by the api, guarded by probe_lock
+    gadget_probe_slot_t state;
+    bool fresh;                 // not yet picked up by the probe task
+    gadget_probe_kind_t kind;
+    char host[GADGET_PROBE_HOST_LEN];
+    uint16_t port;
+    uint32_t interval_ms;
+    gadget_ping_stats_t stats;
+
+    //only touched from the probe task
+    struct sockaddr_in addr;
+    int fd;                     // in flight probe, -1 if idle
+    int64_t sent_us;
+    uint32_t sent_ms;
+    uint32_t deadline_ms;
+    uint32_t next_due_ms;
+    uint16_t seq;
+} gadget_probe_target_t;
+
+static gadget_probe_target_t probe_targets[GADGET_PROBE_MAX_TARGETS];
+
+//bounded store of the latest outcomes of every target
+static gadget_probe_result_t probe_results[GADGET_PROBE_RESULTS];
+static uint32_t probe_results_head = 0;     // total results ever stored
+
+static portMUX_TYPE probe_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static TaskHandle_t probe_task = NULL;     // created on the first start, parked while stopped
+static volatile bool probe_run = false;
+static bool probe_defaults_loaded = false;
+
+static inline uint32_t gadget_probe_now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+//wrap safe a >= b
+static inline bool gadget_probe_reached(uint32_t now, uint32_t when)
+{
+    return (int32_t)(now - when) >= 0;
+}
+
+/**
+ * @brief store one outcome and fold it into the target's statistics
+ *
+ * @param idx
+ * @param ok
+ * @param rtt_ms
+ */
+static void gadget_probe_record(int idx, bool ok, uint32_t rtt_ms)
+{
+    gadget_probe_target_t *target = &probe_targets[idx];
+    gadget_probe_result_t *result;
+
+    portENTER_CRITICAL(&probe_lock);
+    if(ok)
+        gadget_ping_stats_add_reply(&target->stats, rtt_ms);
+    else
+        gadget_ping_stats_add_timeout(&target->stats);
+
+    result = &probe_results[probe_results_head % GADGET_PROBE_RESULTS];
+    result->stamp_ms = target->sent_ms;
+    result->rtt_ms = rtt_ms > UINT16_MAX ? UINT16_MAX : rtt_ms;
+    result->target = idx;
+    result->ok = ok;
+    probe_results_head++;
+    portEXIT_CRITICAL(&probe_lock);
+}
+
+static void gadget_probe_finish(int idx, bool ok)
+{
+    gadget_probe_target_t *target = &probe_targets[idx];
+    uint32_t rtt_ms = (uint32_t)((esp_timer_get_time() - target->sent_us) / 1000);
+
+    close(target->fd);
+    target->fd = -1;
+    gadget_probe_record(idx, ok, ok ? rtt_ms : 0);
+}
+
+static uint16_t gadget_probe_checksum(const uint8_t *buf, size_t len)
+{
+    uint32_t sum = 0;
+
+    for(size_t i = 0; i + 1 < len; i += 2)
+        sum += (buf[i] << 8) | buf[i + 1];
+    if(len & 1)
+        sum += buf[len - 1] << 8;
+    while(sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return ~sum;
+}
+
+/**
+ * @brief put one probe of target idx on the wire without blocking
+ *
+ * @param idx
+ * @param now
+ */
+static void gadget_probe_launch(int idx, uint32_t now)
+{
+    gadget_probe_target_t *target = &probe_targets[idx];
+    uint8_t pkt[GADGET_PROBE_ICMP_SIZE];
+    uint16_t cks;
+    int fd;
+    int ret;
+
+    //the cache answers at once while warm, a cold host is skipped until it resolves
+    if(gadget_dns_lookup(target->host, &target->addr.sin_addr, NULL, NULL) != ESP_OK)
+        return;
+    target->addr.sin_family = AF_INET;
+    target->addr.sin_port = htons(target->kind == gadget_probe_tcp ? target->port : 0);
+    target->sent_ms = now;
+
+    fd = socket(AF_INET, target->kind == gadget_probe_tcp ? SOCK_STREAM : GADGET_PROBE_ICMP_SOCK,
+                target->kind == gadget_probe_tcp ? 0 : IPPROTO_ICMP);
+    if(fd < 0)
+    {
+        ESP_LOGE(gadget_tag, "ERROR probe socket for %s failed errno %d", target->host, errno);
+        gadget_probe_record(idx, false, 0);
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    target->fd = fd;
+    target->seq++;
+    target->sent_us = esp_timer_get_time();
+    target->deadline_ms = now + GADGET_PROBE_TIMEOUT_MS;
+
+    if(target->kind == gadget_probe_tcp)
+    {
+        ret = connect(fd, (struct sockaddr *)&target->addr, sizeof(target->addr));
+        if(ret == 0)
+            gadget_probe_finish(idx, true);
+        else if(errno != EINPROGRESS)
+            gadget_probe_finish(idx, false);
+        return;
+    }
+
+    memset(pkt, 0, sizeof(pkt));
+    pkt[0] = 8;     //echo request
+    pkt[4] = (GADGET_PROBE_ICMP_ID | idx) >> 8;
+    pkt[5] = (GADGET_PROBE_ICMP_ID | idx) & 0xFF;
+    pkt[6] = target->seq >> 8;
+    pkt[7] = target->seq & 0xFF;
+    cks = gadget_probe_checksum(pkt, sizeof(pkt));
+    pkt[2] = cks >> 8;
+    pkt[3] = cks & 0xFF;
+
+    if(sendto(fd, pkt, sizeof(pkt), 0, (struct sockaddr *)&target->addr, sizeof(target->addr)) < 0)
+        gadget_probe_finish(idx, false);
+}
+
+/**
+ * @brief a probe socket became ready
+ *
+ * @param idx
+ */
+static void gadget_probe_ready(int idx)
+{
+    gadget_probe_target_t *target = &probe_targets[idx];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    uint8_t buf[64];
+    size_t off;
+    int err = 0;
+    socklen_t err_len = sizeof(err);
+    int len;
+
+    if(target->kind == gadget_probe_tcp)
+    {
+        getsockopt(target->fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+        gadget_probe_finish(idx, err == 0);
+        return;
+    }
+
+    //raw sockets see every icmp packet, keep waiting until ours arrives
+    while((len = recvfrom(target->fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len)) > 0)
+    {
+        off = ((buf[0] >> 4) == 4) ? (buf[0] & 0x0F) * 4 : 0;
+        if((size_t)len < off + 8 || buf[off] != 0 || from.sin_addr.s_addr != target->addr.sin_addr.s_addr)
+            continue;
+        if(((buf[off + 6] << 8) | buf[off + 7]) != target->seq)
+            continue;
+        if(GADGET_PROBE_MATCH_ID && ((buf[off + 4] << 8) | buf[off + 5]) != (GADGET_PROBE_ICMP_ID | idx))
+            continue;
+
+        gadget_probe_finish(idx, true);
+        return;
+    }
+}
+
+/**
+ * @brief pick up added and removed targets
+ *
+ * New targets are staggered GADGET_PROBE_SPACING_MS apart so they do not
+ * all fire at once.
+ *
+ * @param now
+ */
+static void gadget_probe_sync(uint32_t now)
+{
+    gadget_probe_target_t *target;
+    uint32_t stagger = now;
+    int stale_fd;
+
+    for(int i = 0; i < GADGET_PROBE_MAX_TARGETS; i++)
+    {
+        target = &probe_targets[i];
+        stale_fd = -1;
+
+        portENTER_CRITICAL(&probe_lock);
+        if(target->state == gadget_probe_slot_removing)
+        {
+            stale_fd = target->fd;
+            target->fd = -1;
+            target->state = gadget_probe_slot_free;
+        }
+        else if(target->state == gadget_probe_slot_active && target->fresh)
+        {
+            target->fresh = false;
+            target->fd = -1;
+            target->next_due_ms = stagger;
+            stagger += GADGET_PROBE_SPACING_MS;
+        }
+        portEXIT_CRITICAL(&probe_lock);
+
+        if(stale_fd >= 0)
+            close(stale_fd);
+    }
+}
+
+/**
+ * @brief probe scheduler task
+ *
+ * Every target keeps at most one probe in flight and all of them are
+ * multiplexed on one select, so slow targets never hold up the others.
+ * Launches are spaced at least GADGET_PROBE_SPACING_MS apart. A stop closes
+ * the sockets and parks the task on its notification until the next start,
+ * a start that comes in while it is winding down keeps it running.
+ *
+ * @param pvParams
+ */
+static void gadget_probe_task(void *pvParams)
+{
+    gadget_probe_target_t *target;
+    uint32_t now;
+    uint32_t next_launch_ms;
+    uint32_t wake;
+    uint32_t when;
+    int due;
+    int max_fd;
+    fd_set rd;
+    fd_set wr;
+    struct timeval tv;
+
+    ESP_LOGI(gadget_tag, "Launching gadget probe task");
+
+    while(1)
+    {
+        while(!probe_run)
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        //restart every target's schedule, staggered again
+        portENTER_CRITICAL(&probe_lock);
+        for(int i = 0; i < GADGET_PROBE_MAX_TARGETS; i++)
+        {
+            probe_targets[i].fd = -1;
+            probe_targets[i].fresh = true;
+        }
+        portEXIT_CRITICAL(&probe_lock);
+        next_launch_ms = gadget_probe_now_ms();
+
+        while(probe_run)
+        {
+            now = gadget_probe_now_ms();
+            gadget_probe_sync(now);
+
+            //expire probes past their deadline
+            for(int i = 0; i < GADGET_PROBE_MAX_TARGETS; i++)
+            {
+                target = &probe_targets[i];
+                if(target->state == gadget_probe_slot_active && target->fd >= 0 &&
+                   gadget_probe_reached(now, target->deadline_ms))
+                    gadget_probe_finish(i, false);
+            }
+
+            //launch the most overdue idle target, one per spacing slot
+            if(gadget_probe_reached(now, next_launch_ms))
+            {
+                due = -1;
+                for(int i = 0; i < GADGET_PROBE_MAX_TARGETS; i++)
+                {
+                    target = &probe_targets[i];
+                    if(target->state != gadget_probe_slot_active || target->fd >= 0 ||
+                       !gadget_probe_reached(now, target->next_due_ms))
+                        continue;
+                    if(due < 0 || (int32_t)(target->next_due_ms - probe_targets[due].next_due_ms) < 0)
+                        due = i;
+                }
+                if(due >= 0)
+                {
+                    target = &probe_targets[due];
+                    //a target that fell behind restarts its period rather than bursting to catch up
+                    target->next_due_ms += target->interval_ms;
+                    if(gadget_probe_reached(now, target->next_due_ms))
+                        target->next_due_ms = now + target->interval_ms;
+                    next_launch_ms = now + GADGET_PROBE_SPACING_MS;
+                    gadget_probe_launch(due, now);
+                }
+            }
+
+            //sleep until the next deadline, due probe or poll interval
+            wake = now + GADGET_PROBE_POLL_MS;
+            FD_ZERO(&rd);
+            FD_ZERO(&wr);
+            max_fd = -1;
+            for(int i = 0; i < GADGET_PROBE_MAX_TARGETS; i++)
+            {
+                target = &probe_targets[i];
+                if(target->state != gadget_probe_slot_active)
+                    continue;
+                if(target->fd >= 0)
+                {
+                    FD_SET(target->fd, target->kind == gadget_probe_tcp ? &wr : &rd);
+                    if(target->fd > max_fd)
+                        max_fd = target->fd;
+                    if((int32_t)(target->deadline_ms - wake) < 0)
+                        wake = target->deadline_ms;
+                }
+                else
+                {
+                    when = gadget_probe_reached(target->next_due_ms, next_launch_ms) ? target->next_due_ms : next_launch_ms;
+                    if((int32_t)(when - wake) < 0)
+                        wake = when;
+                }
+            }
+            wake = gadget_probe_reached(now, wake) ? 0 : wake - now;
+
+            if(max_fd < 0)
+            {
+                vTaskDelay(pdMS_TO_TICKS(wake) > 0 ? pdMS_TO_TICKS(wake) : 1);
+                continue;
+            }
+
+            tv.tv_sec = wake / 1000;
+            tv.tv_usec = (wake % 1000) * 1000;
+            if(select(max_fd + 1, &rd, &wr, NULL, &tv) <= 0)
+                continue;
+
+            for(int i = 0; i < GADGET_PROBE_MAX_TARGETS; i++)
+            {
+                target = &probe_targets[i];
+                if(target->fd >= 0 && (FD_ISSET(target->fd, &rd) || FD_ISSET(target->fd, &wr)))
+                    gadget_probe_ready(i);
+            }
+        }
+
+        for(int i = 0; i < GADGET_PROBE_MAX_TARGETS; i++)
+        {
+            if(probe_targets[i].fd >= 0)
+                close(probe_targets[i].fd);
+            probe_targets[i].fd = -1;
+        }
+        ESP_LOGI(gadget_tag, "probe scheduler stopped");
+    }
+}
+
+GADGET_TASK_STATIC(probe_task_def, "gadget_probe_task", gadget_probe_task,
+                   CONFIG_GADGET_PROBE_TASK_STACK, CONFIG_GADGET_PROBE_TASK_PRIORITY, CONFIG_GADGET_PROBE_TASK_CORE);
+
+/**
+ * @brief add a probe target
+ *
+ * @param host          name or dotted address
+ * @param kind
+ * @param port          tcp port, ignored for icmp
+ * @param interval_ms
+ * @return int target index, -1 if the table is full
+ */
+int gadget_probe_add(const char *host, gadget_probe_kind_t kind, uint16_t port, uint32_t interval_ms)
+{
+    gadget_probe_target_t *target;
+    int idx = -1;
+
+    portENTER_CRITICAL(&probe_lock);
+    for(int i = 0; i < GADGET_PROBE_MAX_TARGETS; i++)
+    {
+        target = &probe_targets[i];
+        if(target->state != gadget_probe_slot_free)
+            continue;
+
+        strncpy(target->host, host, GADGET_PROBE_HOST_LEN - 1);
+        target->host[GADGET_PROBE_HOST_LEN - 1] = '\0';
+        target->kind = kind;
+        target->port = port;
+        target->interval_ms = interval_ms > GADGET_PROBE_SPACING_MS ? interval_ms : GADGET_PROBE_SPACING_MS;
+        gadget_ping_stats_reset(&target->stats);
+        target->fresh = true;
+        target->state = gadget_probe_slot_active;
+        idx = i;
+        break;
+    }
+    portEXIT_CRITICAL(&probe_lock);
+
+    if(idx < 0)
+        ESP_LOGW(gadget_tag, "probe table full, %s not added", host);
+
+    return idx;
+}
+
+/**
+ * @brief remove a probe target, takes effect on the next scheduler pass
+ *
+ * @param target
+ * @return true
+ * @return false no such target
+ */
+bool gadget_probe_remove(int target)
+{
+    bool removed = false;
+
+    if(target < 0 || target >= GADGET_PROBE_MAX_TARGETS)
+        return false;
+
+    portENTER_CRITICAL(&probe_lock);
+    if(probe_targets[target].state == gadget_probe_slot_active)
+    {
+        //never picked up by the task, nothing to clean up
+        probe_targets[target].state = probe_targets[target].fresh ? gadget_probe_slot_free : gadget_probe_slot_removing;
+        removed = true;
+    }
+    portEXIT_CRITICAL(&probe_lock);
+
+    return removed;
+}
+
+/**
+ * @brief add the targets listed in Kconfig
+ *
+ * Entries are "kind,host,port,interval_ms" separated by ';', kind is icmp
+ * or tcp.
+ *
+ */
+static void gadget_probe_load_defaults(void)
+{
+    char list[] = GADGET_PROBE_TARGETS;
+    char kind[8];
+    char host[GADGET_PROBE_HOST_LEN];
+    unsigned short port;
+    unsigned long interval_ms;
+    char *save = NULL;
+
+    for(char *entry = strtok_r(list, ";", &save); entry != NULL; entry = strtok_r(NULL, ";", &save))
+    {
+        //field widths follow kind[] and GADGET_PROBE_HOST_LEN
+        if(sscanf(entry, " %7[^,],%63[^,],%hu,%lu", kind, host, &port, &interval_ms) != 4)
+        {
+            ESP_LOGW(gadget_tag, "ignoring probe target \"%s\"", entry);
+            continue;
+        }
+        gadget_probe_add(host, strcmp(kind, "tcp") == 0 ? gadget_probe_tcp : gadget_probe_icmp, port, interval_ms);
+    }
+}
+
+/**
+ * @brief start the probe scheduler
+ *
+ * The Kconfig target list is loaded on the first start, targets added
+ * through gadget_probe_add are kept across stop / start.
+ *
+ * @return true
+ * @return false
+ */
+bool gadget_probe_start(void)
+{
+    if(!probe_defaults_loaded)
+    {
+        gadget_probe_load_defaults();
+        probe_defaults_loaded = true;
+    }
+
+    //a task still stopping sees probe_run again and carries on
+    probe_run = true;
+    if(probe_task != NULL)
+    {
+        xTaskNotifyGive(probe_task);
+        return true;
+    }
+
+    //only comms starts probes, so there is no second creator to race with
+    probe_task = gadget_task_start(&probe_task_def, NULL);
+    if(probe_task == NULL)
+    {
+        probe_run = false;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief stop the scheduler, the task parks within GADGET_PROBE_POLL_MS
+ *
+ */
+void gadget_probe_stop(void)
+{
+    probe_run = false;
+}
+
+bool gadget_probe_running(void)
+{
+    return probe_run;
+}
+
+/**
+ * @brief copy out the latest results, newest first
+ *
+ * @param results
+ * @param max_results
+ * @return size_t results copied
+ */
+size_t gadget_probe_get_results(gadget_probe_result_t *results, size_t max_results)
+{
+    size_t count;
+
+    portENTER_CRITICAL(&probe_lock);
+    count = probe_results_head < GADGET_PROBE_RESULTS ? probe_results_head : GADGET_PROBE_RESULTS;
+    if(count > max_results)
+        count = max_results;
+    for(size_t i = 0; i < count; i++)
+        results[i] = probe_results[(probe_results_head - 1 - i) % GADGET_PROBE_RESULTS];
+    portEXIT_CRITICAL(&probe_lock);
+
+    return count;
+}
+
+/**
+ * @brief rtt, jitter and loss summary of one target
+ *
+ * @param target
+ * @param summary
+ * @return true
+ * @return false no such target
+ */
+bool gadget_probe_get_summary(int target, gadget_ping_summary_t *summary)
+{
+    gadget_ping_stats_t stats;
+    bool found = false;
+
+    if(target < 0 || target >= GADGET_PROBE_MAX_TARGETS)
+        return false;
+
+    portENTER_CRITICAL(&probe_lock);
+    if(probe_targets[target].state == gadget_probe_slot_active)
+    {
+        stats = probe_targets[target].stats;
+        found = true;
+    }
+    portEXIT_CRITICAL(&probe_lock);
+
+    if(found)
+        gadget_ping_stats_summarize(&stats, summary);
+
+    return found;
+}
+
+/**
+ * @brief print a summary line per target
+ *
+ */
+void gadget_probe_log_stats(void)
+{
+    gadget_ping_summary_t summary;
+    gadget_probe_kind_t kind;
+    char host[GADGET_PROBE_HOST_LEN];
+    uint16_t port;
+
+    ESP_LOGI(gadget_tag, "probe scheduler %s", probe_run ? "running" : "stopped");
+    for(int i = 0; i < GADGET_PROBE_MAX_TARGETS; i++)
+    {
+        portENTER_CRITICAL(&probe_lock);
+        kind = probe_targets[i].kind;
+        port = probe_targets[i].port;
+        memcpy(host, probe_targets[i].host, sizeof(host));
+        portEXIT_CRITICAL(&probe_lock);
+
+        if(!gadget_probe_get_summary(i, &summary))
+            continue;
+        ESP_LOGI(gadget_tag, "[%d] %s %s:%u: sent %lu, recv %lu, rtt min/mean/max %lu/%lu/%lu ms, p95 <=%lu ms, jitter %lu us, loss %u.%u%%",
+                 i, kind == gadget_probe_tcp ? "tcp" : "icmp", host, port,
+                 (unsigned long)summary.sent, (unsigned long)summary.received,
+                 (unsigned long)summary.min_ms, (unsigned long)summary.mean_ms, (unsigned long)summary.max_ms,
+                 (unsigned long)summary.p95_ms, (unsigned long)summary.jitter_us,
+                 summary.loss_long_permille / 10, summary.loss_long_permille % 10);
+    }
+}
@@ -0,0 +1,424 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "gadget_includes.h"
+#include "gadget_bus.h"
+#include "gadget_ap.h"
+#include "gadget_proto.h"
+#include "gadget_power.h"
+#include "gadget_task.h"
+#include "gadget_profile.h"
+
+const static char *gadget_tag = "gadget_mk1_profile";
+
+#if CONFIG_GADGET_PROFILE
+
+#define GADGET_PROFILE_PERIOD_MS    CONFIG_GADGET_PROFILE_PERIOD_MS
+#define GADGET_PROFILE_MAX_TASKS    32      // every task in the system, IDF and wifi included
+#define GADGET_PROFILE_NOT_PINNED   0xFF
+
+//a full frame goes out as one websocket send buffer
+#define GADGET_PROFILE_FRAME_SIZE   (GADGET_PROTO_HEADER_SIZE + sizeof(gadget_profile_frame_t))
+_Static_assert(GADGET_PROFILE_FRAME_SIZE <= CONFIG_GADGET_WS_TX_BLOCK_SIZE,
+               "profile frame does not fit a websocket send buffer");
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    int core;                   //GADGET_TASK_ANY_CORE when not pinned
+    UBaseType_t priority;
+    uint16_t cpu_permille;
+    uint16_t switches;          //GADGET_PROFILE_UNTRACKED when unknown
+} gadget_profile_task_t;
+
+typedef struct {
+    TaskHandle_t handle;
+    uint32_t run_time;
+} gadget_profile_prev_t;
+
+static esp_timer_handle_t profile_timer = NULL;
+
+//only touched by the sampler, the esp_timer task or the console when the period is 0
+static TaskStatus_t profile_status[GADGET_PROFILE_MAX_TASKS];
+static gadget_profile_prev_t profile_prev[GADGET_PROFILE_MAX_TASKS];
+static size_t profile_prev_count = 0;
+static uint32_t profile_prev_total = 0;
+static int64_t profile_prev_time = 0;
+static gadget_queue_stats_t profile_prev_waits[GADGET_TELEMETRY_QUEUES];
+static uint32_t profile_prev_bursts[GADGET_TELEMETRY_QUEUES];
+static uint32_t profile_prev_wakeups[GADGET_POWER_CORES];
+static uint32_t profile_seq = 0;
+static bool profile_overflow_logged = false;
+
+//last complete window, read by the log
+static gadget_profile_frame_t profile_frame;
+static gadget_profile_task_t profile_tasks[GADGET_PROFILE_MAX_TASKS];
+static size_t profile_task_count = 0;
+static uint32_t profile_samples = 0;
+static uint32_t profile_max_cost_us = 0;
+static uint64_t profile_total_cost_us = 0;
+static portMUX_TYPE profile_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief both lanes of a queue folded into one, receives and the latency
+ * histogram are all the wait report needs
+ */
+static void gadget_profile_queue_waits(gadget_msg_queue_t *msg_queue, gadget_queue_stats_t *waits)
+{
+    gadget_queue_stats_t stats;
+
+    memset(waits, 0, sizeof(gadget_queue_stats_t));
+    if(msg_queue == NULL)
+        return;
+
+    for(int prio = 0; prio < gadget_prio_max; prio++)
+    {
+        gadget_bus_get_queue_stats(msg_queue, prio, &stats);
+        waits->receives += stats.receives;
+        if(stats.max_latency_us > waits->max_latency_us)
+            waits->max_latency_us = stats.max_latency_us;
+        for(int i = 0; i < GADGET_LATENCY_BUCKETS; i++)
+            waits->latency[i] += stats.latency[i];
+    }
+}
+
+/**
+ * @brief run time of handle at the previous sample, 0 for a task created since
+ */
+static uint32_t gadget_profile_prev_run_time(TaskHandle_t handle)
+{
+    for(size_t i = 0; i < profile_prev_count; i++)
+    {
+        if(profile_prev[i].handle == handle)
+            return profile_prev[i].run_time;
+    }
+    return 0;
+}
+
+/**
+ * @brief frame name of a task, without the gadget_ prefix and _task suffix
+ */
+static void gadget_profile_short_name(const char *name, char *out)
+{
+    size_t len;
+
+    if(strncmp(name, "gadget_", 7) == 0)
+        name += 7;
+    len = strlen(name);
+    if(len > 5 && strcmp(&name[len - 5], "_task") == 0)
+        len -= 5;
+    if(len > GADGET_PROFILE_NAME_LEN)
+        len = GADGET_PROFILE_NAME_LEN;
+
+    memset(out, 0, GADGET_PROFILE_NAME_LEN);
+    memcpy(out, name, len);
+}
+
+/**
+ * @brief encode the busiest tasks of the window and share them with every client
+ */
+static void gadget_profile_broadcast(gadget_profile_frame_t *frame,
+                                     const gadget_profile_task_t *tasks, size_t count)
+{
+    static uint8_t buf[GADGET_PROFILE_FRAME_SIZE];
+    gadget_proto_frame_t proto;
+    size_t len;
+
+    if(count > GADGET_PROFILE_FRAME_TASKS)
+        count = GADGET_PROFILE_FRAME_TASKS;
+
+    frame->task_count = (uint8_t)count;
+    for(size_t i = 0; i < count; i++)
+    {
+        gadget_profile_short_name(tasks[i].name, frame->tasks[i].name);
+        frame->tasks[i].core = tasks[i].core < 0 ? GADGET_PROFILE_NOT_PINNED : (uint8_t)tasks[i].core;
+        frame->tasks[i].cpu_permille = tasks[i].cpu_permille;
+        frame->tasks[i].switches = tasks[i].switches;
+    }
+
+    //only the entries in use go on the wire
+    proto.type = GADGET_PROTO_TYPE_PROFILE;
+    proto.prio = gadget_prio_bulk;
+    proto.len = offsetof(gadget_profile_frame_t, tasks) + count * sizeof(frame->tasks[0]);
+    proto.payload = (const uint8_t *)frame;
+    len = gadget_proto_encode(&proto, buf, sizeof(buf));
+    if(len > 0)
+        gadget_ws_broadcast(buf, len, true);
+}
+
+/**
+ * @brief close the current window: cpu share per task from the run time
+ * counters, busy per core from its idle task, queue waits from the bus
+ *
+ * The first call only takes the baseline. Runs on the esp_timer task, or
+ * from the console when no period is set, never both at once, so the large
+ * working buffers are static rather than on that shared stack.
+ */
+void gadget_profile_sample(void)
+{
+    gadget_msg_queue_t *queues[GADGET_TELEMETRY_QUEUES] = {
+        gadget_central_msg_queue, gadget_gpio_msg_queue, gadget_comms_msg_queue,
+    };
+    TaskHandle_t consumers[GADGET_TELEMETRY_QUEUES] = { NULL };
+    uint32_t bursts[GADGET_TELEMETRY_QUEUES] = { 0 };
+    uint32_t wakeups[GADGET_POWER_CORES];
+    TaskHandle_t idle[GADGET_POWER_CORES];
+    static gadget_queue_stats_t waits[GADGET_TELEMETRY_QUEUES];
+    static gadget_queue_stats_t window_waits;
+    gadget_burst_stats_t burst;
+    static gadget_profile_frame_t frame;
+    static gadget_profile_task_t tasks[GADGET_PROFILE_MAX_TASKS];
+    gadget_profile_task_t task;
+    UBaseType_t count;
+    uint32_t total;
+    uint32_t window;
+    uint32_t delta;
+    int64_t start;
+    int64_t now;
+    uint32_t cost;
+    bool baseline;
+
+    start = esp_timer_get_time();
+
+    count = uxTaskGetSystemState(profile_status, GADGET_PROFILE_MAX_TASKS, &total);
+    if(count == 0)
+    {
+        if(!profile_overflow_logged)
+            ESP_LOGW(gadget_tag, "more than %d tasks, raise GADGET_PROFILE_MAX_TASKS", GADGET_PROFILE_MAX_TASKS);
+        profile_overflow_logged = true;
+        return;
+    }
+
+    for(int i = 0; i < GADGET_TELEMETRY_QUEUES; i++)
+    {
+        gadget_profile_queue_waits(queues[i], &waits[i]);
+        if(queues[i] == NULL)
+            continue;
+        consumers[i] = queues[i]->consumer;
+        gadget_bus_get_burst_stats(queues[i], &burst);
+        bursts[i] = burst.bursts;
+    }
+    gadget_power_get_wakeups(wakeups);
+    for(int core = 0; core < GADGET_POWER_CORES; core++)
+        idle[core] = xTaskGetIdleTaskHandleForCore(core);
+
+    baseline = profile_prev_time == 0;
+    now = esp_timer_get_time();
+    //counter ticks one per us per core, so the window is the capacity of one core
+    window = total - profile_prev_total;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.seq = profile_seq;
+    frame.window_ms = (uint32_t)((now - profile_prev_time) / 1000);
+    for(int core = 0; core < GADGET_PROFILE_CORES; core++)
+        frame.core_busy_permille[core] = GADGET_PROFILE_UNTRACKED;
+
+    for(UBaseType_t i = 0; i < count && !baseline; i++)
+    {
+        const TaskStatus_t *status = &profile_status[i];
+
+        memset(&task, 0, sizeof(task));
+        strncpy(task.name, status->pcTaskName, sizeof(task.name) - 1);
+        task.core = status->xCoreID < portNUM_PROCESSORS ? (int)status->xCoreID : GADGET_TASK_ANY_CORE;
+        task.priority = status->uxCurrentPriority;
+        delta = status->ulRunTimeCounter - gadget_profile_prev_run_time(status->xHandle);
+        task.cpu_permille = window ? (uint16_t)((uint64_t)delta * 1000 / window) : 0;
+        task.switches = GADGET_PROFILE_UNTRACKED;
+
+        //idle runs once per return from a wakeup, bus tasks once per burst
+        for(int core = 0; core < GADGET_POWER_CORES; core++)
+        {
+            if(status->xHandle != idle[core])
+                continue;
+            delta = wakeups[core] - profile_prev_wakeups[core];
+            task.switches = delta > UINT16_MAX - 1 ? UINT16_MAX - 1 : delta;
+            if(core < GADGET_PROFILE_CORES)
+                frame.core_busy_permille[core] = task.cpu_permille < 1000 ? 1000 - task.cpu_permille : 0;
+        }
+        for(int q = 0; q < GADGET_TELEMETRY_QUEUES; q++)
+        {
+            if(consumers[q] == NULL || status->xHandle != consumers[q])
+                continue;
+            delta = bursts[q] - profile_prev_bursts[q];
+            task.switches = delta > UINT16_MAX - 1 ? UINT16_MAX - 1 : delta;
+        }
+
+        //insertion sort, busiest first
+        size_t pos = i;
+        while(pos > 0 && tasks[pos - 1].cpu_permille < task.cpu_permille)
+        {
+            tasks[pos] = tasks[pos - 1];
+            pos--;
+        }
+        tasks[pos] = task;
+    }
+
+    for(int q = 0; q < GADGET_TELEMETRY_QUEUES; q++)
+    {
+        memset(&window_waits, 0, sizeof(window_waits));
+        window_waits.receives = waits[q].receives - profile_prev_waits[q].receives;
+        window_waits.max_latency_us = waits[q].max_latency_us;
+        for(int i = 0; i < GADGET_LATENCY_BUCKETS; i++)
+            window_waits.latency[i] = waits[q].latency[i] - profile_prev_waits[q].latency[i];
+        frame.queues[q].waits = window_waits.receives > UINT16_MAX ? UINT16_MAX : window_waits.receives;
+        frame.queues[q].p99_wait_us = gadget_bus_latency_percentile(&window_waits, 99);
+    }
+
+    //new baseline
+    for(UBaseType_t i = 0; i < count; i++)
+    {
+        profile_prev[i].handle = profile_status[i].xHandle;
+        profile_prev[i].run_time = profile_status[i].ulRunTimeCounter;
+    }
+    profile_prev_count = count;
+    profile_prev_total = total;
+    profile_prev_time = now;
+    memcpy(profile_prev_waits, waits, sizeof(profile_prev_waits));
+    memcpy(profile_prev_bursts, bursts, sizeof(profile_prev_bursts));
+    memcpy(profile_prev_wakeups, wakeups, sizeof(profile_prev_wakeups));
+
+    if(baseline)
+        return;
+
+    profile_seq++;
+    cost = (uint32_t)(esp_timer_get_time() - start);
+    frame.cost_us = cost > UINT16_MAX ? UINT16_MAX : cost;
+
+    portENTER_CRITICAL(&profile_lock);
+    profile_frame = frame;
+    memcpy(profile_tasks, tasks, count * sizeof(gadget_profile_task_t));
+    profile_task_count = count;
+    profile_samples++;
+    profile_total_cost_us += cost;
+    if(cost > profile_max_cost_us)
+        profile_max_cost_us = cost;
+    portEXIT_CRITICAL(&profile_lock);
+
+    if(gadget_ws_client_count() > 0)
+        gadget_profile_broadcast(&frame, tasks, count);
+}
+
+static void gadget_profile_tick(void *arg)
+{
+    gadget_profile_sample();
+}
+
+/**
+ * @brief take the baseline and start the periodic window
+ *
+ * With a period of 0 nothing runs in the background, each stats request
+ * closes the window opened by the one before.
+ */
+void gadget_profile_start(void)
+{
+    esp_err_t err;
+    const esp_timer_create_args_t args = {
+        .callback = gadget_profile_tick,
+        .name = "gadget_profile",
+    };
+
+    if(profile_timer != NULL || profile_prev_time != 0)
+        return;
+
+    gadget_profile_sample();
+
+    if(GADGET_PROFILE_PERIOD_MS == 0)
+        return;
+
+    err = esp_timer_create(&args, &profile_timer);
+    if(err != ESP_OK)
+    {
+        ESP_LOGE(gadget_tag, "ERROR failed to create profile timer CODE(%s)", esp_err_to_name(err));
+        profile_timer = NULL;
+        return;
+    }
+
+    if(esp_timer_start_periodic(profile_timer, (uint64_t)GADGET_PROFILE_PERIOD_MS * 1000) != ESP_OK)
+        ESP_LOGE(gadget_tag, "ERROR failed to start profile timer");
+}
+
+/**
+ * @brief print the last window, per core, per task and per queue
+ *
+ */
+void gadget_profile_log_stats(void)
+{
+    gadget_profile_frame_t frame;
+    gadget_profile_task_t tasks[GADGET_PROFILE_MAX_TASKS];
+    static const char *queue_names[GADGET_TELEMETRY_QUEUES] = { "central", "gpio", "comms" };
+    size_t count;
+    uint32_t samples;
+    uint32_t max_cost;
+    uint64_t total_cost;
+
+    if(GADGET_PROFILE_PERIOD_MS == 0)
+        gadget_profile_sample();
+
+    portENTER_CRITICAL(&profile_lock);
+    frame = profile_frame;
+    count = profile_task_count;
+    memcpy(tasks, profile_tasks, count * sizeof(gadget_profile_task_t));
+    samples = profile_samples;
+    max_cost = profile_max_cost_us;
+    total_cost = profile_total_cost_us;
+    portEXIT_CRITICAL(&profile_lock);
+
+    if(samples == 0)
+    {
+        ESP_LOGI(gadget_tag, "profile: no window closed yet");
+        return;
+    }
+
+    ESP_LOGI(gadget_tag, "profile window %lu: %lu ms, cost %u us (avg %lu max %lu)",
+             (unsigned long)frame.seq, (unsigned long)frame.window_ms, (unsigned)frame.cost_us,
+             (unsigned long)(total_cost / samples), (unsigned long)max_cost);
+    for(int core = 0; core < GADGET_PROFILE_CORES; core++)
+    {
+        if(frame.core_busy_permille[core] == GADGET_PROFILE_UNTRACKED)
+            continue;
+        ESP_LOGI(gadget_tag, "core %d busy %3u.%u%%", core,
+                 frame.core_busy_permille[core] / 10, frame.core_busy_permille[core] % 10);
+    }
+
+    for(size_t i = 0; i < count; i++)
+    {
+        if(tasks[i].switches == GADGET_PROFILE_UNTRACKED)
+            ESP_LOGI(gadget_tag, "%-16s core %2d prio %2u cpu %3u.%u%% switches -",
+                     tasks[i].name, tasks[i].core, (unsigned)tasks[i].priority,
+                     tasks[i].cpu_permille / 10, tasks[i].cpu_permille % 10);
+        else
+            ESP_LOGI(gadget_tag, "%-16s core %2d prio %2u cpu %3u.%u%% switches %u",
+                     tasks[i].name, tasks[i].core, (unsigned)tasks[i].priority,
+                     tasks[i].cpu_permille / 10, tasks[i].cpu_permille % 10, tasks[i].switches);
+    }
+
+    for(int q = 0; q < GADGET_TELEMETRY_QUEUES; q++)
+    {
+        ESP_LOGI(gadget_tag, "queue %-8s waits %5u p99 < %lu us", queue_names[q],
+                 frame.queues[q].waits, (unsigned long)frame.queues[q].p99_wait_us);
+    }
+}
+
+#else
+
+void gadget_profile_start(void)
+{
+}
+
+void gadget_profile_sample(void)
+{
+}
+
+void gadget_profile_log_stats(void)
+{
+    ESP_LOGI(gadget_tag, "profiler disabled, enable GADGET_PROFILE with FreeRTOS trace facility and run time stats");
+}
+
+#endif
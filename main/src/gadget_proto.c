@@ -0,0 +1,119 @@
+#include <string.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#include "gadget_msg_types.h"
+#include "gadget_proto.h"
+
+typedef struct {
+    uint8_t wire;
+    uint8_t remote;
+    msg_type_t msg_type;
+} gadget_proto_wire_t;
+
+#define GADGET_PROTO_WIRE_ENTRY(type, wire, queue, handler, coalesce, remote) { wire, remote, type },
+
+//wire id of every msg type, in list order
+static const gadget_proto_wire_t gadget_proto_wire[gadget_msg_type_max] = {
+    GADGET_MSG_TYPE_LIST(GADGET_PROTO_WIRE_ENTRY)
+};
+
+/**
+ * @brief the message type a client may send with this wire id
+ *
+ * @return true
+ * @return false unknown id or a device internal type
+ */
+static bool gadget_proto_remote_type(uint8_t wire, msg_type_t *msg_type)
+{
+    for(size_t i = 0; i < gadget_msg_type_max; i++)
+    {
+        if(gadget_proto_wire[i].wire == wire)
+        {
+            if(!gadget_proto_wire[i].remote)
+                return false;
+            *msg_type = gadget_proto_wire[i].msg_type;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief wire id of a message type, remote or not
+ *
+ * @param msg_type
+ * @return int -1 for an unknown type
+ */
+int gadget_proto_wire_id(msg_type_t msg_type)
+{
+    if(msg_type >= gadget_msg_type_max)
+        return -1;
+    return gadget_proto_wire[msg_type].wire;
+}
+
+/**
+ * @brief write one frame
+ *
+ * @param frame
+ * @param out
+ * @param out_size
+ * @return size_t bytes written, 0 if out is too small
+ */
+size_t gadget_proto_encode(const gadget_proto_frame_t *frame, uint8_t *out, size_t out_size)
+{
+    size_t total = GADGET_PROTO_HEADER_SIZE + frame->len;
+
+    if(out_size < total)
+        return 0;
+
+    out[0] = GADGET_PROTO_VERSION;
+    out[1] = frame->type;
+    out[2] = (frame->prio == gadget_prio_high) ? GADGET_PROTO_FLAG_HIGH : 0;
+    out[3] = frame->len & 0xFF;
+    out[4] = frame->len >> 8;
+    if(frame->len > 0)
+        memcpy(&out[GADGET_PROTO_HEADER_SIZE], frame->payload, frame->len);
+
+    return total;
+}
+
+/**
+ * @brief read the next frame of buf, the payload points into buf
+ *
+ * @param buf
+ * @param len
+ * @param frame
+ * @param consumed      bytes of buf used by this frame
+ * @return esp_err_t ESP_ERR_INVALID_SIZE on a truncated frame,
+ *                   ESP_ERR_INVALID_VERSION on an unknown version,
+ *                   ESP_ERR_INVALID_ARG on a type clients may not send
+ */
+esp_err_t gadget_proto_decode(const uint8_t *buf, size_t len, gadget_proto_frame_t *frame, size_t *consumed)
+{
+    uint16_t payload_len;
+
+    *consumed = 0;
+    if(len < GADGET_PROTO_HEADER_SIZE)
+        return ESP_ERR_INVALID_SIZE;
+    if(buf[0] != GADGET_PROTO_VERSION)
+        return ESP_ERR_INVALID_VERSION;
+
+    payload_len = buf[3] | (buf[4] << 8);
+    if(len - GADGET_PROTO_HEADER_SIZE < payload_len)
+        return ESP_ERR_INVALID_SIZE;
+
+    //frame is well formed from here on, skip it even if the type is unknown
+    *consumed = GADGET_PROTO_HEADER_SIZE + payload_len;
+    if(!gadget_proto_remote_type(buf[1], &frame->msg_type))
+        return ESP_ERR_INVALID_ARG;
+
+    frame->type = buf[1];
+    frame->prio = (buf[2] & GADGET_PROTO_FLAG_HIGH) ? gadget_prio_high : gadget_prio_bulk;
+    frame->len = payload_len;
+    frame->payload = &buf[GADGET_PROTO_HEADER_SIZE];
+
+    return ESP_OK;
+}
@@ -0,0 +1,92 @@
+#include <string.h>
+
+#include "gadget_ring.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#define GADGET_RING_ATTR    IRAM_ATTR
+#else
+#define GADGET_RING_ATTR
+#endif
+
+/**
+ * @brief smallest power of two holding length items
+ *
+ * @param length
+ * @return uint32_t
+ */
+uint32_t gadget_ring_capacity_for(uint32_t length)
+{
+    uint32_t capacity = 1;
+
+    while(capacity < length)
+        capacity <<= 1;
+
+    return capacity;
+}
+
+/**
+ * @brief bind ring to a buffer of capacity * item_size bytes
+ *
+ * @param ring
+ * @param buf
+ * @param item_size
+ * @param capacity  power of two
+ */
+void gadget_ring_init(gadget_ring_t *ring, void *buf, uint32_t item_size, uint32_t capacity)
+{
+    ring->buf = buf;
+    ring->item_size = item_size;
+    ring->mask = capacity - 1;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+/**
+ * @brief producer side, safe from ISR
+ *
+ * @param ring
+ * @param item
+ * @return true
+ * @return false ring full
+ */
+GADGET_RING_ATTR bool gadget_ring_push(gadget_ring_t *ring, const void *item)
+{
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if(head - tail > ring->mask)
+        return false;
+
+    memcpy(ring->buf + (head & ring->mask) * ring->item_size, item, ring->item_size);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/**
+ * @brief consumer side
+ *
+ * @param ring
+ * @param item
+ * @return true
+ * @return false ring empty
+ */
+GADGET_RING_ATTR bool gadget_ring_pop(gadget_ring_t *ring, void *item)
+{
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    if(head == tail)
+        return false;
+
+    memcpy(item, ring->buf + (tail & ring->mask) * ring->item_size, ring->item_size);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+GADGET_RING_ATTR uint32_t gadget_ring_count(const gadget_ring_t *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
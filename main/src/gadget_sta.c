@@ -4,18 +4,23 @@
 
 #include "gadget_includes.h"
 #include "gadget_sta.h"
+#include "gadget_ping_stats.h"
+#include "gadget_dns.h"
+#include "gadget_wifi.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/event_groups.h"
 
 #include "esp_mac.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
 #include "esp_netif_net_stack.h"
 #include "esp_netif.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "lwip/inet.h"
 #include "lwip/netdb.h"
 #include "lwip/sockets.h"
@@ -24,36 +29,371 @@
 
 #include "ping/ping_sock.h"
 
-#define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
+#define GADGET_STA_BACKOFF_MIN_MS   CONFIG_GADGET_STA_BACKOFF_MIN_MS
+#define GADGET_STA_BACKOFF_MAX_MS   CONFIG_GADGET_STA_BACKOFF_MAX_MS
 
-const static char *gadget_tag = "gadget_mk1_sta";
+#define GADGET_STA_NVS_NAMESPACE    "gadget_sta"
+#define GADGET_STA_NVS_FAST_KEY     "fast"
+#define GADGET_STA_FAST_VERSION     1
+
+#define GADGET_PING_TARGET          CONFIG_GADGET_PING_TARGET
+#define GADGET_PING_INTERVAL_MS     CONFIG_GADGET_PING_INTERVAL_MS
+#define GADGET_PING_TIMEOUT_MS      CONFIG_GADGET_PING_TIMEOUT_MS
 
-static EventGroupHandle_t sta_wifi_event_group;
+const static char *gadget_tag = "gadget_mk1_sta";
 
 static bool sta_init_in = false;
+
+//connection state machine, driven from the default event loop
+static gadget_sta_metrics_t sta_metrics = { .state = gadget_sta_idle };
+static portMUX_TYPE sta_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t sta_retry_timer = NULL;
+//under sta_lock, the retry timer and the event loop both move them
+static int64_t sta_attempt_start_us = 0;    // first attempt of the current outage
+static int64_t sta_start_us = 0;            // gadget_sta_init call, 0 once it got its first IP
+static uint32_t sta_backoff_ms = GADGET_STA_BACKOFF_MIN_MS;
+//set by gadget_sta_stop, a retry that already fired must not reconnect
+static bool sta_stopped = false;
+
+//last good association, kept in NVS for a directed connect on the next boot
+typedef struct {
+    uint8_t version;
+    uint8_t ssid[32];
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+} gadget_sta_fast_t;
+
+static wifi_config_t sta_config;
+static gadget_sta_fast_t sta_fast;
+static bool sta_fast_path = false;      // the current attempt uses the cached BSSID / channel
+
 static bool ping_init = false;
 
 static esp_ping_handle_t ping;
 
+//set from the console, read when a session starts
+static char ping_target[GADGET_DNS_HOST_LEN] = GADGET_PING_TARGET;
+static portMUX_TYPE ping_target_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//fed from the ping task, read by anyone through gadget_ping_get_summary
+static gadget_ping_stats_t ping_stats;
+static portMUX_TYPE ping_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief load the fast connect cache, valid only for the configured ssid
+ * 
+ * @param ssid 
+ * @return true 
+ * @return false nothing usable stored
+ */
+static bool gadget_sta_fast_load(const char *ssid)
+{
+    nvs_handle_t nvs;
+    size_t len = sizeof(gadget_sta_fast_t);
+    esp_err_t ret;
+
+    if(nvs_open(GADGET_STA_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+        return false;
+    ret = nvs_get_blob(nvs, GADGET_STA_NVS_FAST_KEY, &sta_fast, &len);
+    nvs_close(nvs);
+
+    return ret == ESP_OK && len == sizeof(gadget_sta_fast_t) &&
+           sta_fast.version == GADGET_STA_FAST_VERSION &&
+           strncmp((const char *)sta_fast.ssid, ssid, sizeof(sta_fast.ssid)) == 0;
+}
+
+/**
+ * @brief store the association that just got an IP, skipped if unchanged
+ * 
+ * @param ip_info 
+ */
+static void gadget_sta_fast_save(const esp_netif_ip_info_t *ip_info)
+{
+    gadget_sta_fast_t fast;
+    wifi_ap_record_t ap;
+    nvs_handle_t nvs;
+    esp_err_t ret;
+
+    if(esp_wifi_sta_get_ap_info(&ap) != ESP_OK)
+        return;
+
+    memset(&fast, 0, sizeof(fast));
+    fast.version = GADGET_STA_FAST_VERSION;
+    memcpy(fast.ssid, sta_config.sta.ssid, sizeof(fast.ssid));
+    memcpy(fast.bssid, ap.bssid, sizeof(fast.bssid));
+    fast.channel = ap.primary;
+    fast.ip = ip_info->ip.addr;
+    fast.netmask = ip_info->netmask.addr;
+    fast.gw = ip_info->gw.addr;
+
+    //spare the flash when nothing moved
+    if(memcmp(&fast, &sta_fast, sizeof(fast)) == 0)
+        return;
+
+    ret = nvs_open(GADGET_STA_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if(ret == ESP_OK)
+    {
+        ret = nvs_set_blob(nvs, GADGET_STA_NVS_FAST_KEY, &fast, sizeof(fast));
+        if(ret == ESP_OK)
+            ret = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if(ret != ESP_OK)
+    {
+        ESP_LOGE(gadget_tag, "ERROR saving fast connect cache CODE(%s)", esp_err_to_name(ret));
+        return;
+    }
+    sta_fast = fast;
+    ESP_LOGI(gadget_tag, "fast connect cache updated: channel %d", fast.channel);
+}
+
+/**
+ * @brief drop the BSSID / channel pin so later reconnects scan every channel
+ * 
+ */
+static void gadget_sta_unpin(void)
+{
+    sta_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    sta_config.sta.bssid_set = false;
+    sta_config.sta.channel = 0;
+    esp_wifi_set_config(WIFI_IF_STA, &sta_config);
+}
+
+/**
+ * @brief the directed connect failed, forget it and go back to a full scan
+ * 
+ */
+static void gadget_sta_fast_fallback(void)
+{
+    nvs_handle_t nvs;
+
+    sta_fast_path = false;
+    memset(&sta_fast, 0, sizeof(sta_fast));
+    gadget_sta_unpin();
+
+    if(nvs_open(GADGET_STA_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK)
+    {
+        nvs_erase_key(nvs, GADGET_STA_NVS_FAST_KEY);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+
+    portENTER_CRITICAL(&sta_lock);
+    sta_metrics.fast_fallbacks++;
+    portEXIT_CRITICAL(&sta_lock);
+
+    ESP_LOGW(gadget_tag, "fast connect failed, falling back to a full scan");
+}
+
+/**
+ * @brief move the state machine and tell central about it
+ * 
+ * @param state 
+ * @param reason    disconnect reason, 0 otherwise
+ */
+static void gadget_sta_set_state(gadget_sta_state_t state, uint8_t reason)
+{
+    gadget_msg_t msg;
+    uint8_t *payload;
+
+    portENTER_CRITICAL(&sta_lock);
+    sta_metrics.state = state;
+    portEXIT_CRITICAL(&sta_lock);
+
+    memset(&msg, 0, sizeof(gadget_msg_t));
+    payload = gadget_msg_alloc_payload(&msg, 2);
+    if(payload != NULL)
+    {
+        payload[0] = state;
+        payload[1] = reason;
+    }
+    gadget_send_msg(gadget_central_msg_queue, 0, gadget_prio_bulk, gadget_comms_id, gadget_msg_sta_state, &msg);
+}
+
+/**
+ * @brief note the start of an outage, if it is not already running
+ * 
+ */
+static void gadget_sta_outage_begin(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&sta_lock);
+    if(sta_attempt_start_us == 0)
+        sta_attempt_start_us = now;
+    portEXIT_CRITICAL(&sta_lock);
+}
+
+/**
+ * @brief schedule the next attempt, exponential backoff with jitter
+ * 
+ * The delay is drawn from [backoff / 2, backoff) so stations that lost the
+ * same AP do not retry in lockstep, then the backoff doubles up to
+ * GADGET_STA_BACKOFF_MAX_MS.
+ * 
+ * @param reason 
+ */
+static void gadget_sta_schedule_retry(uint8_t reason)
+{
+    uint32_t jitter = esp_random();
+    uint32_t delay_ms;
+
+    portENTER_CRITICAL(&sta_lock);
+    delay_ms = sta_backoff_ms / 2 + jitter % (sta_backoff_ms / 2 + 1);
+    sta_backoff_ms = sta_backoff_ms * 2 < GADGET_STA_BACKOFF_MAX_MS ? sta_backoff_ms * 2 : GADGET_STA_BACKOFF_MAX_MS;
+    sta_metrics.backoff_ms = delay_ms;
+    portEXIT_CRITICAL(&sta_lock);
+
+    ESP_LOGI(gadget_tag, "reconnecting in %lu ms", (unsigned long)delay_ms);
+    gadget_sta_set_state(gadget_sta_backoff, reason);
+    esp_timer_stop(sta_retry_timer);
+    esp_timer_start_once(sta_retry_timer, (uint64_t)delay_ms * 1000);
+}
+
+/**
+ * @brief start one connect attempt
+ * 
+ * A call that fails straight away counts as a failed attempt and backs off
+ * like a disconnect would.
+ */
+static void gadget_sta_connect(void)
+{
+    esp_err_t ret;
+
+    portENTER_CRITICAL(&sta_lock);
+    sta_metrics.attempts++;
+    portEXIT_CRITICAL(&sta_lock);
+    gadget_sta_outage_begin();
+
+    gadget_sta_set_state(gadget_sta_connecting, 0);
+    ret = esp_wifi_connect();
+    if(ret != ESP_OK)
+    {
+        ESP_LOGE(gadget_tag, "ERROR esp_wifi_connect failed CODE(%s)", esp_err_to_name(ret));
+        gadget_sta_schedule_retry(0);
+    }
+}
+
+static void gadget_sta_retry(void *arg)
+{
+    bool stopped;
+
+    //esp_timer_stop cannot take back a callback already dispatched
+    portENTER_CRITICAL(&sta_lock);
+    stopped = sta_stopped;
+    portEXIT_CRITICAL(&sta_lock);
+    if(stopped)
+        return;
+
+    gadget_sta_connect();
+}
+
+/**
+ * @brief the connection came up, record how long it took
+ * 
+ */
+static void gadget_sta_got_ip(void)
+{
+    gadget_sta_start_stats_t *path;
+    bool first = false;
+    int64_t now = esp_timer_get_time();
+    uint32_t elapsed_ms;
+    uint32_t start_ms = 0;
+
+    portENTER_CRITICAL(&sta_lock);
+    elapsed_ms = (uint32_t)((now - sta_attempt_start_us) / 1000);
+    sta_attempt_start_us = 0;
+    sta_backoff_ms = GADGET_STA_BACKOFF_MIN_MS;
+    //the STA only starts when asked to, so time it from that and not from boot
+    if(sta_start_us != 0)
+    {
+        start_ms = (uint32_t)((now - sta_start_us) / 1000);
+        sta_start_us = 0;
+        sta_metrics.start_to_ip_ms = start_ms;
+        sta_metrics.start_fast_path = sta_fast_path;
+        path = sta_fast_path ? &sta_metrics.start_fast : &sta_metrics.start_scan;
+        if(path->count == 0 || start_ms < path->min_ms)
+            path->min_ms = start_ms;
+        if(start_ms > path->max_ms)
+            path->max_ms = start_ms;
+        path->total_ms += start_ms;
+        path->count++;
+        first = true;
+    }
+    sta_metrics.connects++;
+    sta_metrics.backoff_ms = 0;
+    sta_metrics.last_connect_ms = elapsed_ms;
+    sta_metrics.total_connect_ms += elapsed_ms;
+    if(sta_metrics.connects == 1 || elapsed_ms < sta_metrics.min_connect_ms)
+        sta_metrics.min_connect_ms = elapsed_ms;
+    if(elapsed_ms > sta_metrics.max_connect_ms)
+        sta_metrics.max_connect_ms = elapsed_ms;
+    portEXIT_CRITICAL(&sta_lock);
+
+    if(first)
+        ESP_LOGI(gadget_tag, "sta start to IP %lu ms via %s", (unsigned long)start_ms,
+                 sta_fast_path ? "fast connect" : "full scan");
+    sta_fast_path = false;
+
+    gadget_sta_set_state(gadget_sta_online, 0);
+}
+
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
         wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *) event_data;
-        ESP_LOGI(gadget_tag, "Station %.s joined, AID=%d",
-                 event->ssid_len, event->ssid, event->aid);
+        ESP_LOGI(gadget_tag, "Station %.*s joined, AID=%d",
+                 (int)event->ssid_len, (const char *)event->ssid, event->aid);
+        gadget_sta_set_state(gadget_sta_associated, 0);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *) event_data;
-        ESP_LOGI(gadget_tag, "Station %.s left, reason=%d",
-                 event->ssid_len, event->ssid, event->reason);
+        ESP_LOGI(gadget_tag, "Station %.*s left, reason=%d",
+                 (int)event->ssid_len, (const char *)event->ssid, event->reason);
+        portENTER_CRITICAL(&sta_lock);
+        sta_metrics.disconnects++;
+        sta_metrics.last_reason = event->reason;
+        portEXIT_CRITICAL(&sta_lock);
+        if(!sta_init_in)
+            return;
+        gadget_sta_outage_begin();
+        //a stale hint costs one attempt, retry straight away with a full scan
+        if(sta_fast_path)
+        {
+            gadget_sta_fast_fallback();
+            gadget_sta_connect();
+        }
+        else
+        {
+            //the AP may have moved since, do not stay pinned to it
+            if(sta_config.sta.bssid_set)
+                gadget_sta_unpin();
+            gadget_sta_schedule_retry(event->reason);
+        }
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
         ESP_LOGI(gadget_tag, "Station started");
+        if(sta_init_in)
+            gadget_sta_connect();
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *) event_data;
         ESP_LOGI(gadget_tag, "Got IP:" IPSTR, IP2STR(&event->ip_info.ip));
-        xEventGroupSetBits(sta_wifi_event_group, WIFI_CONNECTED_BIT);
+        char host[GADGET_DNS_HOST_LEN];
+        gadget_ping_get_target(host);
+        gadget_dns_prefetch(host);
+#if CONFIG_GADGET_STA_FAST_CONNECT
+        gadget_sta_fast_save(&event->ip_info);
+#endif
+        gadget_sta_got_ip();
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_LOST_IP) {
+        //still associated, the DHCP lease ran out or the address was taken away
+        ESP_LOGW(gadget_tag, "Lost IP");
+        if(!sta_init_in)
+            return;
+        gadget_sta_outage_begin();
+        gadget_sta_set_state(gadget_sta_associated, 0);
     }
 }
 
@@ -66,8 +406,6 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
  */
 esp_netif_t *gadget_init_sta_interface(char *ssid, char *pwd)
 {
-    esp_netif_t *esp_netif_sta = esp_netif_create_default_wifi_sta();
-
     wifi_config_t wifi_sta_config = {
         .sta = {
             .scan_method = WIFI_ALL_CHANNEL_SCAN,
@@ -81,11 +419,25 @@ esp_netif_t *gadget_init_sta_interface(char *ssid, char *pwd)
     strncpy((char *)wifi_sta_config.sta.ssid,     ssid, sizeof(wifi_sta_config.sta.ssid)     - 1);
     strncpy((char *)wifi_sta_config.sta.password, pwd,  sizeof(wifi_sta_config.sta.password) - 1);
 
-    esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &wifi_sta_config);
-    if(err != ESP_OK)
+    //directed connect to the last good AP, skips the all channel scan
+#if CONFIG_GADGET_STA_FAST_CONNECT
+    sta_fast_path = gadget_sta_fast_load(ssid);
+#endif
+    if(sta_fast_path)
     {
-        ESP_LOGE(gadget_tag, "esp_wifi_set_config ERROR: %s", esp_err_to_name(err));
+        wifi_sta_config.sta.scan_method = WIFI_FAST_SCAN;
+        wifi_sta_config.sta.bssid_set = true;
+        memcpy(wifi_sta_config.sta.bssid, sta_fast.bssid, sizeof(sta_fast.bssid));
+        wifi_sta_config.sta.channel = sta_fast.channel;
+        wifi_sta_config.sta.failure_retry_cnt = 1;
+        ESP_LOGI(gadget_tag, "fast connect to " MACSTR " on channel %d",
+                 MAC2STR(sta_fast.bssid), sta_fast.channel);
     }
+    sta_config = wifi_sta_config;
+    sta_config.sta.failure_retry_cnt = 5;
+
+    //joins the running AP if there is one, STA_START then kicks off the connect
+    esp_netif_t *esp_netif_sta = gadget_wifi_add(WIFI_IF_STA, &wifi_sta_config);
 
     ESP_LOGI(gadget_tag, "wifi_init_sta finished.");
 
@@ -103,89 +455,78 @@ esp_netif_t *gadget_init_sta_interface(char *ssid, char *pwd)
 bool gadget_sta_init(char *ssid, char *pwd)
 {
     esp_err_t ret = ESP_OK;
-    ret = esp_netif_init();
-    ret = esp_event_loop_create_default();
-
-    //Initialize NVS
-    ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ret = nvs_flash_erase();
-        ret = nvs_flash_init();
-        ESP_LOGE(gadget_tag, "STA: Error Initializing NVS");
-    }
+    int64_t start_us = esp_timer_get_time();
 
-    sta_wifi_event_group = xEventGroupCreate();
-
-    // Initialize Event handler for WIFI STA
-    ret = esp_event_handler_instance_register(WIFI_EVENT,
-                    ESP_EVENT_ANY_ID,
-                    &wifi_event_handler,
-                    NULL,
-                    NULL);
-    
-    if(ret != ESP_OK)
-    {
-        ESP_LOGE(gadget_tag, "ERROR: %s", esp_err_to_name(ret));
+    if(gadget_wifi_init() != ESP_OK)
         return false;
-    }
 
-    // Initialize Event handler for IP Aqcuisition
-    ret = esp_event_handler_instance_register(IP_EVENT,
-                    IP_EVENT_STA_GOT_IP,
-                    &wifi_event_handler,
-                    NULL,
-                    NULL);
-    
-    if(ret != ESP_OK)
+    //timer and handlers outlive a gadget_sta_stop, set them up once
+    if(sta_retry_timer == NULL)
     {
-        ESP_LOGE(gadget_tag, "ERROR: %s", esp_err_to_name(ret));
-        return false;
-    }
+        const esp_timer_create_args_t retry_args = {
+            .callback = gadget_sta_retry,
+            .name = "gadget_sta_retry",
+        };
+        ret = esp_timer_create(&retry_args, &sta_retry_timer);
+        if(ret != ESP_OK)
+        {
+            ESP_LOGE(gadget_tag, "ERROR: %s", esp_err_to_name(ret));
+            return false;
+        }
 
-    // Initialize esp-idf's wifi's default configuration
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ret = esp_wifi_init(&cfg);
-    if(ret != ESP_OK)
-    {
-        ESP_LOGE(gadget_tag, "ERROR: %s", esp_err_to_name(ret));
-        return false;
-    }
+        // Initialize Event handler for WIFI STA
+        ret = esp_event_handler_instance_register(WIFI_EVENT,
+                        ESP_EVENT_ANY_ID,
+                        &wifi_event_handler,
+                        NULL,
+                        NULL);
+        
+        if(ret != ESP_OK)
+        {
+            ESP_LOGE(gadget_tag, "ERROR: %s", esp_err_to_name(ret));
+            return false;
+        }
 
-    // Set to explicitly station mode
-    ret = esp_wifi_set_mode(WIFI_MODE_STA);
+        // Initialize Event handler for IP Aqcuisition
+        ret = esp_event_handler_instance_register(IP_EVENT,
+                        IP_EVENT_STA_GOT_IP,
+                        &wifi_event_handler,
+                        NULL,
+                        NULL);
+        
+        if(ret != ESP_OK)
+        {
+            ESP_LOGE(gadget_tag, "ERROR: %s", esp_err_to_name(ret));
+            return false;
+        }
 
-    if(ret != ESP_OK)
-    {
-        ESP_LOGE(gadget_tag, "ERROR: %s", esp_err_to_name(ret));
-        return false;
+        // and for losing it again while still associated
+        ret = esp_event_handler_instance_register(IP_EVENT,
+                        IP_EVENT_STA_LOST_IP,
+                        &wifi_event_handler,
+                        NULL,
+                        NULL);
+        
+        if(ret != ESP_OK)
+        {
+            ESP_LOGE(gadget_tag, "ERROR: %s", esp_err_to_name(ret));
+            return false;
+        }
     }
 
+    sta_init_in = true;
+    portENTER_CRITICAL(&sta_lock);
+    sta_stopped = false;
+    sta_attempt_start_us = 0;
+    sta_start_us = start_us;
+    sta_backoff_ms = GADGET_STA_BACKOFF_MIN_MS;
+    portEXIT_CRITICAL(&sta_lock);
+
     ESP_LOGI(gadget_tag, "ESP_WIFI_MODE_STA");
     esp_netif_t *esp_netif_sta = gadget_init_sta_interface(ssid, pwd);
-
-    // Start Connection to wifi.
-    ret = esp_wifi_start();
-    if(ret != ESP_OK)
+    if(esp_netif_sta == NULL)
     {
-        ESP_LOGE(gadget_tag, "esp_wifi_start ERROR: %s", esp_err_to_name(ret));
-        return false;
-    }
-
-    // Wait for connection
-    EventBits_t bits = xEventGroupWaitBits(sta_wifi_event_group,
-                                           WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                                           pdFALSE,
-                                           pdFALSE,
-                                           portMAX_DELAY);
-
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(gadget_tag, "connected to ap SSID:%s password:%s",
-                 ssid, pwd);
-    } else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGI(gadget_tag, "Failed to connect to SSID:%s, password:%s",
-                 ssid, pwd);
-    } else {
-        ESP_LOGE(gadget_tag, "UNEXPECTED EVENT");
+        sta_init_in = false;
         return false;
     }
 
@@ -194,91 +535,265 @@ bool gadget_sta_init(char *ssid, char *pwd)
     if(ret != ESP_OK)
     {
         ESP_LOGE(gadget_tag, "esp_netif_set_default_netif ERROR: %s", esp_err_to_name(ret));
-        return false;
     }
-    sta_init_in = true;
+
+    // the rest runs from the event loop
+    ESP_LOGI(gadget_tag, "connecting to ap SSID:%s", ssid);
+    return true;
+}
+
+/**
+ * @brief leave the network and drop the STA interface, the AP keeps running
+ * 
+ * @return true 
+ * @return false 
+ */
+bool gadget_sta_stop(void)
+{
+    if(!sta_init_in)
+        return true;
+
+    //the disconnect event sees this and does not schedule a retry
+    sta_init_in = false;
+    portENTER_CRITICAL(&sta_lock);
+    sta_stopped = true;
+    portEXIT_CRITICAL(&sta_lock);
+    esp_timer_stop(sta_retry_timer);
+    esp_wifi_disconnect();
+    if(gadget_wifi_remove(WIFI_IF_STA) != ESP_OK)
+        return false;
+
+    gadget_sta_set_state(gadget_sta_idle, 0);
     return true;
 }
 
 static void ping_success(esp_ping_handle_t ping_hdl, void *args)
 {
-    uint8_t ttl;
     uint16_t seqno;
-    uint32_t elapsed_time, recv_len;
-    ip_addr_t target_ip;
+    uint32_t elapsed_time;
 
-    //esp_ping profiles for each type of ping profile
     esp_ping_get_profile(ping_hdl, ESP_PING_PROF_SEQNO, &seqno, sizeof(seqno));
-    esp_ping_get_profile(ping_hdl, ESP_PING_PROF_TTL, &ttl, sizeof(ttl));
-    esp_ping_get_profile(ping_hdl, ESP_PING_PROF_IPADDR, &target_ip, sizeof(target_ip));
-    esp_ping_get_profile(ping_hdl, ESP_PING_PROF_SIZE, &recv_len, sizeof(recv_len));
     esp_ping_get_profile(ping_hdl, ESP_PING_PROF_TIMEGAP, &elapsed_time, sizeof(elapsed_time));
-    
-    ESP_LOGI(gadget_tag, "%d bytes from ping %s, seqno=%d, ttl=%d, elapsed time=%d",
-                        recv_len, inet_ntoa(target_ip.u_addr.ip4), seqno, ttl, elapsed_time);
-    
+
+    portENTER_CRITICAL(&ping_stats_lock);
+    gadget_ping_stats_add_reply(&ping_stats, elapsed_time);
+    portEXIT_CRITICAL(&ping_stats_lock);
+
+    ESP_LOGD(gadget_tag, "ping reply seqno=%d, elapsed time=%lu", seqno, (unsigned long)elapsed_time);
 }
 
 static void ping_timeout(esp_ping_handle_t ping_hdl, void *args)
 {
     uint16_t seqno;
-    ip_addr_t target_ip;
+
     esp_ping_get_profile(ping_hdl, ESP_PING_PROF_SEQNO, &seqno, sizeof(seqno));
-    esp_ping_get_profile(ping_hdl, ESP_PING_PROF_IPADDR, &target_ip, sizeof(target_ip));
 
-    ESP_LOGI(gadget_tag, "seqno=%d, ping to %s timeout", seqno, inet_ntoa(target_ip.u_addr.ip4));
+    portENTER_CRITICAL(&ping_stats_lock);
+    gadget_ping_stats_add_timeout(&ping_stats);
+    portEXIT_CRITICAL(&ping_stats_lock);
+
+    ESP_LOGD(gadget_tag, "seqno=%d, ping timeout", seqno);
 }
 
 static void ping_end(esp_ping_handle_t ping_hdl, void *args)
 {
-    uint32_t transmitted;
-    uint32_t total_recv;
-    uint32_t total_uptime;
+    ESP_LOGI(gadget_tag, "ping session ended");
+    gadget_ping_log_stats();
+}
+
+/**
+ * @brief snapshot of the running ping statistics
+ * 
+ * @param summary 
+ */
+void gadget_ping_get_summary(gadget_ping_summary_t *summary)
+{
+    gadget_ping_stats_t stats;
+
+    portENTER_CRITICAL(&ping_stats_lock);
+    stats = ping_stats;
+    portEXIT_CRITICAL(&ping_stats_lock);
+
+    gadget_ping_stats_summarize(&stats, summary);
+}
+
+/**
+ * @brief print rtt, jitter and loss of the current ping session
+ * 
+ */
+void gadget_ping_log_stats(void)
+{
+    gadget_ping_summary_t summary;
+    char host[GADGET_DNS_HOST_LEN];
+
+    gadget_ping_get_target(host);
+    gadget_ping_get_summary(&summary);
+    ESP_LOGI(gadget_tag, "ping %s: sent %lu, recv %lu, rtt min/mean/max %lu/%lu/%lu ms, p50 <=%lu p95 <=%lu p99 <=%lu ms, jitter %lu us, loss %u.%u%% (last %d) %u.%u%% (last %d)",
+             host, (unsigned long)summary.sent, (unsigned long)summary.received,
+             (unsigned long)summary.min_ms, (unsigned long)summary.mean_ms, (unsigned long)summary.max_ms,
+             (unsigned long)summary.p50_ms, (unsigned long)summary.p95_ms, (unsigned long)summary.p99_ms,
+             (unsigned long)summary.jitter_us,
+             summary.loss_short_permille / 10, summary.loss_short_permille % 10, GADGET_PING_WINDOW_SHORT,
+             summary.loss_long_permille / 10, summary.loss_long_permille % 10, GADGET_PING_WINDOW_LONG);
+}
+
+gadget_sta_state_t gadget_sta_get_state(void)
+{
+    return sta_metrics.state;
+}
+
+void gadget_sta_get_metrics(gadget_sta_metrics_t *metrics)
+{
+    portENTER_CRITICAL(&sta_lock);
+    *metrics = sta_metrics;
+    portEXIT_CRITICAL(&sta_lock);
+}
+
+/**
+ * @brief print the start to IP aggregate of one connect path
+ * 
+ * @param path 
+ * @param stats 
+ */
+static void gadget_sta_log_start_stats(const char *path, const gadget_sta_start_stats_t *stats)
+{
+    if(stats->count == 0)
+        return;
+    ESP_LOGI(gadget_tag, "sta start to IP via %s: count %lu, min/mean/max %lu/%lu/%lu ms", path,
+             (unsigned long)stats->count, (unsigned long)stats->min_ms,
+             (unsigned long)(stats->total_ms / stats->count), (unsigned long)stats->max_ms);
+}
+
+/**
+ * @brief print connection state and reconnect metrics
+ * 
+ */
+void gadget_sta_log_metrics(void)
+{
+    gadget_sta_metrics_t metrics;
+    static const char *states[] = { "idle", "connecting", "associated", "online", "backoff" };
+
+    gadget_sta_get_metrics(&metrics);
+    ESP_LOGI(gadget_tag, "sta %s: attempts %lu, connects %lu, disconnects %lu (last reason %d), time to connect last/min/max/mean %lu/%lu/%lu/%lu ms, next retry %lu ms",
+             states[metrics.state], (unsigned long)metrics.attempts, (unsigned long)metrics.connects,
+             (unsigned long)metrics.disconnects, metrics.last_reason,
+             (unsigned long)metrics.last_connect_ms, (unsigned long)metrics.min_connect_ms,
+             (unsigned long)metrics.max_connect_ms,
+             (unsigned long)(metrics.connects ? metrics.total_connect_ms / metrics.connects : 0),
+             (unsigned long)metrics.backoff_ms);
+    if(metrics.start_fast.count + metrics.start_scan.count)
+        ESP_LOGI(gadget_tag, "sta start to IP last %lu ms via %s, fast connect fallbacks %lu",
+                 (unsigned long)metrics.start_to_ip_ms, metrics.start_fast_path ? "fast connect" : "full scan",
+                 (unsigned long)metrics.fast_fallbacks);
+    gadget_sta_log_start_stats("fast connect", &metrics.start_fast);
+    gadget_sta_log_start_stats("full scan", &metrics.start_scan);
+}
+
+/**
+ * @brief change the ping target, takes effect on the next session start
+ * 
+ * @param host name or dotted quad
+ * @return true 
+ * @return false empty or too long
+ */
+bool gadget_ping_set_target(const char *host)
+{
+    size_t len = strnlen(host, GADGET_DNS_HOST_LEN);
+
+    if(len == 0 || len >= GADGET_DNS_HOST_LEN)
+        return false;
+
+    portENTER_CRITICAL(&ping_target_lock);
+    memcpy(ping_target, host, len + 1);
+    portEXIT_CRITICAL(&ping_target_lock);
+    return true;
+}
+
+/**
+ * @brief copy out the ping target
+ * 
+ * @param host at least GADGET_DNS_HOST_LEN
+ */
+void gadget_ping_get_target(char *host)
+{
+    portENTER_CRITICAL(&ping_target_lock);
+    memcpy(host, ping_target, GADGET_DNS_HOST_LEN);
+    portEXIT_CRITICAL(&ping_target_lock);
+}
+
+bool gadget_ping_running(void)
+{
+    return __atomic_load_n(&ping_init, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief ping target lookup finished after a cache miss, tell comms through central
+ *
+ * Not a toggle, comms only starts the session if no stop came in meanwhile.
+ * 
+ * @param host 
+ * @param ok 
+ * @param arg 
+ */
+static void ping_dns_ready(const char *host, bool ok, void *arg)
+{
+    gadget_msg_t msg;
+    uint8_t *payload;
 
-    esp_ping_get_profile(ping_hdl, ESP_PING_PROF_REQUEST, &transmitted, sizeof(transmitted));
-    esp_ping_get_profile(ping_hdl, ESP_PING_PROF_REPLY, &total_recv, sizeof(total_recv));
-    esp_ping_get_profile(ping_hdl, ESP_PING_PROF_DURATION, &total_uptime, sizeof(total_uptime));
+    if(!ok)
+        ESP_LOGE(gadget_tag, "ERROR gadget_init_ping: DNS resolution of %s failed", host);
 
-    ESP_LOGI(gadget_tag, "ping session ended, total transmitted=%d, total recv=%d, total uptime:%d", transmitted, total_recv, total_uptime);
+    memset(&msg, 0, sizeof(gadget_msg_t));
+    payload = gadget_msg_alloc_payload(&msg, 1);
+    if(payload != NULL)
+        payload[0] = ok;
+    gadget_send_msg(gadget_central_msg_queue, 0, gadget_prio_bulk, gadget_comms_id, gadget_msg_ping_resolved, &msg);
 }
 
 /**
  * @brief Ping pong
  * 
+ * @param resolving set if the target is being resolved, a gadget_msg_ping_resolved follows
  * @return true 
  * @return false 
  */
-bool gadget_init_ping(void)
+bool gadget_init_ping(bool *resolving)
 {
-    if(!sta_init_in)
+    *resolving = false;
+    if(gadget_sta_get_state() != gadget_sta_online)
     {
-        ESP_LOGW(gadget_tag, "STA not initialized!");
+        ESP_LOGW(gadget_tag, "STA not connected!");
         return false;
     }
     ip_addr_t target_ip;
-    //struct from lwip
-    //URL's metadata return
-    struct addrinfo hint; 
-    struct addrinfo *res = NULL; 
-    //initializes
+    struct in_addr addr4;
+    char host[GADGET_DNS_HOST_LEN];
     memset(&target_ip, 0x0, sizeof(target_ip));
-    memset(&hint, 0x0, sizeof(hint));
 
-    //retrieve IP address for URL
-    if(getaddrinfo("www.google.com", NULL, &hint, &res) != 0 || res == NULL)
+    gadget_ping_get_target(host);
+    //never wait on DNS here, a cold cache retries once the lookup lands
+    switch(gadget_dns_lookup(host, &addr4, ping_dns_ready, NULL))
     {
-        ESP_LOGE(gadget_tag, "ERROR gadget_init_ping: DNS resolution failed");
-        return false;
+        case ESP_OK:
+        break;
+
+        case ESP_ERR_NOT_FOUND:
+            ESP_LOGI(gadget_tag, "resolving %s, ping starts once it resolves", host);
+            *resolving = true;
+            return false;
+
+        default:
+            ESP_LOGE(gadget_tag, "ERROR gadget_init_ping: cannot look up %s", host);
+            return false;
     }
-    struct in_addr addr4 = ((struct sockaddr_in *) (res->ai_addr))->sin_addr;
     inet_addr_to_ip4addr(ip_2_ip4(&target_ip), &addr4);
-    //free resulting address from getaddrinfo
-    freeaddrinfo(res);
 
     //esp's ping configuration
     esp_ping_config_t ping_config = ESP_PING_DEFAULT_CONFIG();
     ping_config.target_addr = target_ip;
     ping_config.count = ESP_PING_COUNT_INFINITE;
+    ping_config.interval_ms = GADGET_PING_INTERVAL_MS;
+    ping_config.timeout_ms = GADGET_PING_TIMEOUT_MS;
 
     esp_ping_callbacks_t ping_callbacks;
     ping_callbacks.on_ping_success = ping_success;
@@ -288,7 +803,10 @@ bool gadget_init_ping(void)
     esp_err_t ret = ESP_OK;
     if(!ping_init)
     {
-        ESP_LOGI(gadget_tag, "Initializing ping session");
+        ESP_LOGI(gadget_tag, "Initializing ping session to %s every %d ms", host, GADGET_PING_INTERVAL_MS);
+        portENTER_CRITICAL(&ping_stats_lock);
+        gadget_ping_stats_reset(&ping_stats);
+        portEXIT_CRITICAL(&ping_stats_lock);
         ret = esp_ping_new_session(&ping_config, &ping_callbacks, &ping);
         ESP_LOGI(gadget_tag, "Starting ping session.");
         ret = esp_ping_start(ping);
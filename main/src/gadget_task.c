@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "gadget_includes.h"
+#include "gadget_task.h"
+
+const static char *gadget_tag = "gadget_mk1_task";
+
+#define GADGET_TASK_STACK_LOW_PCT   10      // flag stacks with less headroom than this
+
+typedef struct {
+    const gadget_task_def_t *def;
+    TaskHandle_t handle;
+} gadget_task_entry_t;
+
+static gadget_task_entry_t task_table[GADGET_TASK_MAX];
+static size_t task_count = 0;
+static portMUX_TYPE task_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief create a task on its static stack and pinned core, and track it
+ * for the stack report
+ *
+ * A core past the last one (unicore builds) falls back to core 0.
+ *
+ * @param def
+ * @param arg   task parameter
+ * @return TaskHandle_t NULL on failure
+ */
+TaskHandle_t gadget_task_start(const gadget_task_def_t *def, void *arg)
+{
+    TaskHandle_t handle;
+    BaseType_t core = tskNO_AFFINITY;
+
+    if(def->core >= portNUM_PROCESSORS)
+        core = 0;
+    else if(def->core >= 0)
+        core = def->core;
+
+    //depth in StackType_t units, a byte on IDF
+    handle = xTaskCreateStaticPinnedToCore(def->fn, def->name, def->stack_size / sizeof(StackType_t), arg,
+                                           def->priority, def->stack, def->tcb, core);
+    if(handle == NULL)
+    {
+        ESP_LOGE(gadget_tag, "ERROR with creation of %s TASK!", def->name);
+        return NULL;
+    }
+
+    portENTER_CRITICAL(&task_lock);
+    if(task_count < GADGET_TASK_MAX)
+    {
+        task_table[task_count].def = def;
+        task_table[task_count].handle = handle;
+        task_count++;
+    }
+    portEXIT_CRITICAL(&task_lock);
+
+    return handle;
+}
+
+/**
+ * @brief stack size against the deepest use seen so far, per tracked task
+ *
+ * The high water mark only ever grows, so run the load that matters before
+ * reading it and size stacks from the used column plus a margin.
+ */
+void gadget_task_log_stacks(void)
+{
+    gadget_task_entry_t entries[GADGET_TASK_MAX];
+    size_t count;
+    uint32_t free_bytes;
+    uint32_t used_bytes;
+
+    portENTER_CRITICAL(&task_lock);
+    count = task_count;
+    memcpy(entries, task_table, count * sizeof(gadget_task_entry_t));
+    portEXIT_CRITICAL(&task_lock);
+
+    for(size_t i = 0; i < count; i++)
+    {
+        const gadget_task_def_t *def = entries[i].def;
+
+        free_bytes = uxTaskGetStackHighWaterMark(entries[i].handle) * sizeof(StackType_t);
+        used_bytes = def->stack_size > free_bytes ? def->stack_size - free_bytes : 0;
+
+        if(free_bytes * 100 < def->stack_size * GADGET_TASK_STACK_LOW_PCT)
+            ESP_LOGW(gadget_tag, "%-20s core %2d prio %2u stack %5lu used %5lu free %5lu LOW",
+                     def->name, def->core, (unsigned)def->priority, (unsigned long)def->stack_size,
+                     (unsigned long)used_bytes, (unsigned long)free_bytes);
+        else
+            ESP_LOGI(gadget_tag, "%-20s core %2d prio %2u stack %5lu used %5lu free %5lu",
+                     def->name, def->core, (unsigned)def->priority, (unsigned long)def->stack_size,
+                     (unsigned long)used_bytes, (unsigned long)free_bytes);
+    }
+}
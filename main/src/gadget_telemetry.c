@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+
+#include "gadget_includes.h"
+#include "gadget_bus.h"
+#include "gadget_gpio.h"
+#include "gadget_comms.h"
+#include "gadget_ap.h"
+#include "gadget_sta.h"
+#include "gadget_proto.h"
+#include "gadget_telemetry.h"
+
+const static char *gadget_tag = "gadget_mk1_telemetry";
+
+#define GADGET_TELEMETRY_PERIOD_MS      CONFIG_GADGET_TELEMETRY_PERIOD_MS
+#define GADGET_TELEMETRY_MIN_PERIOD_MS  50
+#define GADGET_TELEMETRY_BATCH          CONFIG_GADGET_TELEMETRY_BATCH
+#define GADGET_TELEMETRY_FRAME_SIZE     (GADGET_PROTO_HEADER_SIZE + sizeof(gadget_telemetry_sample_t))
+
+//a batch is kept to one websocket send buffer, larger would go through the heap
+#define GADGET_TELEMETRY_MAX_BATCH      (CONFIG_GADGET_WS_TX_BLOCK_SIZE / GADGET_TELEMETRY_FRAME_SIZE)
+
+static esp_timer_handle_t telemetry_timer = NULL;
+
+//only touched from the esp_timer task
+static uint8_t telemetry_batch[GADGET_TELEMETRY_BATCH * GADGET_TELEMETRY_FRAME_SIZE];
+static size_t telemetry_batch_len = 0;
+static uint8_t telemetry_batch_count = 0;
+static uint8_t telemetry_batch_size = GADGET_TELEMETRY_BATCH;
+static uint32_t telemetry_seq = 0;
+static uint32_t telemetry_last_cost_us = 0;
+
+static gadget_telemetry_stats_t telemetry_stats;
+static portMUX_TYPE telemetry_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief fill sample with the current device state
+ * 
+ * @param sample 
+ */
+static void gadget_telemetry_sample(gadget_telemetry_sample_t *sample)
+{
+    gadget_msg_queue_t *queues[GADGET_TELEMETRY_QUEUES] = {
+        gadget_central_msg_queue, gadget_gpio_msg_queue, gadget_comms_msg_queue,
+    };
+    gadget_queue_stats_t stats;
+    gadget_ws_tx_stats_t ws_stats;
+    gadget_ping_summary_t ping;
+
+    memset(sample, 0, sizeof(gadget_telemetry_sample_t));
+    sample->seq = telemetry_seq++;
+    sample->uptime_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    sample->gpio_states = gadget_gpio_get_states();
+    sample->comms_status = gadget_comms_get_status();
+    sample->ws_clients = (uint8_t)gadget_ws_client_count();
+    sample->heap_free = esp_get_free_heap_size();
+    sample->heap_min_free = esp_get_minimum_free_heap_size();
+
+    for(int i = 0; i < GADGET_TELEMETRY_QUEUES; i++)
+    {
+        for(int prio = 0; prio < gadget_prio_max; prio++)
+        {
+            if(queues[i] == NULL)
+                continue;
+            gadget_bus_get_queue_stats(queues[i], prio, &stats);
+            sample->lanes[i][prio].sends = stats.sends;
+            sample->lanes[i][prio].drops = stats.drops;
+            sample->lanes[i][prio].p99_latency_us = gadget_bus_latency_percentile(&stats, 99);
+        }
+    }
+
+    gadget_ws_get_tx_stats(&ws_stats);
+    sample->ws_frames = ws_stats.frames;
+    sample->ws_dropped = ws_stats.dropped;
+
+    //rtt fields saturate at 65 s, well past any ping timeout
+    gadget_ping_get_summary(&ping);
+    sample->ping.sent = ping.sent;
+    sample->ping.received = ping.received;
+    sample->ping.min_ms = ping.min_ms > UINT16_MAX ? UINT16_MAX : ping.min_ms;
+    sample->ping.mean_ms = ping.mean_ms > UINT16_MAX ? UINT16_MAX : ping.mean_ms;
+    sample->ping.max_ms = ping.max_ms > UINT16_MAX ? UINT16_MAX : ping.max_ms;
+    sample->ping.p50_ms = ping.p50_ms > UINT16_MAX ? UINT16_MAX : ping.p50_ms;
+    sample->ping.p95_ms = ping.p95_ms > UINT16_MAX ? UINT16_MAX : ping.p95_ms;
+    sample->ping.p99_ms = ping.p99_ms > UINT16_MAX ? UINT16_MAX : ping.p99_ms;
+    sample->ping.jitter_us = ping.jitter_us;
+    sample->ping.loss_short_permille = ping.loss_short_permille;
+    sample->ping.loss_long_permille = ping.loss_long_permille;
+    sample->sample_cost_us = telemetry_last_cost_us;
+}
+
+/**
+ * @brief periodic timer callback, samples once and broadcasts full batches
+ * 
+ * The sample is encoded a single time into the batch buffer and
+ * gadget_ws_broadcast shares one copy of the batch between all clients.
+ * 
+ * @param arg 
+ */
+static void gadget_telemetry_tick(void *arg)
+{
+    gadget_telemetry_sample_t sample;
+    gadget_proto_frame_t frame;
+    int64_t start;
+    uint32_t cost;
+    bool sent = false;
+
+    //nobody to stream to, drop any partial batch
+    if(gadget_ws_client_count() == 0)
+    {
+        telemetry_batch_len = 0;
+        telemetry_batch_count = 0;
+        portENTER_CRITICAL(&telemetry_lock);
+        telemetry_stats.skipped++;
+        portEXIT_CRITICAL(&telemetry_lock);
+        return;
+    }
+
+    start = esp_timer_get_time();
+
+    gadget_telemetry_sample(&sample);
+    frame.type = GADGET_PROTO_TYPE_TELEMETRY;
+    frame.prio = gadget_prio_bulk;
+    frame.len = sizeof(gadget_telemetry_sample_t);
+    frame.payload = (const uint8_t *)&sample;
+    telemetry_batch_len += gadget_proto_encode(&frame, &telemetry_batch[telemetry_batch_len],
+                                               sizeof(telemetry_batch) - telemetry_batch_len);
+
+    if(++telemetry_batch_count >= telemetry_batch_size)
+    {
+        gadget_ws_broadcast(telemetry_batch, telemetry_batch_len, true);
+        telemetry_batch_len = 0;
+        telemetry_batch_count = 0;
+        sent = true;
+    }
+
+    cost = (uint32_t)(esp_timer_get_time() - start);
+    telemetry_last_cost_us = cost;
+
+    portENTER_CRITICAL(&telemetry_lock);
+    telemetry_stats.samples++;
+    telemetry_stats.total_cost_us += cost;
+    if(cost > telemetry_stats.max_cost_us)
+        telemetry_stats.max_cost_us = cost;
+    if(sent)
+        telemetry_stats.broadcasts++;
+    portEXIT_CRITICAL(&telemetry_lock);
+}
+
+/**
+ * @brief create the sampling timer and start streaming at the Kconfig period
+ * 
+ */
+void gadget_telemetry_start(void)
+{
+    esp_err_t err;
+    const esp_timer_create_args_t args = {
+        .callback = gadget_telemetry_tick,
+        .name = "gadget_telemetry",
+    };
+
+    if(telemetry_timer != NULL)
+        return;
+
+    if(telemetry_batch_size > GADGET_TELEMETRY_MAX_BATCH)
+    {
+        telemetry_batch_size = GADGET_TELEMETRY_MAX_BATCH > 0 ? GADGET_TELEMETRY_MAX_BATCH : 1;
+        ESP_LOGW(gadget_tag, "telemetry batch limited to %d by the websocket send buffer size", telemetry_batch_size);
+    }
+
+    err = esp_timer_create(&args, &telemetry_timer);
+    if(err != ESP_OK)
+    {
+        ESP_LOGE(gadget_tag, "ERROR failed to create telemetry timer CODE(%s)", esp_err_to_name(err));
+        telemetry_timer = NULL;
+        return;
+    }
+
+    gadget_telemetry_set_period(GADGET_TELEMETRY_PERIOD_MS);
+}
+
+/**
+ * @brief change the sampling period at runtime
+ * 
+ * @param period_ms 0 pauses the stream, otherwise clamped to
+ *                  GADGET_TELEMETRY_MIN_PERIOD_MS
+ */
+void gadget_telemetry_set_period(uint32_t period_ms)
+{
+    if(telemetry_timer == NULL)
+    {
+        ESP_LOGW(gadget_tag, "telemetry not started");
+        return;
+    }
+
+    if(period_ms > 0 && period_ms < GADGET_TELEMETRY_MIN_PERIOD_MS)
+        period_ms = GADGET_TELEMETRY_MIN_PERIOD_MS;
+
+    //stop fails harmlessly when the timer is not running
+    esp_timer_stop(telemetry_timer);
+    if(period_ms > 0 && esp_timer_start_periodic(telemetry_timer, (uint64_t)period_ms * 1000) != ESP_OK)
+    {
+        ESP_LOGE(gadget_tag, "ERROR failed to start telemetry timer");
+        period_ms = 0;
+    }
+
+    portENTER_CRITICAL(&telemetry_lock);
+    telemetry_stats.period_ms = period_ms;
+    portEXIT_CRITICAL(&telemetry_lock);
+
+    ESP_LOGI(gadget_tag, "telemetry period %lu ms", (unsigned long)period_ms);
+}
+
+void gadget_telemetry_get_stats(gadget_telemetry_stats_t *stats)
+{
+    portENTER_CRITICAL(&telemetry_lock);
+    *stats = telemetry_stats;
+    portEXIT_CRITICAL(&telemetry_lock);
+}
+
+/**
+ * @brief print stream rate and the measured cost per sample
+ * 
+ */
+void gadget_telemetry_log_stats(void)
+{
+    gadget_telemetry_stats_t stats;
+
+    gadget_telemetry_get_stats(&stats);
+    ESP_LOGI(gadget_tag, "telemetry: period %lu ms, samples %lu, broadcasts %lu, skipped %lu, cost avg %lu us max %lu us",
+             (unsigned long)stats.period_ms, (unsigned long)stats.samples,
+             (unsigned long)stats.broadcasts, (unsigned long)stats.skipped,
+             (unsigned long)(stats.samples ? stats.total_cost_us / stats.samples : 0),
+             (unsigned long)stats.max_cost_us);
+}
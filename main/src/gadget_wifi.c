@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+
+#include "gadget_includes.h"
+#include "gadget_wifi.h"
+#include "gadget_power.h"
+
+const static char *gadget_tag = "gadget_mk1_wifi";
+
+/*
+ * The wifi driver, netif layer and default event loop are brought up once.
+ * AP and STA are then enabled or disabled by changing the driver mode while
+ * it runs, so adding STA next to a live AP keeps the AP and its stations.
+ * Only called from the comms task.
+ */
+static bool wifi_init = false;
+static bool wifi_started = false;
+static bool wifi_up[2] = { false, false };          // indexed by wifi_interface_t
+static esp_netif_t *wifi_netif[2] = { NULL, NULL }; // created on first add, kept for later adds
+
+static gadget_wifi_stats_t wifi_stats;
+static portMUX_TYPE wifi_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *gadget_wifi_name(wifi_interface_t ifx)
+{
+    return ifx == WIFI_IF_AP ? "ap" : "sta";
+}
+
+/**
+ * @brief record how long a transition took
+ *
+ * @param start_us
+ * @param ok
+ * @return uint32_t elapsed us
+ */
+static uint32_t gadget_wifi_time(int64_t start_us, bool ok)
+{
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+    portENTER_CRITICAL(&wifi_stats_lock);
+    wifi_stats.transitions++;
+    wifi_stats.last_us = elapsed_us;
+    if(elapsed_us > wifi_stats.max_us)
+        wifi_stats.max_us = elapsed_us;
+    if(!ok)
+        wifi_stats.failures++;
+    portEXIT_CRITICAL(&wifi_stats_lock);
+
+    return elapsed_us;
+}
+
+/**
+ * @brief driver mode for the interfaces currently up
+ *
+ * @return wifi_mode_t
+ */
+static wifi_mode_t gadget_wifi_mode(void)
+{
+    return (wifi_mode_t)((wifi_up[WIFI_IF_STA] ? WIFI_MODE_STA : 0) |
+                         (wifi_up[WIFI_IF_AP]  ? WIFI_MODE_AP  : 0));
+}
+
+/**
+ * @brief bring up netif, the default event loop and the wifi driver, once
+ *
+ * @return esp_err_t
+ */
+esp_err_t gadget_wifi_init(void)
+{
+    int64_t start_us;
+    esp_err_t ret;
+
+    if(wifi_init)
+        return ESP_OK;
+
+    start_us = esp_timer_get_time();
+
+    ret = esp_netif_init();
+    if(ret != ESP_OK)
+    {
+        ESP_LOGE(gadget_tag, "ERROR esp_netif_init CODE(%s)", esp_err_to_name(ret));
+        return ret;
+    }
+
+    //someone else may own the loop already, that is fine
+    ret = esp_event_loop_create_default();
+    if(ret != ESP_OK && ret != ESP_ERR_INVALID_STATE)
+    {
+        ESP_LOGE(gadget_tag, "ERROR esp_event_loop_create_default CODE(%s)", esp_err_to_name(ret));
+        return ret;
+    }
+
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ret = esp_wifi_init(&cfg);
+    if(ret != ESP_OK)
+    {
+        ESP_LOGE(gadget_tag, "ERROR esp_wifi_init CODE(%s)", esp_err_to_name(ret));
+        return ret;
+    }
+
+    //configs are rebuilt on every boot, keep them out of flash
+    esp_wifi_set_storage(WIFI_STORAGE_RAM);
+    esp_wifi_set_mode(WIFI_MODE_NULL);
+    //modem sleep between DTIM beacons, what lets light sleep coexist with a connected STA
+    if(gadget_power_light_sleep())
+        esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+
+    wifi_init = true;
+    wifi_stats.init_us = (uint32_t)(esp_timer_get_time() - start_us);
+    ESP_LOGI(gadget_tag, "wifi stack up in %lu us", (unsigned long)wifi_stats.init_us);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief enable an interface next to whatever already runs
+ *
+ * The netif is created the first time the interface is added and reused
+ * afterwards. The driver is started on the first add and only changes
+ * mode after that.
+ *
+ * @param ifx
+ * @param config
+ * @return esp_netif_t* NULL on failure
+ */
+esp_netif_t *gadget_wifi_add(wifi_interface_t ifx, wifi_config_t *config)
+{
+    int64_t start_us;
+    esp_err_t ret;
+
+    if(gadget_wifi_init() != ESP_OK)
+        return NULL;
+
+    if(wifi_up[ifx])
+        return wifi_netif[ifx];
+
+    start_us = esp_timer_get_time();
+
+    if(wifi_netif[ifx] == NULL)
+        wifi_netif[ifx] = ifx == WIFI_IF_AP ? esp_netif_create_default_wifi_ap()
+                                            : esp_netif_create_default_wifi_sta();
+
+    wifi_up[ifx] = true;
+    ret = esp_wifi_set_mode(gadget_wifi_mode());
+    if(ret == ESP_OK)
+        ret = esp_wifi_set_config(ifx, config);
+    if(ret == ESP_OK && !wifi_started)
+    {
+        ret = esp_wifi_start();
+        wifi_started = ret == ESP_OK;
+    }
+
+    if(ret != ESP_OK)
+    {
+        ESP_LOGE(gadget_tag, "ERROR adding %s CODE(%s)", gadget_wifi_name(ifx), esp_err_to_name(ret));
+        wifi_up[ifx] = false;
+        esp_wifi_set_mode(gadget_wifi_mode());
+        gadget_wifi_time(start_us, false);
+        return NULL;
+    }
+
+    ESP_LOGI(gadget_tag, "%s added in %lu us, mode %d", gadget_wifi_name(ifx),
+             (unsigned long)gadget_wifi_time(start_us, true), gadget_wifi_mode());
+
+    return wifi_netif[ifx];
+}
+
+/**
+ * @brief disable an interface, the other one keeps running
+ *
+ * @param ifx
+ * @return esp_err_t
+ */
+esp_err_t gadget_wifi_remove(wifi_interface_t ifx)
+{
+    int64_t start_us;
+    esp_err_t ret;
+
+    if(!wifi_up[ifx])
+        return ESP_OK;
+
+    start_us = esp_timer_get_time();
+
+    wifi_up[ifx] = false;
+    if(gadget_wifi_mode() == WIFI_MODE_NULL)
+    {
+        ret = esp_wifi_stop();
+        wifi_started = false;
+    }
+    else
+        ret = esp_wifi_set_mode(gadget_wifi_mode());
+
+    if(ret != ESP_OK)
+    {
+        ESP_LOGE(gadget_tag, "ERROR removing %s CODE(%s)", gadget_wifi_name(ifx), esp_err_to_name(ret));
+        wifi_up[ifx] = true;
+        gadget_wifi_time(start_us, false);
+        return ret;
+    }
+
+    ESP_LOGI(gadget_tag, "%s removed in %lu us, mode %d", gadget_wifi_name(ifx),
+             (unsigned long)gadget_wifi_time(start_us, true), gadget_wifi_mode());
+
+    return ESP_OK;
+}
+
+bool gadget_wifi_is_up(wifi_interface_t ifx)
+{
+    return wifi_up[ifx];
+}
+
+void gadget_wifi_get_stats(gadget_wifi_stats_t *stats)
+{
+    portENTER_CRITICAL(&wifi_stats_lock);
+    *stats = wifi_stats;
+    portEXIT_CRITICAL(&wifi_stats_lock);
+}
+
+/**
+ * @brief print interfaces and transition timings
+ *
+ */
+void gadget_wifi_log_stats(void)
+{
+    gadget_wifi_stats_t stats;
+
+    gadget_wifi_get_stats(&stats);
+    ESP_LOGI(gadget_tag, "wifi ap %s, sta %s: init %lu us, transitions %lu (failed %lu), last %lu us, max %lu us",
+             wifi_up[WIFI_IF_AP] ? "up" : "down", wifi_up[WIFI_IF_STA] ? "up" : "down",
+             (unsigned long)stats.init_us, (unsigned long)stats.transitions, (unsigned long)stats.failures,
+             (unsigned long)stats.last_us, (unsigned long)stats.max_us);
+}